@@ -0,0 +1,352 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Head to head comparison of aodvDbscan with the AODV of ns-3.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include "ns3/aodvDbscan-module.h"
+#include "ns3/aodv-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup aodvDbscan-examples
+ * \ingroup examples
+ * \brief Comparison with ns3::aodv::RoutingProtocol.
+ *
+ * The same scenario is run twice in a row, once with ns3::aodv::RoutingProtocol
+ * and once with ns3::aodvDbscan::RoutingProtocol. Both runs use the same seed
+ * and run number, and the positions, movements, wifi and flow endpoints draw
+ * from the same fixed random streams, so they differ only by the routing
+ * protocol. Hellos are enabled for both.
+ *
+ * Both protocols talk on UDP port 654, so the control traffic is counted the
+ * same way for both: every IP packet to or from that port sent by a node,
+ * IP and UDP headers included. The discovery latency is taken as the mean
+ * delay of the first packet delivered on each flow, which waits in the queue
+ * of its source until the route is found. The packet delivery ratio comes
+ * from FlowMonitor, and the wall time is that of Simulator::Run.
+ */
+class aodvDbscanCompare
+{
+public:
+  aodvDbscanCompare ();
+  /**
+   * \brief Configure script parameters
+   * \param argc is the command line argument count
+   * \param argv is the command line arguments
+   * \return true on successful configuration
+   */
+  bool Configure (int argc, char **argv);
+  /// Run simulation
+  void Run ();
+  /**
+   * Report results
+   * \param os the output stream
+   */
+  void Report (std::ostream & os);
+
+private:
+  /// Results of the scenario with one protocol
+  struct Result
+  {
+    uint64_t controlPackets;   ///< control packets sent
+    uint64_t controlBytes;     ///< control bytes sent, IP and UDP headers included
+    double discoveryLatency;   ///< mean delay of the first packet delivered per flow, s
+    double pdr;                ///< packet delivery ratio
+    int64_t wallClock;         ///< wall clock time of the simulation, ms
+  };
+
+  // parameters
+  /// Number of nodes
+  uint32_t size;
+  /// Side of the square the nodes move in, meters
+  double side;
+  /// Maximum speed of the nodes, m/s
+  double speed;
+  /// Number of flows
+  uint32_t flows;
+  /// Packets per second of each flow
+  double rate;
+  /// Seed of the random number generator
+  uint32_t seed;
+  /// Run number
+  uint64_t run;
+  /// Simulation time, seconds
+  double totalTime;
+
+  // results
+  /// Results with ns3::aodv::RoutingProtocol
+  Result aodvResult;
+  /// Results with ns3::aodvDbscan::RoutingProtocol
+  Result dbscanResult;
+  /// Results of the run in progress
+  Result * current;
+
+private:
+  /**
+   * Run the scenario once
+   * \param helper the routing helper of the protocol to use
+   * \param result the results of the run
+   */
+  void RunOnce (Ipv4RoutingHelper const & helper, Result & result);
+  /**
+   * Count a packet sent by a node if it is a control packet
+   * \param packet the packet, starting with its IP header
+   * \param ipv4 the IPv4 stack of the node
+   * \param interface the interface it is sent on
+   */
+  void IpTx (Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface);
+  /**
+   * Write one row of the table
+   * \param os the output stream
+   * \param name the name of the row
+   * \param a the value with AODV
+   * \param b the value with aodvDbscan
+   */
+  static void Row (std::ostream & os, std::string name, double a, double b);
+  /**
+   * Write one row of counts, as integers whatever their size
+   * \param os the output stream
+   * \param name the name of the row
+   * \param a the count with AODV
+   * \param b the count with aodvDbscan
+   */
+  static void Row (std::ostream & os, std::string name, uint64_t a, uint64_t b);
+  /**
+   * End a row with the relative change from AODV to aodvDbscan
+   * \param os the output stream
+   * \param a the value with AODV
+   * \param b the value with aodvDbscan
+   */
+  static void Change (std::ostream & os, double a, double b);
+};
+
+int main (int argc, char **argv)
+{
+  aodvDbscanCompare test;
+  if (!test.Configure (argc, argv))
+    NS_FATAL_ERROR ("Configuration failed. Aborted.");
+
+  test.Run ();
+  test.Report (std::cout);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+aodvDbscanCompare::aodvDbscanCompare () :
+  size (50),
+  side (1000),
+  speed (10),
+  flows (10),
+  rate (4),
+  seed (12345),
+  run (1),
+  totalTime (100),
+  current (0)
+{
+}
+
+bool
+aodvDbscanCompare::Configure (int argc, char **argv)
+{
+  CommandLine cmd (__FILE__);
+
+  cmd.AddValue ("size", "Number of nodes.", size);
+  cmd.AddValue ("side", "Side of the square the nodes move in, m.", side);
+  cmd.AddValue ("speed", "Maximum speed of the nodes, m/s, at least 1.", speed);
+  cmd.AddValue ("flows", "Number of CBR/UDP flows.", flows);
+  cmd.AddValue ("rate", "Packets per second of each flow.", rate);
+  cmd.AddValue ("seed", "Seed of the random number generator.", seed);
+  cmd.AddValue ("run", "Run number.", run);
+  cmd.AddValue ("time", "Simulation time, s.", totalTime);
+
+  cmd.Parse (argc, argv);
+  // The waypoint speeds are drawn from 1 m/s up
+  return size >= 2 && speed >= 1;
+}
+
+void
+aodvDbscanCompare::Run ()
+{
+  AodvHelper aodvHelper;
+  aodvHelper.Set ("EnableHello", BooleanValue (true));
+  std::cout << "Running " << size << " nodes for " << totalTime << " s with AODV ...\n";
+  RunOnce (aodvHelper, aodvResult);
+
+  aodvDbscanHelper dbscanHelper;
+  dbscanHelper.Set ("EnableHello", BooleanValue (true));
+  std::cout << "Running " << size << " nodes for " << totalTime << " s with aodvDbscan ...\n";
+  RunOnce (dbscanHelper, dbscanResult);
+}
+
+void
+aodvDbscanCompare::Report (std::ostream & os)
+{
+  os << std::left << std::setw (24) << "" << std::right
+     << std::setw (14) << "AODV" << std::setw (14) << "aodvDbscan" << std::setw (10) << "change" << "\n";
+  Row (os, "Control packets", aodvResult.controlPackets, dbscanResult.controlPackets);
+  Row (os, "Control bytes", aodvResult.controlBytes, dbscanResult.controlBytes);
+  Row (os, "Discovery latency (ms)", aodvResult.discoveryLatency * 1000, dbscanResult.discoveryLatency * 1000);
+  Row (os, "PDR", aodvResult.pdr, dbscanResult.pdr);
+  Row (os, "Wall time (ms)", uint64_t (aodvResult.wallClock), uint64_t (dbscanResult.wallClock));
+}
+
+void
+aodvDbscanCompare::RunOnce (Ipv4RoutingHelper const & helper, Result & result)
+{
+  // Fixed streams, so that both runs see the same scenario
+  const int64_t stream = 1000;
+  SeedManager::SetSeed (seed);
+  SeedManager::SetRun (run);
+  result.controlPackets = 0;
+  result.controlBytes = 0;
+  current = &result;
+
+  NodeContainer nodes;
+  nodes.Create (size);
+
+  std::ostringstream bound;
+  bound << "ns3::UniformRandomVariable[Min=0.0|Max=" << side << "]";
+  ObjectFactory allocator;
+  allocator.SetTypeId ("ns3::RandomRectanglePositionAllocator");
+  allocator.Set ("X", StringValue (bound.str ()));
+  allocator.Set ("Y", StringValue (bound.str ()));
+  Ptr<PositionAllocator> positions = allocator.Create ()->GetObject<PositionAllocator> ();
+  int64_t next = stream;
+  next += positions->AssignStreams (next);
+  std::ostringstream velocity;
+  velocity << "ns3::UniformRandomVariable[Min=1.0|Max=" << speed << "]";
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::RandomWaypointMobilityModel",
+                             "Speed", StringValue (velocity.str ()),
+                             "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"),
+                             "PositionAllocator", PointerValue (positions));
+  mobility.Install (nodes);
+  next += mobility.AssignStreams (nodes, next);
+
+  aodvDbscanScenarioHelper scenario;
+  NetDeviceContainer devices = scenario.InstallDevices (nodes);
+  next += scenario.AssignStreams (devices, next);
+
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (helper); // has effect on the next Install ()
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+  Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/Tx",
+                                 MakeCallback (&aodvDbscanCompare::IpTx, this));
+
+  const uint32_t packetSize = 512;
+  scenario.InstallFlows (nodes, interfaces, flows, rate, packetSize, Seconds (5), Seconds (6), Seconds (totalTime));
+
+  FlowMonitorHelper flowHelper;
+  Ptr<FlowMonitor> monitor = flowHelper.InstallAll ();
+
+  Simulator::Stop (Seconds (totalTime));
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Run ();
+  result.wallClock = clock.End ();
+
+  monitor->CheckForLostPackets ();
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
+  const FlowMonitor::FlowStatsContainer & stats = monitor->GetFlowStats ();
+  uint64_t txPackets = 0;
+  uint64_t rxPackets = 0;
+  uint32_t delivered = 0;
+  Time firstDelay;
+  for (FlowMonitor::FlowStatsContainerCI i = stats.begin (); i != stats.end (); ++i)
+    {
+      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
+      if (t.protocol != 17 || t.destinationPort == aodvDbscan::RoutingProtocol::aodvDbscan_PORT)
+        {
+          continue;
+        }
+      txPackets += i->second.txPackets;
+      rxPackets += i->second.rxPackets;
+      if (i->second.rxPackets > 0)
+        {
+          firstDelay += i->second.timeFirstRxPacket - i->second.timeFirstTxPacket;
+          delivered++;
+        }
+    }
+  result.pdr = txPackets ? double (rxPackets) / txPackets : 0;
+  result.discoveryLatency = delivered ? firstDelay.GetSeconds () / delivered : 0;
+
+  current = 0;
+  Simulator::Destroy ();
+}
+
+void
+aodvDbscanCompare::IpTx (Ptr<const Packet> packet, Ptr<Ipv4>, uint32_t)
+{
+  Ptr<Packet> copy = packet->Copy ();
+  Ipv4Header ipHeader;
+  copy->RemoveHeader (ipHeader);
+  if (ipHeader.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+    {
+      return;
+    }
+  UdpHeader udpHeader;
+  copy->PeekHeader (udpHeader);
+  if (udpHeader.GetDestinationPort () == aodvDbscan::RoutingProtocol::aodvDbscan_PORT
+      || udpHeader.GetSourcePort () == aodvDbscan::RoutingProtocol::aodvDbscan_PORT)
+    {
+      current->controlPackets++;
+      current->controlBytes += packet->GetSize ();
+    }
+}
+
+void
+aodvDbscanCompare::Row (std::ostream & os, std::string name, double a, double b)
+{
+  os << std::left << std::setw (24) << name << std::right
+     << std::setw (14) << a << std::setw (14) << b;
+  Change (os, a, b);
+}
+
+void
+aodvDbscanCompare::Row (std::ostream & os, std::string name, uint64_t a, uint64_t b)
+{
+  os << std::left << std::setw (24) << name << std::right
+     << std::setw (14) << a << std::setw (14) << b;
+  Change (os, a, b);
+}
+
+void
+aodvDbscanCompare::Change (std::ostream & os, double a, double b)
+{
+  if (a != 0)
+    {
+      os << std::setw (9) << std::fixed << std::setprecision (1) << (b - a) / a * 100 << "%";
+      os.unsetf (std::ios::floatfield);
+      os << std::setprecision (6);
+    }
+  os << "\n";
+}
@@ -0,0 +1,289 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Network lifetime benchmark for the energy aware clustering of aodvDbscan.
+ */
+
+#include <iostream>
+#include <cmath>
+#include "ns3/aodvDbscan-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/energy-module.h"
+#include "ns3/wifi-radio-energy-model-helper.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup aodvDbscan-examples
+ * \ingroup examples
+ * \brief Network lifetime benchmark.
+ *
+ * Battery powered nodes are placed at random in a square and a few constant
+ * bit rate flows cross the network. Every node draws its radio energy from a
+ * BasicEnergySource and stops working once the source reports it depleted.
+ * The script reports when the first node died, how many were still alive at
+ * the end and how many packets were delivered.
+ *
+ * Run it once with --energyAware=false and once with --energyAware=true to
+ * compare the lifetime with and without residual energy among the clustering
+ * features.
+ */
+class aodvDbscanEnergyLifetime
+{
+public:
+  aodvDbscanEnergyLifetime ();
+  /**
+   * \brief Configure script parameters
+   * \param argc is the command line argument count
+   * \param argv is the command line arguments
+   * \return true on successful configuration
+   */
+  bool Configure (int argc, char **argv);
+  /// Run simulation
+  void Run ();
+  /**
+   * Report results
+   * \param os the output stream
+   */
+  void Report (std::ostream & os);
+
+private:
+  // parameters
+  /// Number of nodes
+  uint32_t size;
+  /// Side of the square the nodes are placed in, meters
+  double side;
+  /// Number of flows
+  uint32_t flows;
+  /// Packets per second of each flow
+  double rate;
+  /// Initial energy of every node, joules
+  double initialEnergy;
+  /// Simulation time, seconds
+  double totalTime;
+  /// Favor neighbors with more residual energy
+  bool energyAware;
+  /// Weight of the residual energy among the clustering features
+  double energyWeight;
+
+  // network
+  /// nodes used in the example
+  NodeContainer nodes;
+  /// devices used in the example
+  NetDeviceContainer devices;
+  /// interfaces used in the example
+  Ipv4InterfaceContainer interfaces;
+  /// energy sources of the nodes
+  energy::EnergySourceContainer sources;
+  /// sinks of the flows
+  ApplicationContainer sinks;
+
+  // results
+  /// Time the first node ran out of energy, negative while all are alive
+  Time firstDeath;
+  /// Number of nodes alive, sampled every second
+  std::vector<uint32_t> alive;
+
+private:
+  /// Create the nodes
+  void CreateNodes ();
+  /// Create the devices
+  void CreateDevices ();
+  /// Attach an energy source to every node
+  void InstallEnergy ();
+  /// Create the network
+  void InstallInternetStack ();
+  /// Create the simulation applications
+  void InstallApplications ();
+  /// Count the nodes whose energy source is not depleted
+  void SampleAlive ();
+};
+
+int main (int argc, char **argv)
+{
+  aodvDbscanEnergyLifetime test;
+  if (!test.Configure (argc, argv))
+    NS_FATAL_ERROR ("Configuration failed. Aborted.");
+
+  test.Run ();
+  test.Report (std::cout);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+aodvDbscanEnergyLifetime::aodvDbscanEnergyLifetime () :
+  size (30),
+  side (300),
+  flows (4),
+  rate (20),
+  initialEnergy (20),
+  totalTime (300),
+  energyAware (true),
+  energyWeight (1),
+  firstDeath (Seconds (-1))
+{
+}
+
+bool
+aodvDbscanEnergyLifetime::Configure (int argc, char **argv)
+{
+  SeedManager::SetSeed (12345);
+  CommandLine cmd (__FILE__);
+
+  cmd.AddValue ("size", "Number of nodes.", size);
+  cmd.AddValue ("side", "Side of the square the nodes are placed in, m.", side);
+  cmd.AddValue ("flows", "Number of constant bit rate flows.", flows);
+  cmd.AddValue ("rate", "Packets per second of each flow.", rate);
+  cmd.AddValue ("energy", "Initial energy of every node, J.", initialEnergy);
+  cmd.AddValue ("time", "Simulation time, s.", totalTime);
+  cmd.AddValue ("energyAware", "Favor neighbors with more residual energy.", energyAware);
+  cmd.AddValue ("energyWeight", "Weight of the residual energy among the clustering features.", energyWeight);
+
+  cmd.Parse (argc, argv);
+  return size >= 2 && flows >= 1;
+}
+
+void
+aodvDbscanEnergyLifetime::Run ()
+{
+  CreateNodes ();
+  CreateDevices ();
+  InstallEnergy ();
+  InstallInternetStack ();
+  InstallApplications ();
+
+  std::cout << "Starting simulation for " << totalTime << " s, energy awareness "
+            << (energyAware ? "on" : "off") << " ...\n";
+
+  Simulator::Schedule (Seconds (1), &aodvDbscanEnergyLifetime::SampleAlive, this);
+  Simulator::Stop (Seconds (totalTime));
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+aodvDbscanEnergyLifetime::Report (std::ostream & os)
+{
+  uint64_t received = 0;
+  for (uint32_t i = 0; i < sinks.GetN (); ++i)
+    {
+      received += DynamicCast<PacketSink> (sinks.Get (i))->GetTotalRx ();
+    }
+  os << "First node died at: ";
+  if (firstDeath.IsNegative ())
+    {
+      os << "never\n";
+    }
+  else
+    {
+      os << firstDeath.As (Time::S) << "\n";
+    }
+  os << "Nodes alive at the end: " << (alive.empty () ? size : alive.back ()) << " of " << size << "\n";
+  os << "Bytes received: " << received << "\n";
+  os << "Nodes alive per second:";
+  for (std::vector<uint32_t>::const_iterator i = alive.begin (); i != alive.end (); ++i)
+    {
+      os << " " << *i;
+    }
+  os << "\n";
+}
+
+void
+aodvDbscanEnergyLifetime::CreateNodes ()
+{
+  std::cout << "Creating " << (unsigned)size << " nodes in a " << side << " m square.\n";
+  nodes.Create (size);
+  MobilityHelper mobility;
+  std::ostringstream bound;
+  bound << "ns3::UniformRandomVariable[Min=0.0|Max=" << side << "]";
+  mobility.SetPositionAllocator ("ns3::RandomRectanglePositionAllocator",
+                                 "X", StringValue (bound.str ()),
+                                 "Y", StringValue (bound.str ()));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+}
+
+void
+aodvDbscanEnergyLifetime::CreateDevices ()
+{
+  aodvDbscanScenarioHelper scenario;
+  devices = scenario.InstallDevices (nodes);
+}
+
+void
+aodvDbscanEnergyLifetime::InstallEnergy ()
+{
+  BasicEnergySourceHelper sourceHelper;
+  sourceHelper.Set ("BasicEnergySourceInitialEnergyJ", DoubleValue (initialEnergy));
+  sources = sourceHelper.Install (nodes);
+  // The radio is switched off once its source is depleted
+  WifiRadioEnergyModelHelper radioHelper;
+  radioHelper.Install (devices, sources);
+}
+
+void
+aodvDbscanEnergyLifetime::InstallInternetStack ()
+{
+  aodvDbscanHelper aodvDbscan;
+  // Residual energy is advertised in hellos
+  aodvDbscan.Set ("EnableHello", BooleanValue (true));
+  aodvDbscan.Set ("EnableEnergyAwareness", BooleanValue (energyAware));
+  aodvDbscan.Set ("EnergyWeight", DoubleValue (energyWeight));
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (aodvDbscan); // has effect on the next Install ()
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  interfaces = address.Assign (devices);
+}
+
+void
+aodvDbscanEnergyLifetime::InstallApplications ()
+{
+  const uint32_t packetSize = 512;
+  aodvDbscanScenarioHelper scenario;
+  sinks = scenario.InstallFlows (nodes, interfaces, flows, rate, packetSize, Seconds (1), Seconds (2), Seconds (totalTime));
+}
+
+void
+aodvDbscanEnergyLifetime::SampleAlive ()
+{
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < sources.GetN (); ++i)
+    {
+      Ptr<energy::BasicEnergySource> source = DynamicCast<energy::BasicEnergySource> (sources.Get (i));
+      double lowBattery = 0;
+      if (source)
+        {
+          DoubleValue threshold;
+          source->GetAttribute ("BasicEnergyLowBatteryThreshold", threshold);
+          lowBattery = threshold.Get ();
+        }
+      if (sources.Get (i)->GetEnergyFraction () > lowBattery)
+        {
+          count++;
+        }
+    }
+  if (count < size && firstDeath.IsNegative ())
+    {
+      firstDeath = Simulator::Now ();
+    }
+  alive.push_back (count);
+  Simulator::Schedule (Seconds (1), &aodvDbscanEnergyLifetime::SampleAlive, this);
+}
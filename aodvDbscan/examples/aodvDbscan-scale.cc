@@ -0,0 +1,315 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Large scale mobile scenario for aodvDbscan, measuring the CPU and memory
+ * the protocol needs as the network grows.
+ */
+
+#include <iostream>
+#include <cmath>
+#include "ns3/aodvDbscan-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/system-wall-clock-ms.h"
+#if defined (__unix__) || defined (__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace ns3;
+
+/**
+ * \ingroup aodvDbscan-examples
+ * \ingroup examples
+ * \brief Large scale mobile scenario.
+ *
+ * Nodes move in a square following either the random waypoint or the
+ * Gauss-Markov mobility model, while a number of constant bit rate UDP flows
+ * run between random pairs of nodes. Hellos are enabled so that every node
+ * clusters its neighborhood.
+ *
+ * Besides the bytes delivered, the script reports the wall clock time of the
+ * simulation, the number of events processed and the peak resident set size
+ * of the process, so that runs with growing node counts, e.g.
+ *
+ * ./ns3 run "aodvDbscan-scale --size=50"
+ * ./ns3 run "aodvDbscan-scale --size=500"
+ * ./ns3 run "aodvDbscan-scale --size=5000 --time=30"
+ *
+ * show how the CPU and memory cost of the protocol scale. Unless given, the
+ * side of the square grows with the node count so that the density stays that
+ * of 50 nodes in 1000 x 1000 m.
+ */
+class aodvDbscanScale
+{
+public:
+  aodvDbscanScale ();
+  /**
+   * \brief Configure script parameters
+   * \param argc is the command line argument count
+   * \param argv is the command line arguments
+   * \return true on successful configuration
+   */
+  bool Configure (int argc, char **argv);
+  /// Run simulation
+  void Run ();
+  /**
+   * Report results
+   * \param os the output stream
+   */
+  void Report (std::ostream & os);
+
+private:
+  // parameters
+  /// Number of nodes
+  uint32_t size;
+  /// Mobility model, "RandomWaypoint" or "GaussMarkov"
+  std::string mobilityModel;
+  /// Side of the square the nodes move in, meters, 0 to derive it from the node count
+  double side;
+  /// Maximum speed of the nodes, m/s
+  double speed;
+  /// Number of concurrent flows
+  uint32_t flows;
+  /// Packets per second of each flow
+  double rate;
+  /// Size of the data packets, bytes
+  uint32_t packetSize;
+  /// Seed of the random number generator
+  uint32_t seed;
+  /// Run number, selects an independent substream for the same seed
+  uint64_t run;
+  /// Simulation time, seconds
+  double totalTime;
+
+  // network
+  /// nodes used in the example
+  NodeContainer nodes;
+  /// devices used in the example
+  NetDeviceContainer devices;
+  /// interfaces used in the example
+  Ipv4InterfaceContainer interfaces;
+  /// sinks of the flows
+  ApplicationContainer sinks;
+
+  // results
+  /// Wall clock time of the simulation, ms
+  int64_t wallClock;
+  /// Number of events processed
+  uint64_t events;
+
+private:
+  /// Create the nodes
+  void CreateNodes ();
+  /// Create the devices
+  void CreateDevices ();
+  /// Create the network
+  void InstallInternetStack ();
+  /// Create the simulation applications
+  void InstallApplications ();
+  /**
+   * \returns the peak resident set size of the process in kB, 0 if unknown
+   */
+  static uint64_t PeakRss ();
+};
+
+int main (int argc, char **argv)
+{
+  aodvDbscanScale test;
+  if (!test.Configure (argc, argv))
+    NS_FATAL_ERROR ("Configuration failed. Aborted.");
+
+  test.Run ();
+  test.Report (std::cout);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+aodvDbscanScale::aodvDbscanScale () :
+  size (50),
+  mobilityModel ("RandomWaypoint"),
+  side (0),
+  speed (10),
+  flows (10),
+  rate (4),
+  packetSize (512),
+  seed (12345),
+  run (1),
+  totalTime (100),
+  wallClock (0),
+  events (0)
+{
+}
+
+bool
+aodvDbscanScale::Configure (int argc, char **argv)
+{
+  CommandLine cmd (__FILE__);
+
+  cmd.AddValue ("size", "Number of nodes.", size);
+  cmd.AddValue ("mobility", "Mobility model, RandomWaypoint or GaussMarkov.", mobilityModel);
+  cmd.AddValue ("side", "Side of the square the nodes move in, m. 0 keeps the density of 50 nodes per km^2.", side);
+  cmd.AddValue ("speed", "Maximum speed of the nodes, m/s, at least 1 with RandomWaypoint.", speed);
+  cmd.AddValue ("flows", "Number of concurrent CBR/UDP flows.", flows);
+  cmd.AddValue ("rate", "Packets per second of each flow.", rate);
+  cmd.AddValue ("packetSize", "Size of the data packets, bytes.", packetSize);
+  cmd.AddValue ("seed", "Seed of the random number generator.", seed);
+  cmd.AddValue ("run", "Run number.", run);
+  cmd.AddValue ("time", "Simulation time, s.", totalTime);
+
+  cmd.Parse (argc, argv);
+
+  SeedManager::SetSeed (seed);
+  SeedManager::SetRun (run);
+  if (side <= 0)
+    {
+      side = 1000 * std::sqrt (size / 50.0);
+    }
+  if (mobilityModel != "RandomWaypoint" && mobilityModel != "GaussMarkov")
+    {
+      std::cerr << "Unknown mobility model " << mobilityModel << "\n";
+      return false;
+    }
+  if (mobilityModel == "RandomWaypoint" && speed < 1)
+    {
+      // The waypoint speeds are drawn from 1 m/s up
+      std::cerr << "RandomWaypoint needs a speed of at least 1 m/s\n";
+      return false;
+    }
+  return size >= 2 && speed > 0;
+}
+
+void
+aodvDbscanScale::Run ()
+{
+  CreateNodes ();
+  CreateDevices ();
+  InstallInternetStack ();
+  InstallApplications ();
+
+  std::cout << "Starting simulation for " << totalTime << " s ...\n";
+
+  Simulator::Stop (Seconds (totalTime));
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Run ();
+  wallClock = clock.End ();
+  events = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+}
+
+void
+aodvDbscanScale::Report (std::ostream & os)
+{
+  uint64_t received = 0;
+  for (uint32_t i = 0; i < sinks.GetN (); ++i)
+    {
+      received += DynamicCast<PacketSink> (sinks.Get (i))->GetTotalRx ();
+    }
+  os << "Nodes: " << size << ", mobility: " << mobilityModel << ", side: " << side
+     << " m, flows: " << flows << ", seed: " << seed << ", run: " << run << "\n";
+  os << "Bytes received: " << received << "\n";
+  os << "Wall clock time: " << wallClock << " ms\n";
+  os << "Events processed: " << events << "\n";
+  os << "Peak RSS: " << PeakRss () << " kB\n";
+}
+
+void
+aodvDbscanScale::CreateNodes ()
+{
+  std::cout << "Creating " << (unsigned)size << " nodes in a " << side << " m square.\n";
+  nodes.Create (size);
+
+  std::ostringstream bound;
+  bound << "ns3::UniformRandomVariable[Min=0.0|Max=" << side << "]";
+  ObjectFactory allocator;
+  allocator.SetTypeId ("ns3::RandomRectanglePositionAllocator");
+  allocator.Set ("X", StringValue (bound.str ()));
+  allocator.Set ("Y", StringValue (bound.str ()));
+  Ptr<PositionAllocator> positions = allocator.Create ()->GetObject<PositionAllocator> ();
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  if (mobilityModel == "RandomWaypoint")
+    {
+      std::ostringstream velocity;
+      velocity << "ns3::UniformRandomVariable[Min=1.0|Max=" << speed << "]";
+      mobility.SetMobilityModel ("ns3::RandomWaypointMobilityModel",
+                                 "Speed", StringValue (velocity.str ()),
+                                 "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"),
+                                 "PositionAllocator", PointerValue (positions));
+    }
+  else
+    {
+      std::ostringstream velocity;
+      velocity << "ns3::UniformRandomVariable[Min=0.0|Max=" << speed << "]";
+      mobility.SetMobilityModel ("ns3::GaussMarkovMobilityModel",
+                                 "Bounds", BoxValue (Box (0, side, 0, side, 0, 0)),
+                                 "TimeStep", TimeValue (Seconds (1)),
+                                 "Alpha", DoubleValue (0.85),
+                                 "MeanVelocity", StringValue (velocity.str ()),
+                                 "MeanDirection", StringValue ("ns3::UniformRandomVariable[Min=0|Max=6.283185307]"),
+                                 "MeanPitch", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"),
+                                 "NormalPitch", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"));
+    }
+  mobility.Install (nodes);
+}
+
+void
+aodvDbscanScale::CreateDevices ()
+{
+  aodvDbscanScenarioHelper scenario;
+  devices = scenario.InstallDevices (nodes);
+}
+
+void
+aodvDbscanScale::InstallInternetStack ()
+{
+  aodvDbscanHelper aodvDbscan;
+  aodvDbscan.Set ("EnableHello", BooleanValue (true));
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (aodvDbscan); // has effect on the next Install ()
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  interfaces = address.Assign (devices);
+}
+
+void
+aodvDbscanScale::InstallApplications ()
+{
+  aodvDbscanScenarioHelper scenario;
+  // Let the hellos populate the neighbor tables before the first discovery
+  sinks = scenario.InstallFlows (nodes, interfaces, flows, rate, packetSize, Seconds (5), Seconds (6), Seconds (totalTime));
+}
+
+uint64_t
+aodvDbscanScale::PeakRss ()
+{
+#if defined (__unix__) || defined (__APPLE__)
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef __APPLE__
+      return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+      return usage.ru_maxrss;
+#endif
+    }
+#endif
+  return 0;
+}
@@ -0,0 +1,547 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Parallel parameter sweep of aodvDbscan.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <cmath>
+#include <map>
+#include <set>
+#include <vector>
+#include "ns3/aodvDbscan-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/system-wall-clock-ms.h"
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+/**
+ * \ingroup aodvDbscan-examples
+ * \ingroup examples
+ * \brief Parallel parameter sweep.
+ *
+ * Runs the random waypoint scenario for every combination of the DBSCAN
+ * epsilon and minPts, the hello interval and the active route timeout given
+ * as comma separated lists, each with run numbers 1 to --runs. The simulator
+ * is global to a process, so every simulation runs in a worker process forked
+ * for it, and up to --jobs workers, by default one per core, run at the same
+ * time. Workers send their result row back through a pipe and only this
+ * process writes the CSV file, one complete row per simulation, as soon as
+ * the simulation ends.
+ *
+ * The simulations whose row is already in the CSV file are skipped, so an
+ * interrupted sweep resumes where it stopped when run again with the same
+ * output file. A row counts for a simulation only if all its parameters, the
+ * scenario ones included, have the same value, however many digits they are
+ * written with. A file whose header is not that of this sweep is refused.
+ * A simulation whose worker fails is reported and has no row, it is retried on
+ * the next invocation. --resume=0 starts the output file over instead.
+ *
+ * aodvDbscan-sweep.sh launches the sweep through the ns3 script, e.g.
+ *
+ * aodvDbscan-sweep.sh --epsilon=0.2,0.3,0.4 --minPts=2,3 --runs=10 --output=sweep.csv
+ *
+ * Workers are created with fork (), so the sweep needs a POSIX system.
+ */
+class aodvDbscanSweep
+{
+public:
+  aodvDbscanSweep ();
+  /**
+   * \brief Configure script parameters
+   * \param argc is the command line argument count
+   * \param argv is the command line arguments
+   * \return true on successful configuration
+   */
+  bool Configure (int argc, char **argv);
+  /// Run simulation
+  void Run ();
+  /**
+   * Report results
+   * \param os the output stream
+   */
+  void Report (std::ostream & os);
+
+private:
+  /// A simulation of the sweep, the values as given on the command line
+  struct Point
+  {
+    std::string epsilon;            ///< DBSCAN neighborhood radius
+    std::string minPts;             ///< DBSCAN minimum number of neighbors of a core point
+    std::string helloInterval;      ///< hello interval, s
+    std::string activeRouteTimeout; ///< active route timeout, s
+    uint64_t run;                   ///< run number
+  };
+
+  // parameters
+  /// Epsilon values
+  std::string epsilonList;
+  /// MinPts values
+  std::string minPtsList;
+  /// Hello interval values, s
+  std::string helloIntervalList;
+  /// Active route timeout values, s
+  std::string activeRouteTimeoutList;
+  /// Number of runs per combination
+  uint32_t runs;
+  /// Seed of the random number generator
+  uint32_t seed;
+  /// Maximum number of workers at the same time, 0 for one per core
+  uint32_t jobs;
+  /// CSV file the results are appended to
+  std::string output;
+  /// Skip the simulations already in the output file, rather than start it over
+  bool resume;
+  /// Number of nodes
+  uint32_t size;
+  /// Side of the square the nodes move in, meters
+  double side;
+  /// Maximum speed of the nodes, m/s
+  double speed;
+  /// Number of flows
+  uint32_t flows;
+  /// Packets per second of each flow
+  double rate;
+  /// Simulation time, seconds
+  double totalTime;
+
+  // results
+  /// Simulations run
+  uint32_t done;
+  /// Simulations skipped, already in the output file
+  uint32_t skipped;
+  /// Simulations whose worker failed
+  uint32_t failed;
+  /// Control packets sent in the worker's simulation
+  uint64_t controlPackets;
+
+private:
+  /**
+   * \param list comma separated values
+   * \returns the values
+   */
+  static std::vector<std::string> Split (std::string const & list);
+  /// \returns the header line of the CSV file, without its newline
+  static std::string Header ();
+  /**
+   * \param value a parameter
+   * \returns the value written the same way whatever the digits it was given with
+   */
+  static std::string Format (double value);
+  /**
+   * \param point a simulation
+   * \returns the columns identifying the simulation in the CSV file
+   */
+  std::string Key (Point const & point) const;
+  /**
+   * Read the simulations already in the output file. Abort if the file holds
+   * the results of another version of the sweep.
+   * \returns their keys
+   */
+  std::set<std::string> LoadDone ();
+  /**
+   * Run one simulation, in a worker process
+   * \param point the simulation
+   * \returns its CSV row
+   */
+  std::string Simulate (Point const & point);
+  /**
+   * Count a control packet sent by a node
+   * \param packet the control packet
+   * \param destination the neighbor or broadcast address it is sent to
+   */
+  void TxControl (Ptr<const Packet> packet, Ipv4Address destination);
+};
+
+int main (int argc, char **argv)
+{
+  aodvDbscanSweep test;
+  if (!test.Configure (argc, argv))
+    NS_FATAL_ERROR ("Configuration failed. Aborted.");
+
+  test.Run ();
+  test.Report (std::cout);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+aodvDbscanSweep::aodvDbscanSweep () :
+  epsilonList ("0.3"),
+  minPtsList ("2"),
+  helloIntervalList ("1"),
+  activeRouteTimeoutList ("3"),
+  runs (1),
+  seed (12345),
+  jobs (0),
+  output ("aodvDbscan-sweep.csv"),
+  resume (true),
+  size (50),
+  side (1000),
+  speed (10),
+  flows (10),
+  rate (4),
+  totalTime (100),
+  done (0),
+  skipped (0),
+  failed (0),
+  controlPackets (0)
+{
+}
+
+bool
+aodvDbscanSweep::Configure (int argc, char **argv)
+{
+  CommandLine cmd (__FILE__);
+
+  cmd.AddValue ("epsilon", "Comma separated DBSCAN epsilon values.", epsilonList);
+  cmd.AddValue ("minPts", "Comma separated DBSCAN minPts values.", minPtsList);
+  cmd.AddValue ("helloInterval", "Comma separated hello intervals, s.", helloIntervalList);
+  cmd.AddValue ("activeRouteTimeout", "Comma separated active route timeouts, s.", activeRouteTimeoutList);
+  cmd.AddValue ("runs", "Number of runs of every combination.", runs);
+  cmd.AddValue ("seed", "Seed of the random number generator.", seed);
+  cmd.AddValue ("jobs", "Maximum number of simulations at the same time, 0 for one per core.", jobs);
+  cmd.AddValue ("output", "CSV file the results are appended to.", output);
+  cmd.AddValue ("resume", "Skip the simulations already in the output file, 0 to start it over.", resume);
+  cmd.AddValue ("size", "Number of nodes.", size);
+  cmd.AddValue ("side", "Side of the square the nodes move in, m.", side);
+  cmd.AddValue ("speed", "Maximum speed of the nodes, m/s, at least 1.", speed);
+  cmd.AddValue ("flows", "Number of CBR/UDP flows.", flows);
+  cmd.AddValue ("rate", "Packets per second of each flow.", rate);
+  cmd.AddValue ("time", "Simulation time, s.", totalTime);
+
+  cmd.Parse (argc, argv);
+  if (jobs == 0)
+    {
+      long cores = sysconf (_SC_NPROCESSORS_ONLN);
+      jobs = cores > 0 ? cores : 1;
+    }
+  // The waypoint speeds are drawn from 1 m/s up
+  return size >= 2 && speed >= 1 && runs > 0 && !output.empty ();
+}
+
+void
+aodvDbscanSweep::Run ()
+{
+  std::vector<Point> points;
+  std::vector<std::string> epsilons = Split (epsilonList);
+  std::vector<std::string> minPts = Split (minPtsList);
+  std::vector<std::string> helloIntervals = Split (helloIntervalList);
+  std::vector<std::string> activeRouteTimeouts = Split (activeRouteTimeoutList);
+  std::set<std::string> finished;
+  if (resume)
+    {
+      finished = LoadDone ();
+    }
+  for (uint32_t a = 0; a < epsilons.size (); ++a)
+    for (uint32_t b = 0; b < minPts.size (); ++b)
+      for (uint32_t c = 0; c < helloIntervals.size (); ++c)
+        for (uint32_t d = 0; d < activeRouteTimeouts.size (); ++d)
+          for (uint64_t run = 1; run <= runs; ++run)
+            {
+              Point point;
+              point.epsilon = epsilons[a];
+              point.minPts = minPts[b];
+              point.helloInterval = helloIntervals[c];
+              point.activeRouteTimeout = activeRouteTimeouts[d];
+              point.run = run;
+              if (finished.count (Key (point)))
+                {
+                  skipped++;
+                }
+              else
+                {
+                  points.push_back (point);
+                }
+            }
+
+  std::cout << "Running " << points.size () << " simulations on " << jobs << " workers, "
+            << skipped << " already in " << output << " ...\n";
+
+  bool header = !resume;
+  if (resume)
+    {
+      std::ifstream existing (output.c_str ());
+      header = !existing.good () || existing.peek () == std::ifstream::traits_type::eof ();
+    }
+  std::ofstream file (output.c_str (), resume ? std::ios::app : std::ios::trunc);
+  if (header)
+    {
+      file << Header () << "\n";
+      file.flush ();
+    }
+
+  // Running workers, with the pipe they write their row to
+  std::map<pid_t, int> workers;
+  std::vector<Point>::const_iterator next = points.begin ();
+  while (next != points.end () || !workers.empty ())
+    {
+      if (next != points.end () && workers.size () < jobs)
+        {
+          int fds[2];
+          if (pipe (fds) != 0)
+            {
+              NS_FATAL_ERROR ("Cannot create a pipe to a worker");
+            }
+          std::cout.flush ();
+          file.flush ();
+          pid_t pid = fork ();
+          if (pid < 0)
+            {
+              NS_FATAL_ERROR ("Cannot fork a worker");
+            }
+          if (pid == 0)
+            {
+              close (fds[0]);
+              std::string row = Simulate (*next);
+              bool written = write (fds[1], row.data (), row.size ()) == ssize_t (row.size ());
+              close (fds[1]);
+              // Skip the destructors of the parent's state, the file among them
+              _exit (written ? 0 : 1);
+            }
+          close (fds[1]);
+          workers[pid] = fds[0];
+          ++next;
+          continue;
+        }
+
+      int status;
+      pid_t pid = waitpid (-1, &status, 0);
+      std::map<pid_t, int>::iterator worker = workers.find (pid);
+      if (worker == workers.end ())
+        {
+          continue;
+        }
+      std::string row;
+      char buffer[512];
+      ssize_t n;
+      while ((n = read (worker->second, buffer, sizeof (buffer))) > 0)
+        {
+          row.append (buffer, n);
+        }
+      close (worker->second);
+      workers.erase (worker);
+      if (WIFEXITED (status) && WEXITSTATUS (status) == 0 && !row.empty ())
+        {
+          file << row;
+          file.flush ();
+          done++;
+        }
+      else
+        {
+          std::cerr << "Worker " << pid << " failed\n";
+          failed++;
+        }
+    }
+}
+
+void
+aodvDbscanSweep::Report (std::ostream & os)
+{
+  os << "Simulations run: " << done << ", skipped: " << skipped << ", failed: " << failed << "\n";
+  os << "Results in " << output << "\n";
+}
+
+std::vector<std::string>
+aodvDbscanSweep::Split (std::string const & list)
+{
+  std::vector<std::string> values;
+  std::istringstream is (list);
+  std::string value;
+  while (std::getline (is, value, ','))
+    {
+      if (!value.empty ())
+        {
+          values.push_back (value);
+        }
+    }
+  return values;
+}
+
+std::string
+aodvDbscanSweep::Header ()
+{
+  return "epsilon,minPts,helloInterval,activeRouteTimeout,seed,run,size,side,speed,flows,rate,time,"
+         "txPackets,rxPackets,pdr,meanDelay,controlPackets,normalizedRoutingLoad,wallClock";
+}
+
+std::string
+aodvDbscanSweep::Format (double value)
+{
+  // 0.3 and 0.30 are the same point, 15 digits leave the binary rounding out
+  std::ostringstream os;
+  os << std::setprecision (15) << value;
+  return os.str ();
+}
+
+std::string
+aodvDbscanSweep::Key (Point const & point) const
+{
+  const double values[] = { std::atof (point.epsilon.c_str ()), std::atof (point.minPts.c_str ()),
+                            std::atof (point.helloInterval.c_str ()), std::atof (point.activeRouteTimeout.c_str ()),
+                            double (seed), double (point.run), double (size), side, speed, double (flows), rate,
+                            totalTime };
+  std::ostringstream os;
+  for (uint32_t i = 0; i < sizeof (values) / sizeof (values[0]); ++i)
+    {
+      os << (i ? "," : "") << Format (values[i]);
+    }
+  return os.str ();
+}
+
+std::set<std::string>
+aodvDbscanSweep::LoadDone ()
+{
+  std::set<std::string> keys;
+  std::ifstream file (output.c_str ());
+  std::string line;
+  bool newline = true;
+  while (std::getline (file, line))
+    {
+      // A row cut short by an interruption misses its newline, and maybe columns
+      if (file.eof ())
+        {
+          newline = line.empty ();
+          continue;
+        }
+      if (!line.empty () && line[0] == 'e' && line != Header ())
+        {
+          NS_FATAL_ERROR (output << " holds the results of another version of the sweep, use another --output");
+        }
+      if (line.empty () || line[0] == 'e' || std::count (line.begin (), line.end (), ',') != 18)
+        {
+          continue;
+        }
+      // The parameters up to the simulation time, written again as Key writes them
+      std::istringstream is (line);
+      std::ostringstream key;
+      std::string column;
+      for (int i = 0; i < 12 && std::getline (is, column, ','); ++i)
+        {
+          key << (i ? "," : "") << Format (std::atof (column.c_str ()));
+        }
+      keys.insert (key.str ());
+    }
+  if (!newline)
+    {
+      // Rows are appended after the cut one, not to it
+      std::ofstream append (output.c_str (), std::ios::app);
+      append << "\n";
+    }
+  return keys;
+}
+
+std::string
+aodvDbscanSweep::Simulate (Point const & point)
+{
+  SeedManager::SetSeed (seed);
+  SeedManager::SetRun (point.run);
+
+  NodeContainer nodes;
+  nodes.Create (size);
+
+  std::ostringstream bound;
+  bound << "ns3::UniformRandomVariable[Min=0.0|Max=" << side << "]";
+  ObjectFactory allocator;
+  allocator.SetTypeId ("ns3::RandomRectanglePositionAllocator");
+  allocator.Set ("X", StringValue (bound.str ()));
+  allocator.Set ("Y", StringValue (bound.str ()));
+  Ptr<PositionAllocator> positions = allocator.Create ()->GetObject<PositionAllocator> ();
+  std::ostringstream velocity;
+  velocity << "ns3::UniformRandomVariable[Min=1.0|Max=" << speed << "]";
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::RandomWaypointMobilityModel",
+                             "Speed", StringValue (velocity.str ()),
+                             "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"),
+                             "PositionAllocator", PointerValue (positions));
+  mobility.Install (nodes);
+
+  aodvDbscanScenarioHelper scenario;
+  NetDeviceContainer devices = scenario.InstallDevices (nodes);
+
+  aodvDbscanHelper routing;
+  routing.Set ("EnableHello", BooleanValue (true));
+  routing.Set ("Epsilon", DoubleValue (std::atof (point.epsilon.c_str ())));
+  routing.Set ("MinPts", UintegerValue (std::atoi (point.minPts.c_str ())));
+  routing.Set ("HelloInterval", TimeValue (Seconds (std::atof (point.helloInterval.c_str ()))));
+  routing.Set ("ActiveRouteTimeout", TimeValue (Seconds (std::atof (point.activeRouteTimeout.c_str ()))));
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (routing); // has effect on the next Install ()
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+  Config::ConnectWithoutContext ("/NodeList/*/$ns3::aodvDbscan::RoutingProtocol/TxControl",
+                                 MakeCallback (&aodvDbscanSweep::TxControl, this));
+
+  const uint32_t packetSize = 512;
+  scenario.InstallFlows (nodes, interfaces, flows, rate, packetSize, Seconds (5), Seconds (6), Seconds (totalTime));
+
+  FlowMonitorHelper flowHelper;
+  Ptr<FlowMonitor> monitor = flowHelper.InstallAll ();
+
+  Simulator::Stop (Seconds (totalTime));
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Run ();
+  int64_t wallClock = clock.End ();
+
+  monitor->CheckForLostPackets ();
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
+  const FlowMonitor::FlowStatsContainer & stats = monitor->GetFlowStats ();
+  uint64_t txPackets = 0;
+  uint64_t rxPackets = 0;
+  Time delaySum;
+  for (FlowMonitor::FlowStatsContainerCI i = stats.begin (); i != stats.end (); ++i)
+    {
+      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
+      if (t.protocol != 17 || t.destinationPort == aodvDbscan::RoutingProtocol::aodvDbscan_PORT)
+        {
+          continue;
+        }
+      txPackets += i->second.txPackets;
+      rxPackets += i->second.rxPackets;
+      delaySum += i->second.delaySum;
+    }
+  Simulator::Destroy ();
+
+  std::ostringstream row;
+  row << Key (point) << "," << txPackets << "," << rxPackets << ","
+      << (txPackets ? double (rxPackets) / txPackets : 0) << ","
+      << (rxPackets ? delaySum.GetSeconds () / rxPackets : 0) << ","
+      << controlPackets << "," << (rxPackets ? double (controlPackets) / rxPackets : 0) << ","
+      << wallClock << "\n";
+  return row.str ();
+}
+
+void
+aodvDbscanSweep::TxControl (Ptr<const Packet>, Ipv4Address)
+{
+  controlPackets++;
+}
@@ -0,0 +1,12 @@
+#!/bin/sh
+#
+# Launch the aodvDbscan parameter sweep with one worker per core.
+# Run from the top of the ns-3 tree, the arguments are passed to the sweep:
+#
+#   contrib/aodvDbscan/examples/aodvDbscan-sweep.sh --epsilon=0.2,0.3,0.4 --minPts=2,3 --runs=10
+#
+# Interrupt it at any time, running it again with the same --output resumes
+# the sweep. JOBS overrides the number of workers.
+
+JOBS=${JOBS:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)}
+exec ./ns3 run "aodvDbscan-sweep --jobs=$JOBS $*"
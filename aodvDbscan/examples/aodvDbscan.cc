@@ -21,13 +21,18 @@
  */
 
 #include <iostream>
+#include <fstream>
 #include <cmath>
+#include <map>
 #include "ns3/aodvDbscan-module.h"
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/mobility-module.h"
 #include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
 // #include "ns3/v4ping-helper.h"
 // GANTI DENGAN:
 #include "ns3/ping-helper.h"
@@ -51,6 +56,15 @@ using namespace ns3;
  * range, thereby breaking the topology.  By default, this will result in
  * only 34 of 100 pings being received.  If the step size is reduced
  * to cover the gap, then all pings can be received.
+ *
+ * Next to the pings, constant bit rate UDP flows run from the first nodes to
+ * the last ones. They are measured with FlowMonitor, and the control packets
+ * with the TxControl trace of the protocol. The report gives the packet
+ * delivery ratio, the mean and 99th percentile end-to-end delay, the
+ * throughput, the normalized routing load (control packets sent per data
+ * packet delivered) and the RREQs broadcast and unicast. With --output the
+ * same figures are written to a CSV file, one row per run appended under a
+ * single header, or to a JSON file if its name ends in .json.
  */
 class aodvDbscanExample 
 {
@@ -84,6 +98,12 @@ private:
   bool pcap;
   /// Print routes if true
   bool printRoutes;
+  /// Number of CBR flows
+  uint32_t flows;
+  /// Packets per second of each flow
+  double rate;
+  /// File the results are written to, CSV or JSON, none if empty
+  std::string output;
 
   // network
   /// nodes used in the example
@@ -92,6 +112,40 @@ private:
   NetDeviceContainer devices;
   /// interfaces used in the example
   Ipv4InterfaceContainer interfaces;
+  /// network mask of the interfaces
+  Ipv4Mask netmask;
+  /// flow monitor helper
+  FlowMonitorHelper flowHelper;
+  /// flow monitor
+  Ptr<FlowMonitor> monitor;
+
+  // results
+  /// Data packets sent
+  uint64_t txPackets;
+  /// Data packets received
+  uint64_t rxPackets;
+  /// Packet delivery ratio
+  double pdr;
+  /// Mean end-to-end delay, s
+  double meanDelay;
+  /// 99th percentile of the end-to-end delay, s
+  double p99Delay;
+  /// Sum of the flow throughputs, kbps
+  double throughput;
+  /// RREQs sent as broadcast
+  uint64_t rreqBroadcast;
+  /// RREQs sent as unicast
+  uint64_t rreqUnicast;
+  /// RREPs sent
+  uint64_t rrep;
+  /// Hellos sent
+  uint64_t hello;
+  /// RERRs sent
+  uint64_t rerr;
+  /// RREP-ACKs sent
+  uint64_t rrepAck;
+  /// Bytes of all control packets sent
+  uint64_t controlBytes;
 
 private:
   /// Create the nodes
@@ -102,6 +156,29 @@ private:
   void InstallInternetStack ();
   /// Create the simulation applications
   void InstallApplications ();
+  /// Compute the flow statistics, before the simulation is destroyed
+  void CollectResults ();
+  /**
+   * Count a control packet sent by a node
+   * \param packet the control packet
+   * \param destination the neighbor or broadcast address it is sent to
+   */
+  void TxControl (Ptr<const Packet> packet, Ipv4Address destination);
+  /**
+   * \returns the number of control packets sent
+   */
+  uint64_t ControlPackets () const;
+  /**
+   * Write the results as JSON
+   * \param os the output stream
+   */
+  void WriteJson (std::ostream & os) const;
+  /**
+   * Write the results as a CSV row
+   * \param os the output stream
+   * \param header write the column names first if true
+   */
+  void WriteCsv (std::ostream & os, bool header) const;
 };
 
 int main (int argc, char **argv)
@@ -121,7 +198,23 @@ aodvDbscanExample::aodvDbscanExample () :
   step (50),
   totalTime (100),
   pcap (false),
-  printRoutes (false)
+  printRoutes (false),
+  flows (1),
+  rate (4),
+  netmask ("255.0.0.0"),
+  txPackets (0),
+  rxPackets (0),
+  pdr (0),
+  meanDelay (0),
+  p99Delay (0),
+  throughput (0),
+  rreqBroadcast (0),
+  rreqUnicast (0),
+  rrep (0),
+  hello (0),
+  rerr (0),
+  rrepAck (0),
+  controlBytes (0)
 {
 }
 
@@ -139,9 +232,12 @@ aodvDbscanExample::Configure (int argc, char **argv)
   cmd.AddValue ("size", "Number of nodes.", size);
   cmd.AddValue ("time", "Simulation time, s.", totalTime);
   cmd.AddValue ("step", "Grid step, m", step);
+  cmd.AddValue ("flows", "Number of CBR flows.", flows);
+  cmd.AddValue ("rate", "Packets per second of each flow.", rate);
+  cmd.AddValue ("output", "Write the results to this file, as JSON if it ends in .json, CSV otherwise.", output);
 
   cmd.Parse (argc, argv);
-  return true;
+  return size >= 2;
 }
 
 void
@@ -157,12 +253,42 @@ aodvDbscanExample::Run ()
 
   Simulator::Stop (Seconds (totalTime));
   Simulator::Run ();
+  CollectResults ();
   Simulator::Destroy ();
 }
 
 void
-aodvDbscanExample::Report (std::ostream &)
-{ 
+aodvDbscanExample::Report (std::ostream & os)
+{
+  os << "Data packets sent: " << txPackets << ", received: " << rxPackets << "\n";
+  os << "Packet delivery ratio: " << pdr << "\n";
+  os << "Mean delay: " << meanDelay * 1000 << " ms, 99th percentile: " << p99Delay * 1000 << " ms\n";
+  os << "Throughput: " << throughput << " kbps\n";
+  os << "Control packets: " << ControlPackets () << " (" << controlBytes << " bytes)\n";
+  os << "Normalized routing load: " << (rxPackets ? double (ControlPackets ()) / rxPackets : 0) << "\n";
+  os << "RREQ broadcast: " << rreqBroadcast << ", unicast: " << rreqUnicast
+     << ", RREP: " << rrep << ", hello: " << hello << ", RERR: " << rerr << ", RREP-ACK: " << rrepAck << "\n";
+
+  if (output.empty ())
+    {
+      return;
+    }
+  if (output.size () >= 5 && output.compare (output.size () - 5, 5, ".json") == 0)
+    {
+      std::ofstream file (output.c_str ());
+      WriteJson (file);
+    }
+  else
+    {
+      // Rows of successive runs are appended under a single header
+      bool header;
+      {
+        std::ifstream existing (output.c_str ());
+        header = !existing.good () || existing.peek () == std::ifstream::traits_type::eof ();
+      }
+      std::ofstream file (output.c_str (), std::ios::app);
+      WriteCsv (file, header);
+    }
 }
 
 void
@@ -218,9 +344,13 @@ aodvDbscanExample::InstallInternetStack ()
   stack.SetRoutingHelper (aodvDbscan); // has effect on the next Install ()
   stack.Install (nodes);
   Ipv4AddressHelper address;
-  address.SetBase ("10.0.0.0", "255.0.0.0");
+  address.SetBase ("10.0.0.0", netmask);
   interfaces = address.Assign (devices);
 
+  Config::ConnectWithoutContext ("/NodeList/*/$ns3::aodvDbscan::RoutingProtocol/TxControl",
+                                 MakeCallback (&aodvDbscanExample::TxControl, this));
+  monitor = flowHelper.InstallAll ();
+
   if (printRoutes)
     {
       Ptr<OutputStreamWrapper> routingStream = Create<OutputStreamWrapper> ("aodvDbscan.routes", std::ios::out);
@@ -242,5 +372,146 @@ aodvDbscanExample::InstallApplications ()
   Ptr<Node> node = nodes.Get (size/2);
   Ptr<MobilityModel> mob = node->GetObject<MobilityModel> ();
   Simulator::Schedule (Seconds (totalTime/3), &MobilityModel::SetPosition, mob, Vector (1e5, 1e5, 1e5));
+
+  // CBR flows from the first nodes to the last ones
+  const uint16_t port = 9;
+  const uint32_t packetSize = 512;
+  for (uint32_t i = 0; i < flows; ++i)
+    {
+      uint32_t src = i % size;
+      uint32_t dst = size - 1 - src;
+      if (src == dst)
+        {
+          continue;
+        }
+      PacketSinkHelper sink ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port + i));
+      ApplicationContainer s = sink.Install (nodes.Get (dst));
+      s.Start (Seconds (0));
+
+      OnOffHelper onoff ("ns3::UdpSocketFactory", InetSocketAddress (interfaces.GetAddress (dst), port + i));
+      onoff.SetConstantRate (DataRate (uint64_t (rate * packetSize * 8)), packetSize);
+      ApplicationContainer c = onoff.Install (nodes.Get (src));
+      c.Start (Seconds (1 + 0.1 * i));
+      c.Stop (Seconds (totalTime) - Seconds (0.001));
+    }
+}
+
+void
+aodvDbscanExample::CollectResults ()
+{
+  monitor->CheckForLostPackets ();
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
+  const FlowMonitor::FlowStatsContainer & stats = monitor->GetFlowStats ();
+  Time delaySum;
+  // Delay histograms of all flows merged, by bin end
+  std::map<double, uint64_t> delays;
+  for (FlowMonitor::FlowStatsContainerCI i = stats.begin (); i != stats.end (); ++i)
+    {
+      // Only the CBR flows, not the control traffic
+      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
+      if (t.protocol != 17 || t.destinationPort == aodvDbscan::RoutingProtocol::aodvDbscan_PORT)
+        {
+          continue;
+        }
+      txPackets += i->second.txPackets;
+      rxPackets += i->second.rxPackets;
+      delaySum += i->second.delaySum;
+      Time active = i->second.timeLastRxPacket - i->second.timeFirstTxPacket;
+      if (active.IsStrictlyPositive ())
+        {
+          throughput += i->second.rxBytes * 8.0 / active.GetSeconds () / 1000;
+        }
+      const Histogram & histogram = i->second.delayHistogram;
+      for (uint32_t bin = 0; bin < histogram.GetNBins (); ++bin)
+        {
+          delays[histogram.GetBinEnd (bin)] += histogram.GetBinCount (bin);
+        }
+    }
+  pdr = txPackets ? double (rxPackets) / txPackets : 0;
+  meanDelay = rxPackets ? delaySum.GetSeconds () / rxPackets : 0;
+  uint64_t seen = 0;
+  for (std::map<double, uint64_t>::const_iterator i = delays.begin (); i != delays.end (); ++i)
+    {
+      seen += i->second;
+      if (seen >= 0.99 * rxPackets)
+        {
+          p99Delay = i->first;
+          break;
+        }
+    }
+}
+
+void
+aodvDbscanExample::TxControl (Ptr<const Packet> packet, Ipv4Address destination)
+{
+  aodvDbscan::TypeHeader tHeader;
+  packet->PeekHeader (tHeader);
+  bool broadcast = destination.IsBroadcast () || destination.IsSubnetDirectedBroadcast (netmask);
+  controlBytes += packet->GetSize ();
+  switch (tHeader.Get ())
+    {
+    case aodvDbscan::aodvDbscanTYPE_RREQ:
+      (broadcast ? rreqBroadcast : rreqUnicast)++;
+      break;
+    case aodvDbscan::aodvDbscanTYPE_RREP:
+      // Hellos are the only broadcast RREPs
+      (broadcast ? hello : rrep)++;
+      break;
+    case aodvDbscan::aodvDbscanTYPE_RERR:
+      rerr++;
+      break;
+    case aodvDbscan::aodvDbscanTYPE_RREP_ACK:
+      rrepAck++;
+      break;
+    }
+}
+
+uint64_t
+aodvDbscanExample::ControlPackets () const
+{
+  return rreqBroadcast + rreqUnicast + rrep + hello + rerr + rrepAck;
+}
+
+void
+aodvDbscanExample::WriteJson (std::ostream & os) const
+{
+  os << "{\n"
+     << "  \"size\": " << size << ",\n"
+     << "  \"step\": " << step << ",\n"
+     << "  \"time\": " << totalTime << ",\n"
+     << "  \"flows\": " << flows << ",\n"
+     << "  \"rate\": " << rate << ",\n"
+     << "  \"txPackets\": " << txPackets << ",\n"
+     << "  \"rxPackets\": " << rxPackets << ",\n"
+     << "  \"pdr\": " << pdr << ",\n"
+     << "  \"meanDelay\": " << meanDelay << ",\n"
+     << "  \"p99Delay\": " << p99Delay << ",\n"
+     << "  \"throughputKbps\": " << throughput << ",\n"
+     << "  \"controlPackets\": " << ControlPackets () << ",\n"
+     << "  \"controlBytes\": " << controlBytes << ",\n"
+     << "  \"normalizedRoutingLoad\": " << (rxPackets ? double (ControlPackets ()) / rxPackets : 0) << ",\n"
+     << "  \"rreqBroadcast\": " << rreqBroadcast << ",\n"
+     << "  \"rreqUnicast\": " << rreqUnicast << ",\n"
+     << "  \"rrep\": " << rrep << ",\n"
+     << "  \"hello\": " << hello << ",\n"
+     << "  \"rerr\": " << rerr << ",\n"
+     << "  \"rrepAck\": " << rrepAck << "\n"
+     << "}\n";
+}
+
+void
+aodvDbscanExample::WriteCsv (std::ostream & os, bool header) const
+{
+  if (header)
+    {
+      os << "size,step,time,flows,rate,txPackets,rxPackets,pdr,meanDelay,p99Delay,throughputKbps,"
+         << "controlPackets,controlBytes,normalizedRoutingLoad,rreqBroadcast,rreqUnicast,rrep,hello,rerr,rrepAck\n";
+    }
+  os << size << "," << step << "," << totalTime << "," << flows << "," << rate << ","
+     << txPackets << "," << rxPackets << "," << pdr << "," << meanDelay << "," << p99Delay << ","
+     << throughput << "," << ControlPackets () << "," << controlBytes << ","
+     << (rxPackets ? double (ControlPackets ()) / rxPackets : 0) << ","
+     << rreqBroadcast << "," << rreqUnicast << "," << rrep << "," << hello << ","
+     << rerr << "," << rrepAck << "\n";
 }
 
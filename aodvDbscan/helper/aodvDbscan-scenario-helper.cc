@@ -0,0 +1,89 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "aodvDbscan-scenario-helper.h"
+#include "ns3/data-rate.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/on-off-helper.h"
+#include "ns3/packet-sink-helper.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/wifi-helper.h"
+#include "ns3/wifi-mac-helper.h"
+#include "ns3/yans-wifi-helper.h"
+
+namespace ns3
+{
+
+aodvDbscanScenarioHelper::aodvDbscanScenarioHelper () :
+  m_pick (CreateObject<UniformRandomVariable> ())
+{
+}
+
+NetDeviceContainer
+aodvDbscanScenarioHelper::InstallDevices (NodeContainer nodes) const
+{
+  WifiMacHelper wifiMac;
+  wifiMac.SetType ("ns3::AdhocWifiMac");
+  YansWifiPhyHelper wifiPhy;
+  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
+  wifiPhy.SetChannel (wifiChannel.Create ());
+  WifiHelper wifi;
+  wifi.SetStandard (WIFI_STANDARD_80211a);
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("OfdmRate6Mbps"), "RtsCtsThreshold", UintegerValue (0));
+  return wifi.Install (wifiPhy, wifiMac, nodes);
+}
+
+ApplicationContainer
+aodvDbscanScenarioHelper::InstallFlows (NodeContainer nodes, Ipv4InterfaceContainer const & interfaces,
+                                        uint32_t flows, double rate, uint32_t packetSize,
+                                        Time firstStart, Time lastStart, Time stop)
+{
+  const uint16_t port = 9;
+  ApplicationContainer sinks;
+  for (uint32_t i = 0; i < flows; ++i)
+    {
+      uint32_t src = m_pick->GetInteger (0, nodes.GetN () - 1);
+      uint32_t dst = m_pick->GetInteger (0, nodes.GetN () - 2);
+      if (dst >= src)
+        {
+          dst++;
+        }
+      PacketSinkHelper sink ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port + i));
+      sinks.Add (sink.Install (nodes.Get (dst)));
+
+      OnOffHelper onoff ("ns3::UdpSocketFactory", InetSocketAddress (interfaces.GetAddress (dst), port + i));
+      onoff.SetConstantRate (DataRate (uint64_t (rate * packetSize * 8)), packetSize);
+      ApplicationContainer app = onoff.Install (nodes.Get (src));
+      app.Start (Seconds (m_pick->GetValue (firstStart.GetSeconds (), lastStart.GetSeconds ())));
+      app.Stop (stop);
+    }
+  sinks.Start (Seconds (0));
+  sinks.Stop (stop);
+  return sinks;
+}
+
+int64_t
+aodvDbscanScenarioHelper::AssignStreams (NetDeviceContainer devices, int64_t stream)
+{
+  WifiHelper wifi;
+  int64_t currentStream = stream;
+  currentStream += wifi.AssignStreams (devices, currentStream);
+  m_pick->SetStream (currentStream++);
+  return (currentStream - stream);
+}
+
+}
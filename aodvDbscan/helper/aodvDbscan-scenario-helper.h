@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef aodvDbscan_SCENARIO_HELPER_H
+#define aodvDbscan_SCENARIO_HELPER_H
+
+#include "ns3/application-container.h"
+#include "ns3/ipv4-interface-container.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
+
+namespace ns3 {
+/**
+ * \ingroup aodvDbscan
+ * \brief Helper class that builds what the aodvDbscan benchmark examples have in
+ * common: the ad hoc wifi devices and the constant bit rate flows between random nodes.
+ */
+class aodvDbscanScenarioHelper
+{
+public:
+  aodvDbscanScenarioHelper ();
+
+  /**
+   * Install an ad hoc 802.11a device sending at 6 Mbit/s, RTS/CTS always on, on every
+   * node. All the devices share one default YANS channel.
+   * \param nodes the nodes
+   * \returns the devices
+   */
+  NetDeviceContainer InstallDevices (NodeContainer nodes) const;
+  /**
+   * Install UDP flows between random pairs of distinct nodes. Flow i goes to port 9 + i
+   * of a packet sink running from time 0, its source starts at a random time between
+   * firstStart and lastStart.
+   * \param nodes the nodes
+   * \param interfaces the IPv4 interfaces of the nodes, in the same order
+   * \param flows the number of flows
+   * \param rate packets per second of each flow
+   * \param packetSize the size of the data packets, bytes
+   * \param firstStart the earliest start of a source
+   * \param lastStart the latest start of a source
+   * \param stop when the sources and the sinks stop
+   * \returns the sinks
+   */
+  ApplicationContainer InstallFlows (NodeContainer nodes, Ipv4InterfaceContainer const & interfaces,
+                                     uint32_t flows, double rate, uint32_t packetSize,
+                                     Time firstStart, Time lastStart, Time stop);
+  /**
+   * Assign fixed random variable streams to the devices and to the choice of the flows,
+   * so that two runs see the same scenario
+   *
+   * \param devices the devices installed by InstallDevices
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this helper
+   */
+  int64_t AssignStreams (NetDeviceContainer devices, int64_t stream);
+
+private:
+  /// Picks the ends and the start of the flows
+  Ptr<UniformRandomVariable> m_pick;
+};
+
+}
+
+#endif /* aodvDbscan_SCENARIO_HELPER_H */
@@ -21,6 +21,9 @@
  */
 
 #include "aodvDbscan-dpd.h"
+#include "ns3/assert.h"
+#include <algorithm>
+#include <cmath>
 
 namespace ns3 {
 namespace aodvDbscan {
@@ -28,12 +31,26 @@ namespace aodvDbscan {
 bool
 DuplicatePacketDetection::IsDuplicate  (Ptr<const Packet> p, const Ipv4Header & header)
 {
+  if (m_bloomEnabled)
+    {
+      return IsDuplicateBloom ((static_cast<uint64_t> (header.GetSource ().Get ()) << 32) | p->GetUid ());
+    }
   return m_idCache.IsDuplicate (header.GetSource (), p->GetUid () );
 }
 void
 DuplicatePacketDetection::SetLifetime (Time lifetime)
 {
   m_idCache.SetLifetime (lifetime);
+  if (m_bloomEnabled)
+    {
+      // Half lifetime periods changed, start over with empty filters
+      for (uint32_t i = 0; i < BloomFilters; ++i)
+        {
+          std::fill (m_bloomFilter[i].begin (), m_bloomFilter[i].end (), 0);
+        }
+      m_bloomEpoch = 0;
+      RotateBloomFilters ();
+    }
 }
 
 Time
@@ -42,7 +59,107 @@ DuplicatePacketDetection::GetLifetime () const
   return m_idCache.GetLifeTime ();
 }
 
+void
+DuplicatePacketDetection::EnableBloomFilter (uint32_t capacity, double falsePositiveRate)
+{
+  NS_ASSERT (capacity > 0);
+  NS_ASSERT (falsePositiveRate > 0 && falsePositiveRate < 1);
+  // A packet is checked against all filters, split the rate between them.
+  // Each filter collects the packets of half a lifetime.
+  double rate = falsePositiveRate / BloomFilters;
+  double n = std::max (1.0, capacity / 2.0);
+  double bits = std::ceil (-n * std::log (rate) / (std::log (2.0) * std::log (2.0)));
+  m_bloomBits = std::max (64u, static_cast<uint32_t> (bits));
+  m_bloomHashes = std::max (1u, static_cast<uint32_t> (std::floor (m_bloomBits / n * std::log (2.0) + 0.5)));
+  for (uint32_t i = 0; i < BloomFilters; ++i)
+    {
+      m_bloomFilter[i].assign ((m_bloomBits + 63) / 64, 0);
+    }
+  m_bloomCurrent = 0;
+  m_bloomEpoch = 0;
+  m_bloomEnabled = true;
+  RotateBloomFilters ();
+}
+
+void
+DuplicatePacketDetection::DisableBloomFilter ()
+{
+  m_bloomEnabled = false;
+  for (uint32_t i = 0; i < BloomFilters; ++i)
+    {
+      std::vector<uint64_t> ().swap (m_bloomFilter[i]);
+    }
+}
+
+uint32_t
+DuplicatePacketDetection::GetBloomFilterSize () const
+{
+  uint32_t size = 0;
+  for (uint32_t i = 0; i < BloomFilters; ++i)
+    {
+      size += m_bloomFilter[i].size () * sizeof (uint64_t);
+    }
+  return size;
+}
 
+void
+DuplicatePacketDetection::RotateBloomFilters ()
+{
+  int64_t period = std::max<int64_t> (1, m_idCache.GetLifeTime ().GetTimeStep () / 2);
+  int64_t epoch = Simulator::Now ().GetTimeStep () / period;
+  if (epoch == m_bloomEpoch)
+    {
+      return;
+    }
+  // At most all filters have to be cleared, however long nothing was received
+  int64_t steps = std::min (epoch - m_bloomEpoch, static_cast<int64_t> (BloomFilters));
+  for (int64_t i = 0; i < steps; ++i)
+    {
+      m_bloomCurrent = (m_bloomCurrent + 1) % BloomFilters;
+      std::fill (m_bloomFilter[m_bloomCurrent].begin (), m_bloomFilter[m_bloomCurrent].end (), 0);
+    }
+  m_bloomEpoch = epoch;
 }
+
+bool
+DuplicatePacketDetection::IsDuplicateBloom (uint64_t key)
+{
+  RotateBloomFilters ();
+  // Double hashing over two halves of a 64 bit mix of the key
+  uint64_t h = key + 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  h = h ^ (h >> 31);
+  uint32_t h1 = static_cast<uint32_t> (h);
+  uint32_t h2 = static_cast<uint32_t> (h >> 32) | 1;
+
+  bool found[BloomFilters];
+  for (uint32_t f = 0; f < BloomFilters; ++f)
+    {
+      found[f] = true;
+    }
+  for (uint32_t i = 0; i < m_bloomHashes; ++i)
+    {
+      uint32_t bit = (h1 + i * h2) % m_bloomBits;
+      for (uint32_t f = 0; f < BloomFilters; ++f)
+        {
+          found[f] = found[f] && ((m_bloomFilter[f][bit / 64] >> (bit % 64)) & 1);
+        }
+    }
+  for (uint32_t f = 0; f < BloomFilters; ++f)
+    {
+      if (found[f])
+        {
+          return true;
+        }
+    }
+  for (uint32_t i = 0; i < m_bloomHashes; ++i)
+    {
+      uint32_t bit = (h1 + i * h2) % m_bloomBits;
+      m_bloomFilter[m_bloomCurrent][bit / 64] |= (uint64_t (1) << (bit % 64));
+    }
+  return false;
 }
 
+}
+}
@@ -27,6 +27,7 @@
 #include "ns3/nstime.h"
 #include "ns3/packet.h"
 #include "ns3/ipv4-header.h"
+#include <vector>
 
 namespace ns3 {
 namespace aodvDbscan {
@@ -37,6 +38,13 @@ namespace aodvDbscan {
  *
  * Currently duplicate detection is based on unique packet ID given by Packet::GetUid ()
  * This approach is known to be weak (ns3::Packet UID is an internal identifier and not intended for logical uniqueness in models) and should be changed.
+ *
+ * By default every packet seen is remembered exactly in an IdCache, so memory grows with
+ * the broadcast rate. Optionally the packets can be remembered in three rotating Bloom
+ * filters instead: each filter collects the packets of half a lifetime, and the oldest
+ * one is cleared whenever a new half starts. A packet is thus remembered for at least
+ * one lifetime, memory is fixed by the expected number of packets per lifetime and the
+ * target false positive rate, and a false positive drops a packet that is not a duplicate.
  */
 class DuplicatePacketDetection
 {
@@ -45,7 +53,12 @@ public:
    * Constructor
    * \param lifetime the lifetime for added entries
    */
-  DuplicatePacketDetection (Time lifetime) : m_idCache (lifetime)
+  DuplicatePacketDetection (Time lifetime) : m_idCache (lifetime),
+                                             m_bloomEnabled (false),
+                                             m_bloomBits (0),
+                                             m_bloomHashes (0),
+                                             m_bloomCurrent (0),
+                                             m_bloomEpoch (0)
   {
   }
   /**
@@ -65,9 +78,50 @@ public:
    * \returns the duplicate record lifetime
    */
   Time GetLifetime () const;
+  /**
+   * Remember packets in rotating Bloom filters instead of the exact ID cache.
+   * \param capacity the expected number of packets seen within one lifetime
+   * \param falsePositiveRate the target probability of reporting a new packet as duplicate
+   */
+  void EnableBloomFilter (uint32_t capacity, double falsePositiveRate);
+  /// Go back to remembering packets in the exact ID cache
+  void DisableBloomFilter ();
+  /**
+   * \returns true if packets are remembered in Bloom filters
+   */
+  bool IsBloomFilterEnabled () const
+  {
+    return m_bloomEnabled;
+  }
+  /**
+   * \returns the memory used by the Bloom filters in bytes
+   */
+  uint32_t GetBloomFilterSize () const;
 private:
+  /// Number of rotating Bloom filters
+  static const uint32_t BloomFilters = 3;
+  /**
+   * Check the packet against the Bloom filters and insert it into the current one
+   * \param key the packet key
+   * \returns true if all filters may contain the packet
+   */
+  bool IsDuplicateBloom (uint64_t key);
+  /// Clear the filters whose half lifetime is over
+  void RotateBloomFilters ();
   /// Impl
   IdCache m_idCache;
+  /// Whether Bloom filters replace the ID cache
+  bool m_bloomEnabled;
+  /// Number of bits per filter
+  uint32_t m_bloomBits;
+  /// Number of hash functions
+  uint32_t m_bloomHashes;
+  /// Bit arrays of the filters
+  std::vector<uint64_t> m_bloomFilter[BloomFilters];
+  /// Index of the filter packets are inserted into
+  uint32_t m_bloomCurrent;
+  /// Half lifetime period the current filter belongs to
+  int64_t m_bloomEpoch;
 };
 
 }
@@ -26,6 +26,7 @@
  *          Pavel Boyko <boyko@iitp.ru>
  */
 #include "aodvDbscan-id-cache.h"
+#include "ns3/assert.h"
 #include <algorithm>
 
 namespace ns3 {
@@ -33,27 +34,98 @@ namespace aodvDbscan {
 bool
 IdCache::IsDuplicate (Ipv4Address addr, uint32_t id)
 {
-  Purge ();
-  for (std::vector<UniqueId>::const_iterator i = m_idCache.begin ();
-       i != m_idCache.end (); ++i)
+  Time now = Simulator::Now ();
+  PurgeBuckets (now);
+  uint64_t key = MakeKey (addr, id);
+  Time expire = m_lifetime + now;
+  std::pair<std::unordered_map<uint64_t, Time>::iterator, bool> result =
+    m_idCache.insert (std::make_pair (key, expire));
+  if (!result.second)
     {
-      if (i->m_context == addr && i->m_id == id)
+      if (!(result.first->second < now))
         {
           return true;
         }
+      // Expired, but its bucket is not purged yet: record it again
+      result.first->second = expire;
+    }
+
+  int64_t slot = expire.GetTimeStep () / m_granularity.GetTimeStep ();
+  if (m_buckets.empty () || m_buckets.back ().m_slot < slot)
+    {
+      Bucket bucket;
+      bucket.m_slot = slot;
+      m_buckets.push_back (bucket);
+      m_buckets.back ().m_keys.push_back (key);
+    }
+  else if (m_buckets.back ().m_slot == slot)
+    {
+      m_buckets.back ().m_keys.push_back (key);
+    }
+  else
+    {
+      // Lifetime was shortened, file the entry among the older buckets
+      std::deque<Bucket>::iterator i = m_buckets.begin ();
+      while (i->m_slot < slot)
+        {
+          ++i;
+        }
+      if (i->m_slot != slot)
+        {
+          Bucket bucket;
+          bucket.m_slot = slot;
+          i = m_buckets.insert (i, bucket);
+        }
+      i->m_keys.push_back (key);
     }
-  struct UniqueId uniqueId =
-  {
-    addr, id, m_lifetime + Simulator::Now ()
-  };
-  m_idCache.push_back (uniqueId);
   return false;
 }
+
+void
+IdCache::PurgeBuckets (Time now)
+{
+  int64_t step = m_granularity.GetTimeStep ();
+  while (!m_buckets.empty () && (m_buckets.front ().m_slot + 1) * step <= now.GetTimeStep ())
+    {
+      const std::vector<uint64_t> & keys = m_buckets.front ().m_keys;
+      for (std::vector<uint64_t>::const_iterator k = keys.begin (); k != keys.end (); ++k)
+        {
+          std::unordered_map<uint64_t, Time>::iterator i = m_idCache.find (*k);
+          // The key may have been recorded again and filed in a later bucket
+          if (i != m_idCache.end () && i->second < now)
+            {
+              m_idCache.erase (i);
+            }
+        }
+      m_buckets.pop_front ();
+    }
+}
+
 void
 IdCache::Purge ()
 {
-  m_idCache.erase (remove_if (m_idCache.begin (), m_idCache.end (),
-                              IsExpired ()), m_idCache.end ());
+  Time now = Simulator::Now ();
+  PurgeBuckets (now);
+  if (m_buckets.empty ())
+    {
+      return;
+    }
+  // The oldest bucket may still hold a mix of expired and live entries
+  std::vector<uint64_t> & keys = m_buckets.front ().m_keys;
+  std::vector<uint64_t>::iterator last = keys.begin ();
+  for (std::vector<uint64_t>::iterator k = keys.begin (); k != keys.end (); ++k)
+    {
+      std::unordered_map<uint64_t, Time>::iterator i = m_idCache.find (*k);
+      if (i != m_idCache.end () && i->second < now)
+        {
+          m_idCache.erase (i);
+        }
+      else
+        {
+          *last++ = *k;
+        }
+    }
+  keys.erase (last, keys.end ());
 }
 
 uint32_t
@@ -63,5 +135,35 @@ IdCache::GetSize ()
   return m_idCache.size ();
 }
 
+void
+IdCache::SetBucketGranularity (Time granularity)
+{
+  NS_ASSERT (granularity.IsStrictlyPositive ());
+  if (granularity == m_granularity)
+    {
+      return;
+    }
+  m_granularity = granularity;
+  // Slots are not comparable across granularities, file all entries again
+  m_buckets.clear ();
+  std::vector<std::pair<int64_t, uint64_t> > entries;
+  entries.reserve (m_idCache.size ());
+  for (std::unordered_map<uint64_t, Time>::const_iterator i = m_idCache.begin (); i != m_idCache.end (); ++i)
+    {
+      entries.push_back (std::make_pair (i->second.GetTimeStep () / m_granularity.GetTimeStep (), i->first));
+    }
+  std::sort (entries.begin (), entries.end ());
+  for (std::vector<std::pair<int64_t, uint64_t> >::const_iterator i = entries.begin (); i != entries.end (); ++i)
+    {
+      if (m_buckets.empty () || m_buckets.back ().m_slot != i->first)
+        {
+          Bucket bucket;
+          bucket.m_slot = i->first;
+          m_buckets.push_back (bucket);
+        }
+      m_buckets.back ().m_keys.push_back (i->second);
+    }
+}
+
 }
 }
@@ -31,7 +31,9 @@
 
 #include "ns3/ipv4-address.h"
 #include "ns3/simulator.h"
+#include <deque>
 #include <vector>
+#include <unordered_map>
 
 namespace ns3 {
 namespace aodvDbscan {
@@ -39,6 +41,11 @@ namespace aodvDbscan {
  * \ingroup aodvDbscan
  *
  * \brief Unique packets identification cache used for simple duplicate detection.
+ *
+ * Entries are kept in a hash table keyed by (address, id), so a lookup does not
+ * depend on the number of cached entries. For expiry every entry is also filed in
+ * a bucket covering a fixed slice of expiration time; buckets are kept ordered,
+ * so purging only has to look at the oldest buckets.
  */
 class IdCache
 {
@@ -47,7 +54,8 @@ public:
    * constructor
    * \param lifetime the lifetime for added entries
    */
-  IdCache (Time lifetime) : m_lifetime (lifetime)
+  IdCache (Time lifetime) : m_lifetime (lifetime),
+                            m_granularity (MilliSeconds (100))
   {
   }
   /**
@@ -79,37 +87,50 @@ public:
   {
     return m_lifetime;
   }
+  /**
+   * Set the span of expiration time covered by one expiry bucket.
+   * \param granularity the bucket width, must be positive
+   */
+  void SetBucketGranularity (Time granularity);
+  /**
+   * \returns the span of expiration time covered by one expiry bucket
+   */
+  Time GetBucketGranularity () const
+  {
+    return m_granularity;
+  }
 private:
-  /// Unique packet ID
-  struct UniqueId
+  /// Expiry bucket: keys of all entries expiring within one granularity slice
+  struct Bucket
   {
-    /// ID is supposed to be unique in single address context (e.g. sender address)
-    Ipv4Address m_context;
-    /// The id
-    uint32_t m_id;
-    /// When record will expire
-    Time m_expire;
+    /// Slice index, expiration time divided by the granularity
+    int64_t m_slot;
+    /// Keys filed in this bucket
+    std::vector<uint64_t> m_keys;
   };
   /**
-   * \brief IsExpired structure
+   * Build the hash key of the (addr, id) pair
+   * \param addr the IP address
+   * \param id the ID
+   * \returns the key
    */
-  struct IsExpired
+  static uint64_t MakeKey (Ipv4Address addr, uint32_t id)
   {
-    /**
-     * \brief Check if the entry is expired
-     *
-     * \param u UniqueId entry
-     * \return true if expired, false otherwise
-     */
-    bool operator() (const struct UniqueId & u) const
-    {
-      return (u.m_expire < Simulator::Now ());
-    }
-  };
-  /// Already seen IDs
-  std::vector<UniqueId> m_idCache;
+    return (static_cast<uint64_t> (addr.Get ()) << 32) | id;
+  }
+  /**
+   * Drop the buckets whose whole slice has expired
+   * \param now the current time
+   */
+  void PurgeBuckets (Time now);
+  /// Already seen IDs and their expiration time
+  std::unordered_map<uint64_t, Time> m_idCache;
+  /// Expiry buckets ordered by slot
+  std::deque<Bucket> m_buckets;
   /// Default lifetime for ID records
   Time m_lifetime;
+  /// Width of the expiry buckets
+  Time m_granularity;
 };
 
 }  // namespace aodvDbscan
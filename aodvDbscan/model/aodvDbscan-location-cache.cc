@@ -0,0 +1,240 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "aodvDbscan-location-cache.h"
+#include "ns3/simulator.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("aodvDbscanLocationCache");
+
+namespace aodvDbscan {
+
+LocationCache::LocationCache (uint32_t capacity, Time maxAge)
+  : m_capacity (std::max<uint32_t> (1, capacity)),
+    m_maxAge (maxAge),
+    m_halfLife (Seconds (10)),
+    m_maxExtrapolation (Seconds (5))
+{
+}
+
+void
+LocationCache::SetPosition (Ipv4Address addr, Position position, Time sampled)
+{
+  std::map<Ipv4Address, Entry>::iterator i = m_entries.find (addr);
+  if (i == m_entries.end ())
+    {
+      Entry entry;
+      entry.m_hasVelocity = false;
+      entry.m_velocityX = 0;
+      entry.m_velocityY = 0;
+      m_lru.push_front (addr);
+      entry.m_lru = m_lru.begin ();
+      i = m_entries.insert (std::make_pair (addr, entry)).first;
+      Evict ();
+    }
+  else
+    {
+      Touch (i->second);
+    }
+  i->second.m_position = position;
+  i->second.m_sampled = sampled;
+}
+
+bool
+LocationCache::SetVelocity (Ipv4Address addr, double vx, double vy, Time sampled)
+{
+  std::map<Ipv4Address, Entry>::iterator i = m_entries.find (addr);
+  if (i == m_entries.end ())
+    {
+      return false;
+    }
+  i->second.m_hasVelocity = true;
+  i->second.m_velocityX = vx;
+  i->second.m_velocityY = vy;
+  i->second.m_sampled = sampled;
+  Touch (i->second);
+  return true;
+}
+
+bool
+LocationCache::Refresh (Ipv4Address addr, Time sampled)
+{
+  std::map<Ipv4Address, Entry>::iterator i = m_entries.find (addr);
+  if (i == m_entries.end ())
+    {
+      return false;
+    }
+  i->second.m_sampled = sampled;
+  Touch (i->second);
+  return true;
+}
+
+void
+LocationCache::ClearVelocity (Ipv4Address addr)
+{
+  std::map<Ipv4Address, Entry>::iterator i = m_entries.find (addr);
+  if (i != m_entries.end ())
+    {
+      i->second.m_hasVelocity = false;
+    }
+}
+
+bool
+LocationCache::Lookup (Ipv4Address addr, Position & position)
+{
+  std::map<Ipv4Address, Entry>::iterator i = m_entries.find (addr);
+  if (i == m_entries.end ())
+    {
+      return false;
+    }
+  Entry & entry = i->second;
+  if (IsExpired (entry))
+    {
+      NS_LOG_LOGIC ("Position of " << addr << " is too old");
+      m_lru.erase (entry.m_lru);
+      m_entries.erase (i);
+      return false;
+    }
+  Touch (entry);
+  position = entry.m_position;
+  if (!entry.m_hasVelocity)
+    {
+      return true;
+    }
+  double elapsed = std::min (Simulator::Now () - entry.m_sampled, m_maxExtrapolation).GetSeconds ();
+  if (elapsed > 0)
+    {
+      double x = std::max (0.0, entry.m_position.first + entry.m_velocityX * elapsed);
+      double y = std::max (0.0, entry.m_position.second + entry.m_velocityY * elapsed);
+      NS_LOG_LOGIC ("Position of " << addr << " dead reckoned " << elapsed << " s to (" << x << ", " << y << ")");
+      position = std::make_pair (uint32_t (x), uint32_t (y));
+    }
+  return true;
+}
+
+bool
+LocationCache::GetVelocity (Ipv4Address addr, double & vx, double & vy) const
+{
+  std::map<Ipv4Address, Entry>::const_iterator i = m_entries.find (addr);
+  if (i == m_entries.end () || !i->second.m_hasVelocity || IsExpired (i->second))
+    {
+      return false;
+    }
+  vx = i->second.m_velocityX;
+  vy = i->second.m_velocityY;
+  return true;
+}
+
+double
+LocationCache::GetConfidence (Ipv4Address addr) const
+{
+  std::map<Ipv4Address, Entry>::const_iterator i = m_entries.find (addr);
+  if (i == m_entries.end () || IsExpired (i->second))
+    {
+      return 0;
+    }
+  double age = std::max (0.0, (Simulator::Now () - i->second.m_sampled).GetSeconds ());
+  if (m_halfLife.IsStrictlyPositive ())
+    {
+      return std::pow (0.5, age / m_halfLife.GetSeconds ());
+    }
+  return 1;
+}
+
+bool
+LocationCache::IsKnown (Ipv4Address addr) const
+{
+  std::map<Ipv4Address, Entry>::const_iterator i = m_entries.find (addr);
+  return i != m_entries.end () && !IsExpired (i->second);
+}
+
+Time
+LocationCache::LinkLifetime (double dx, double dy, double dvx, double dvy, double range)
+{
+  // Solve |(dx, dy) + t (dvx, dvy)| = range for the positive t
+  double a = dvx * dvx + dvy * dvy;
+  double b = 2 * (dx * dvx + dy * dvy);
+  double c = dx * dx + dy * dy - range * range;
+  if (c >= 0)
+    {
+      return Seconds (0);
+    }
+  if (a == 0)
+    {
+      return Time::Max ();
+    }
+  return Seconds ((-b + std::sqrt (b * b - 4 * a * c)) / (2 * a));
+}
+
+void
+LocationCache::Purge ()
+{
+  for (std::map<Ipv4Address, Entry>::iterator i = m_entries.begin (); i != m_entries.end (); )
+    {
+      if (IsExpired (i->second))
+        {
+          m_lru.erase (i->second.m_lru);
+          m_entries.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+void
+LocationCache::Clear ()
+{
+  m_entries.clear ();
+  m_lru.clear ();
+}
+
+void
+LocationCache::SetCapacity (uint32_t capacity)
+{
+  m_capacity = std::max<uint32_t> (1, capacity);
+  Evict ();
+}
+
+void
+LocationCache::Touch (Entry & entry)
+{
+  m_lru.splice (m_lru.begin (), m_lru, entry.m_lru);
+}
+
+bool
+LocationCache::IsExpired (Entry const & entry) const
+{
+  return Simulator::Now () - entry.m_sampled > m_maxAge;
+}
+
+void
+LocationCache::Evict ()
+{
+  while (m_entries.size () > m_capacity)
+    {
+      NS_LOG_LOGIC ("Evict position of " << m_lru.back ());
+      m_entries.erase (m_lru.back ());
+      m_lru.pop_back ();
+    }
+}
+
+}  // namespace aodvDbscan
+}  // namespace ns3
@@ -0,0 +1,216 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef aodvDbscan_LOCATION_CACHE_H
+#define aodvDbscan_LOCATION_CACHE_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include <list>
+#include <map>
+#include <utility>
+
+namespace ns3 {
+namespace aodvDbscan {
+/**
+ * \ingroup aodvDbscan
+ *
+ * \brief Last known positions of remote nodes, used to select the cluster a RREQ is sent to.
+ *
+ * Every position is stamped with the time it was sampled. Positions older than
+ * the maximum age are not returned any more, and the confidence in a position
+ * halves every half-life. The cache holds at most a fixed number of nodes, the
+ * least recently used one is evicted to make room for a new node.
+ */
+class LocationCache
+{
+public:
+  /// A position as (x, y)
+  typedef std::pair<uint32_t, uint32_t> Position;
+
+  /**
+   * constructor
+   * \param capacity the maximum number of nodes
+   * \param maxAge the age after which a position is no longer used
+   */
+  LocationCache (uint32_t capacity = 256, Time maxAge = Seconds (30));
+  /**
+   * Record the position of a node. The velocity known for the node, if any, is kept.
+   * \param addr the IP address of the node
+   * \param position the position
+   * \param sampled when the node was at that position
+   */
+  void SetPosition (Ipv4Address addr, Position position, Time sampled);
+  /**
+   * Record the velocity of a node whose position is known
+   * \param addr the IP address of the node
+   * \param vx the x velocity in m/s
+   * \param vy the y velocity in m/s
+   * \param sampled when the node was moving at that velocity, from its last recorded position
+   * \returns false if no position is known for the node
+   */
+  bool SetVelocity (Ipv4Address addr, double vx, double vy, Time sampled);
+  /**
+   * Record that a node is still at its last known position
+   * \param addr the IP address of the node
+   * \param sampled when the node was seen at that position
+   * \returns false if no position is known for the node
+   */
+  bool Refresh (Ipv4Address addr, Time sampled);
+  /**
+   * Forget the velocity of a node, its position can no longer be extrapolated
+   * \param addr the IP address of the node
+   */
+  void ClearVelocity (Ipv4Address addr);
+  /**
+   * Estimate the current position of a node, dead reckoning from its last known
+   * position along its velocity if known. Marks the node as recently used.
+   * \param addr the IP address of the node
+   * \param position the estimated position
+   * \returns false if no position younger than the maximum age is known
+   */
+  bool Lookup (Ipv4Address addr, Position & position);
+  /**
+   * \param addr the IP address of the node
+   * \param vx the x velocity in m/s
+   * \param vy the y velocity in m/s
+   * \returns false if no velocity is known for the node
+   */
+  bool GetVelocity (Ipv4Address addr, double & vx, double & vy) const;
+  /**
+   * \param addr the IP address of the node
+   * \returns how much the position of the node can be trusted, from 1 for a
+   * fresh position down to 0 for an unknown or too old one
+   */
+  double GetConfidence (Ipv4Address addr) const;
+  /**
+   * \param addr the IP address of the node
+   * \returns true if a position younger than the maximum age is known
+   */
+  bool IsKnown (Ipv4Address addr) const;
+  /**
+   * Predict how long two nodes stay within range of each other if both keep their velocity
+   * \param dx x of the other node relative to this one
+   * \param dy y of the other node relative to this one
+   * \param dvx x velocity of the other node relative to this one, in m/s
+   * \param dvy y velocity of the other node relative to this one, in m/s
+   * \param range the distance at which the link breaks
+   * \returns the time until the link breaks, 0 if the nodes are already out of range and
+   * Time::Max () if they do not move apart
+   */
+  static Time LinkLifetime (double dx, double dy, double dvx, double dvy, double range);
+  /// Remove positions older than the maximum age
+  void Purge ();
+  /// Remove all entries
+  void Clear ();
+  /**
+   * \returns the number of nodes in the cache
+   */
+  uint32_t GetSize () const
+  {
+    return m_entries.size ();
+  }
+
+  /**
+   * Set the maximum number of nodes, evicting the least recently used ones if needed
+   * \param capacity the maximum number of nodes, at least 1
+   */
+  void SetCapacity (uint32_t capacity);
+  /**
+   * \returns the maximum number of nodes
+   */
+  uint32_t GetCapacity () const
+  {
+    return m_capacity;
+  }
+  /**
+   * \param maxAge the age after which a position is no longer used
+   */
+  void SetMaxAge (Time maxAge)
+  {
+    m_maxAge = maxAge;
+  }
+  /**
+   * \returns the age after which a position is no longer used
+   */
+  Time GetMaxAge () const
+  {
+    return m_maxAge;
+  }
+  /**
+   * \param halfLife the age at which the confidence in a position has halved
+   */
+  void SetHalfLife (Time halfLife)
+  {
+    m_halfLife = halfLife;
+  }
+  /**
+   * \returns the age at which the confidence in a position has halved
+   */
+  Time GetHalfLife () const
+  {
+    return m_halfLife;
+  }
+  /**
+   * \param maxExtrapolation the longest time a position is dead reckoned forward
+   */
+  void SetMaxExtrapolation (Time maxExtrapolation)
+  {
+    m_maxExtrapolation = maxExtrapolation;
+  }
+
+private:
+  /// A cached position
+  struct Entry
+  {
+    Position m_position;   ///< last known position
+    Time m_sampled;        ///< when the node was at m_position
+    bool m_hasVelocity;    ///< whether m_velocityX and m_velocityY are known
+    double m_velocityX;    ///< x velocity in m/s
+    double m_velocityY;    ///< y velocity in m/s
+    std::list<Ipv4Address>::iterator m_lru; ///< place in the LRU list
+  };
+  /// Cached positions
+  std::map<Ipv4Address, Entry> m_entries;
+  /// Nodes ordered by last use, most recent first
+  std::list<Ipv4Address> m_lru;
+  /// Maximum number of nodes
+  uint32_t m_capacity;
+  /// Age after which a position is no longer used
+  Time m_maxAge;
+  /// Age at which the confidence in a position has halved
+  Time m_halfLife;
+  /// Longest time a position is dead reckoned forward
+  Time m_maxExtrapolation;
+
+  /**
+   * Mark a node as the most recently used
+   * \param entry the entry of the node
+   */
+  void Touch (Entry & entry);
+  /**
+   * \param entry a cached position
+   * \returns true if the position is older than the maximum age
+   */
+  bool IsExpired (Entry const & entry) const;
+  /// Remove the least recently used nodes until the capacity is respected
+  void Evict ();
+};
+
+}  // namespace aodvDbscan
+}  // namespace ns3
+
+#endif /* aodvDbscan_LOCATION_CACHE_H */
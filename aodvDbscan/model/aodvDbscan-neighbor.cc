@@ -36,8 +36,17 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("aodvDbscanNeighbors");
 
 namespace aodvDbscan {
+
+const double Neighbors::MaxEtx = 255.0;
+
 Neighbors::Neighbors (Time delay)
-  : m_ntimer (Timer::CANCEL_ON_DESTROY)
+  : m_ntimer (Timer::CANCEL_ON_DESTROY),
+    m_macCacheCapacity (64),
+    m_macCacheTimeout (Seconds (120)),
+    m_macCacheHits (0),
+    m_arpLookups (0),
+    m_lqWindow (10),
+    m_linkChanges (0)
 {
   m_ntimer.SetDelay (delay);
   m_ntimer.SetFunction (&Neighbors::Purge, this);
@@ -94,14 +103,151 @@ Neighbors::Update (Ipv4Address addr, Time expire)
   NS_LOG_LOGIC ("Open link to " << addr);
   Neighbor neighbor (addr, LookupMacAddress (addr), expire + Simulator::Now ());
   m_nb.push_back (neighbor);
+  ++m_linkChanges;
   Purge ();
 }
 
+uint32_t
+Neighbors::GetNeighborCount ()
+{
+  Purge ();
+  return m_nb.size ();
+}
 
 
 
+/**
+ * Hellos a neighbor should have sent since the last one received, allowing half an
+ * interval of jitter
+ *
+ * \param nb the neighbor
+ * \returns the number of hellos missed since the last one received
+ */
+static uint32_t
+MissedHellos (Neighbors::Neighbor const & nb)
+{
+  if (!nb.m_helloInterval.IsStrictlyPositive ())
+    {
+      return 0;
+    }
+  double missed = (Simulator::Now () - nb.m_lastHello).GetSeconds () / nb.m_helloInterval.GetSeconds () - 0.5;
+  return missed > 0 ? uint32_t (missed) : 0;
+}
 
+void
+Neighbors::RecordHello (Ipv4Address addr, uint16_t seqNo, Time interval)
+{
+  for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress != addr)
+        {
+          continue;
+        }
+      std::deque<uint16_t> & seqNos = i->m_helloSeqNos;
+      uint16_t gap = 1;
+      if (!seqNos.empty ())
+        {
+          gap = seqNo - seqNos.back ();
+          if (gap == 0)
+            {
+              return;
+            }
+          // A gap longer than the window, be it an outage or a restarted neighbor, lost every hello of it
+          if (gap >= m_lqWindow)
+            {
+              seqNos.clear ();
+            }
+        }
+      i->m_helloSlots = std::min<uint32_t> (m_lqWindow, uint32_t (i->m_helloSlots) + gap);
+      i->m_lastHello = Simulator::Now ();
+      i->m_helloInterval = interval;
+      seqNos.push_back (seqNo);
+      while (seqNos.size () > 1 && uint16_t (seqNo - seqNos.front ()) >= m_lqWindow)
+        {
+          seqNos.pop_front ();
+        }
+      return;
+    }
+}
 
+void
+Neighbors::SetForwardDeliveryRatio (Ipv4Address addr, double ratio)
+{
+  for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        {
+          i->m_forwardRatio = std::min (1.0, std::max (0.0, ratio));
+          i->m_forwardRatioKnown = true;
+          return;
+        }
+    }
+}
+
+double
+Neighbors::GetReverseDeliveryRatio (Ipv4Address addr) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        {
+          if (i->m_helloSeqNos.empty ())
+            {
+              return 0;
+            }
+          // Hellos missed since the last one received slide the oldest ones out of the window
+          uint32_t missed = MissedHellos (*i);
+          if (missed >= m_lqWindow)
+            {
+              return 0;
+            }
+          // Until the window is filled, measure over the hellos expected since the first one heard
+          uint32_t expected = std::min<uint32_t> (m_lqWindow, i->m_helloSlots + missed);
+          uint32_t received = 0;
+          for (std::deque<uint16_t>::const_iterator j = i->m_helloSeqNos.begin (); j != i->m_helloSeqNos.end (); ++j)
+            {
+              if (uint16_t (i->m_helloSeqNos.back () - *j) < m_lqWindow - missed)
+                {
+                  ++received;
+                }
+            }
+          return double (received) / expected;
+        }
+    }
+  return 0;
+}
+
+double
+Neighbors::GetEtx (Ipv4Address addr) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        {
+          double reverse = GetReverseDeliveryRatio (addr);
+          double forward = i->m_forwardRatioKnown ? i->m_forwardRatio : reverse;
+          if (forward * reverse * MaxEtx <= 1)
+            {
+              return MaxEtx;
+            }
+          return 1 / (forward * reverse);
+        }
+    }
+  return MaxEtx;
+}
+
+void
+Neighbors::GetReverseDeliveryRatios (std::vector<std::pair<Ipv4Address, double> > & ratios) const
+{
+  ratios.clear ();
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (!i->m_helloSeqNos.empty ())
+        {
+          ratios.push_back (std::make_pair (i->m_neighborAddress, GetReverseDeliveryRatio (i->m_neighborAddress)));
+        }
+    }
+}
 
 /**
  * \brief CloseNeighbor structure
@@ -140,7 +286,9 @@ Neighbors::Purge ()
             }
         }
     }
-  m_nb.erase (std::remove_if (m_nb.begin (), m_nb.end (), pred), m_nb.end ());
+  std::vector<Neighbor>::iterator end = std::remove_if (m_nb.begin (), m_nb.end (), pred);
+  m_linkChanges += m_nb.end () - end;
+  m_nb.erase (end, m_nb.end ());
   m_ntimer.Cancel ();
   m_ntimer.Schedule ();
 }
@@ -162,11 +310,110 @@ void
 Neighbors::DelArpCache (Ptr<ArpCache> a)
 {
   m_arp.erase (std::remove (m_arp.begin (), m_arp.end (), a), m_arp.end ());
+  for (std::map<Ipv4Address, MacCacheEntry>::iterator i = m_macCache.begin ();
+       i != m_macCache.end (); )
+    {
+      if (i->second.m_arp == a)
+        {
+          m_macCache.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+void
+Neighbors::SetMacCacheCapacity (uint32_t capacity)
+{
+  m_macCacheCapacity = std::max<uint32_t> (1, capacity);
+  while (m_macCache.size () > m_macCacheCapacity)
+    {
+      EvictMacCacheEntry ();
+    }
+}
+
+void
+Neighbors::EvictMacCacheEntry ()
+{
+  // Least recently used first, the cache is small
+  std::map<Ipv4Address, MacCacheEntry>::iterator oldest = m_macCache.begin ();
+  for (std::map<Ipv4Address, MacCacheEntry>::iterator i = m_macCache.begin (); i != m_macCache.end (); ++i)
+    {
+      if (i->second.m_lastUsed < oldest->second.m_lastUsed)
+        {
+          oldest = i;
+        }
+    }
+  NS_LOG_LOGIC ("Evict MAC mapping of " << oldest->first);
+  m_macCache.erase (oldest);
+}
+
+Neighbors::MacCacheEntry &
+Neighbors::InsertMacCacheEntry (Ipv4Address addr)
+{
+  std::map<Ipv4Address, MacCacheEntry>::iterator i = m_macCache.find (addr);
+  if (i == m_macCache.end () && m_macCache.size () >= m_macCacheCapacity)
+    {
+      EvictMacCacheEntry ();
+    }
+  MacCacheEntry & entry = m_macCache[addr];
+  entry.m_lastUsed = Simulator::Now ();
+  return entry;
+}
+
+void
+Neighbors::LearnMacAddress (Ipv4Address addr, Mac48Address mac, Ptr<ArpCache> arp)
+{
+  MacCacheEntry & cached = InsertMacCacheEntry (addr);
+  cached.m_hardwareAddress = mac;
+  cached.m_arp = arp;
+  cached.m_learned = true;
+  cached.m_expireTime = Simulator::Now () + (arp ? arp->GetAliveTimeout () : m_macCacheTimeout);
+
+  for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr && i->m_hardwareAddress == Mac48Address ())
+        {
+          i->m_hardwareAddress = mac;
+        }
+    }
 }
 
 Mac48Address
 Neighbors::LookupMacAddress (Ipv4Address addr)
 {
+  std::map<Ipv4Address, MacCacheEntry>::iterator cached = m_macCache.find (addr);
+  if (cached != m_macCache.end ())
+    {
+      bool valid;
+      if (cached->second.m_learned)
+        {
+          valid = cached->second.m_expireTime >= Simulator::Now ();
+          if (valid)
+            {
+              m_macCacheHits++;
+            }
+        }
+      else
+        {
+          // The mapping is as valid as the ARP entry it was taken from. ArpCache tells no one
+          // when its entries expire, so this costs an ARP lookup, only the other caches are spared.
+          m_arpLookups++;
+          ArpCache::Entry * entry = cached->second.m_arp->Lookup (addr);
+          valid = entry != 0 && (entry->IsAlive () || entry->IsPermanent ()) && !entry->IsExpired ()
+            && Mac48Address::ConvertFrom (entry->GetMacAddress ()) == cached->second.m_hardwareAddress;
+        }
+      if (valid)
+        {
+          cached->second.m_lastUsed = Simulator::Now ();
+          return cached->second.m_hardwareAddress;
+        }
+      m_macCache.erase (cached);
+    }
+
+  m_arpLookups++;
   Mac48Address hwaddr;
   for (std::vector<Ptr<ArpCache> >::const_iterator i = m_arp.begin ();
        i != m_arp.end (); ++i)
@@ -175,9 +422,15 @@ Neighbors::LookupMacAddress (Ipv4Address addr)
       if (entry != 0 && (entry->IsAlive () || entry->IsPermanent ()) && !entry->IsExpired ())
         {
           hwaddr = Mac48Address::ConvertFrom (entry->GetMacAddress ());
+          MacCacheEntry & newEntry = InsertMacCacheEntry (addr);
+          newEntry.m_hardwareAddress = hwaddr;
+          newEntry.m_arp = *i;
+          newEntry.m_learned = false;
           break;
         }
     }
+  NS_LOG_LOGIC ("MAC lookup for " << addr << ": " << m_macCacheHits << " cache hits, "
+                                  << m_arpLookups << " ARP lookups");
   return hwaddr;
 }
 
@@ -193,6 +446,7 @@ Neighbors::ProcessTxError (WifiMacHeader const & hdr)
       if (i->m_hardwareAddress == addr)
         {
           i->close = true;
+          m_macCache.erase (i->m_neighborAddress);
         }
     }
   Purge ();
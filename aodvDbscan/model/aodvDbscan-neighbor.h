@@ -30,6 +30,8 @@
 #define aodvDbscanNEIGHBOR_H
 
 #include <vector>
+#include <deque>
+#include <map>
 #include "ns3/simulator.h"
 #include "ns3/timer.h"
 #include "ns3/ipv4-address.h"
@@ -67,6 +69,18 @@ public:
     Time m_expireTime;
     /// Neighbor close indicator
     bool close;
+    /// Hello sequence numbers received from the neighbor within the link quality window
+    std::deque<uint16_t> m_helloSeqNos;
+    /// Hellos the neighbor sent up to the last one received, at most the link quality window
+    uint16_t m_helloSlots;
+    /// When the last hello was received
+    Time m_lastHello;
+    /// Interval the neighbor sends its hellos at
+    Time m_helloInterval;
+    /// Fraction of our hellos the neighbor reports having received
+    double m_forwardRatio;
+    /// Whether the neighbor has reported m_forwardRatio yet
+    bool m_forwardRatioKnown;
     /// cluster id of neighbour
     
     /**
@@ -80,7 +94,10 @@ public:
       : m_neighborAddress (ip),
         m_hardwareAddress (mac),
         m_expireTime (t),
-        close (false)
+        close (false),
+        m_helloSlots (0),
+        m_forwardRatio (0),
+        m_forwardRatioKnown (false)
         
     {
     }
@@ -104,6 +121,18 @@ public:
    * \param expire the expire time for the address
    */
   void Update (Ipv4Address addr, Time expire);
+  /**
+   * \returns the number of current neighbors
+   */
+  uint32_t GetNeighborCount ();
+  /**
+   * Links opened and closed so far, compare two readings to measure neighbor churn
+   * \returns the number of links opened or closed
+   */
+  uint32_t GetLinkChanges () const
+  {
+    return m_linkChanges;
+  }
   /// Remove all expired entries
   void Purge ();
   /// Schedule m_ntimer.
@@ -112,7 +141,60 @@ public:
   void Clear ()
   {
     m_nb.clear ();
+    m_macCache.clear ();
+  }
+
+  ///\name Link quality estimation (ETX)
+  //\{
+  /**
+   * Record reception of a hello from an existing neighbor
+   * \param addr the IP address of the neighbor
+   * \param seqNo the hello sequence number
+   * \param interval the interval the neighbor sends its hellos at
+   */
+  void RecordHello (Ipv4Address addr, uint16_t seqNo, Time interval);
+  /**
+   * Set the fraction of our hellos the neighbor reports having received
+   * \param addr the IP address of the neighbor
+   * \param ratio the delivery ratio in [0, 1]
+   */
+  void SetForwardDeliveryRatio (Ipv4Address addr, double ratio);
+  /**
+   * \param addr the IP address of the neighbor
+   * \returns fraction of the neighbor's hellos received within the window, 0 if unknown.
+   * The hellos the neighbor should have sent since the last one received count as lost.
+   */
+  double GetReverseDeliveryRatio (Ipv4Address addr) const;
+  /**
+   * Expected transmission count of the link, 1 / (forward ratio * reverse ratio).
+   * The reverse ratio is used for both directions until the neighbor reports the forward one.
+   * \param addr the IP address of the neighbor
+   * \returns the ETX of the link, MaxEtx if nothing is known
+   */
+  double GetEtx (Ipv4Address addr) const;
+  /**
+   * Get the reverse delivery ratio of every neighbor, to be advertised in hellos
+   * \param ratios vector of (neighbor address, ratio in [0, 1]) to fill
+   */
+  void GetReverseDeliveryRatios (std::vector<std::pair<Ipv4Address, double> > & ratios) const;
+  /**
+   * Set the number of hello intervals the delivery ratio is measured over
+   * \param window the window size in hellos
+   */
+  void SetLinkQualityWindow (uint16_t window)
+  {
+    m_lqWindow = window;
   }
+  /**
+   * \returns the link quality window size in hellos
+   */
+  uint16_t GetLinkQualityWindow () const
+  {
+    return m_lqWindow;
+  }
+  /// ETX reported for links with no measured delivery
+  static const double MaxEtx;
+  //\}
 
   // set cluster id
   void SetClusterId(Ipv4Address addr, uint32_t cid);
@@ -129,6 +211,55 @@ public:
    * \param a pointer to the ARP cache to delete
    */
   void DelArpCache (Ptr<ArpCache> a);
+  /**
+   * Remember the MAC address a neighbor was heard from, e.g. from a received control frame.
+   * Existing neighbors with unknown hardware address are updated as well.
+   * \param addr the IP address of the neighbor
+   * \param mac the MAC address the frame was sent from
+   * \param arp the ARP cache of the interface the frame was received on, if any. The
+   * mapping lives as long as an ARP entry of that cache and is dropped with it by DelArpCache.
+   */
+  void LearnMacAddress (Ipv4Address addr, Mac48Address mac, Ptr<ArpCache> arp = 0);
+  /// Forget all cached IP to MAC mappings
+  void FlushMacCache ()
+  {
+    m_macCache.clear ();
+  }
+  /**
+   * Set the maximum number of cached IP to MAC mappings, the least recently used are evicted
+   * \param capacity the maximum number of mappings, at least 1
+   */
+  void SetMacCacheCapacity (uint32_t capacity);
+  /**
+   * \returns the maximum number of cached IP to MAC mappings
+   */
+  uint32_t GetMacCacheCapacity () const
+  {
+    return m_macCacheCapacity;
+  }
+  /**
+   * \returns the number of cached IP to MAC mappings
+   */
+  uint32_t GetMacCacheSize () const
+  {
+    return m_macCache.size ();
+  }
+  /**
+   * \returns number of MAC resolutions answered by the local MAC cache without an ARP lookup,
+   * i.e. from mappings learned from received frames
+   */
+  uint32_t GetMacCacheHits () const
+  {
+    return m_macCacheHits;
+  }
+  /**
+   * \returns number of MAC resolutions that looked up an ARP cache, including those checking
+   * a cached mapping against the ARP entry it was taken from
+   */
+  uint32_t GetArpLookups () const
+  {
+    return m_arpLookups;
+  }
   /**
    * Get callback to ProcessTxError
    * \returns the callback function
@@ -171,14 +302,51 @@ private:
   /// list of ARP cached to be used for layer 2 notifications processing
   std::vector<Ptr<ArpCache> > m_arp;
 
+  /// Cached IP to MAC mapping
+  struct MacCacheEntry
+  {
+    /// Neighbor MAC address
+    Mac48Address m_hardwareAddress;
+    /// ARP cache the mapping was taken from, or of the interface it was learned on
+    Ptr<ArpCache> m_arp;
+    /// Whether the mapping was learned from a received frame rather than taken from m_arp
+    bool m_learned;
+    /// When a learned mapping expires, as an ARP entry of m_arp would
+    Time m_expireTime;
+    /// Last time the mapping was used, for LRU eviction
+    Time m_lastUsed;
+  };
+  /// IP to MAC mappings resolved so far
+  std::map<Ipv4Address, MacCacheEntry> m_macCache;
+  /// Maximum number of mappings in m_macCache
+  uint32_t m_macCacheCapacity;
+  /// Lifetime of learned mappings without an ARP cache
+  Time m_macCacheTimeout;
+  /// Number of lookups answered by m_macCache without an ARP lookup
+  uint32_t m_macCacheHits;
+  /// Number of lookups that went to an ARP cache
+  uint32_t m_arpLookups;
+  /// Number of hello intervals the delivery ratio is measured over
+  uint16_t m_lqWindow;
+  /// Number of links opened or closed so far
+  uint32_t m_linkChanges;
+
   
   /**
-   * Find MAC address by IP using list of ARP caches
+   * Find MAC address by IP using the local MAC cache first and the list of ARP caches otherwise
    * 
    * \param addr the IP address to lookup
    * \returns the MAC address for the IP address
    */
   Mac48Address LookupMacAddress (Ipv4Address addr);
+  /**
+   * Get the cache entry of an address, making room for it if it is new
+   * \param addr the IP address
+   * \returns the entry
+   */
+  MacCacheEntry & InsertMacCacheEntry (Ipv4Address addr);
+  /// Remove the least recently used IP to MAC mapping
+  void EvictMacCacheEntry ();
   /**
    * Process layer 2 TX error notification
    * \param hdr header of the packet
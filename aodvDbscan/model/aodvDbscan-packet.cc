@@ -28,6 +28,8 @@
 #include "aodvDbscan-packet.h"
 #include "ns3/address-utils.h"
 #include "ns3/packet.h"
+#include <algorithm>
+#include <cmath>
 
 namespace ns3 {
 namespace aodvDbscan {
@@ -36,7 +38,8 @@ NS_OBJECT_ENSURE_REGISTERED (TypeHeader);
 
 TypeHeader::TypeHeader (MessageType t)
   : m_type (t),
-    m_valid (true)
+    m_valid (true),
+    m_neighborState (false)
 {
 }
 
@@ -66,7 +69,7 @@ TypeHeader::GetSerializedSize () const
 void
 TypeHeader::Serialize (Buffer::Iterator i) const
 {
-  i.WriteU8 ((uint8_t) m_type);
+  i.WriteU8 ((uint8_t) m_type | (m_neighborState ? 0x80 : 0));
 }
 
 uint32_t
@@ -74,6 +77,8 @@ TypeHeader::Deserialize (Buffer::Iterator start)
 {
   Buffer::Iterator i = start;
   uint8_t type = i.ReadU8 ();
+  m_neighborState = (type & 0x80) != 0;
+  type &= 0x7f;
   m_valid = true;
   switch (type)
     {
@@ -126,7 +131,7 @@ TypeHeader::Print (std::ostream &os) const
 bool
 TypeHeader::operator== (TypeHeader const & o) const
 {
-  return (m_type == o.m_type && m_valid == o.m_valid);
+  return (m_type == o.m_type && m_valid == o.m_valid && m_neighborState == o.m_neighborState);
 }
 
 std::ostream &
@@ -174,6 +179,10 @@ RreqHeader::GetInstanceTypeId () const
 uint32_t
 RreqHeader::GetSerializedSize () const
 {
+  if (HasForwarders ())
+    {
+      return 23 + 1 + 4 * m_forwarders.size ();
+    }
   return 23;
 }
 
@@ -188,6 +197,14 @@ RreqHeader::Serialize (Buffer::Iterator i) const
   i.WriteHtonU32 (m_dstSeqNo);
   WriteTo (i, m_origin);
   i.WriteHtonU32 (m_originSeqNo);
+  if (HasForwarders ())
+    {
+      i.WriteU8 ((uint8_t) m_forwarders.size ());
+      for (std::vector<Ipv4Address>::const_iterator j = m_forwarders.begin (); j != m_forwarders.end (); ++j)
+        {
+          WriteTo (i, *j);
+        }
+    }
 }
 
 uint32_t
@@ -202,6 +219,17 @@ RreqHeader::Deserialize (Buffer::Iterator start)
   m_dstSeqNo = i.ReadNtohU32 ();
   ReadFrom (i, m_origin);
   m_originSeqNo = i.ReadNtohU32 ();
+  m_forwarders.clear ();
+  if (HasForwarders ())
+    {
+      uint8_t count = i.ReadU8 ();
+      Ipv4Address forwarder;
+      for (uint8_t k = 0; k < count; ++k)
+        {
+          ReadFrom (i, forwarder);
+          m_forwarders.push_back (forwarder);
+        }
+    }
 
   uint32_t dist = i.GetDistanceFrom (start);
   NS_ASSERT (dist == GetSerializedSize ());
@@ -285,13 +313,65 @@ RreqHeader::GetUnknownSeqno () const
   return (m_flags & (1 << 3));
 }
 
+bool
+RreqHeader::AddForwarder (Ipv4Address forwarder)
+{
+  if (m_forwarders.size () == 255)
+    {
+      return false;
+    }
+  m_flags |= (1 << 2);
+  m_forwarders.push_back (forwarder);
+  return true;
+}
+
+bool
+RreqHeader::HasForwarders () const
+{
+  return (m_flags & (1 << 2));
+}
+
+bool
+RreqHeader::IsForwarder (Ipv4Address forwarder) const
+{
+  if (!HasForwarders ())
+    {
+      return true;
+    }
+  return std::find (m_forwarders.begin (), m_forwarders.end (), forwarder) != m_forwarders.end ();
+}
+
+void
+RreqHeader::ClearForwarders ()
+{
+  m_flags &= ~(1 << 2);
+  m_forwarders.clear ();
+}
+
+Ptr<Packet>
+RreqHeader::CreateForwarded (Ptr<const Packet> p) const
+{
+  NS_ASSERT (!HasForwarders ());
+  uint8_t buffer[23];
+  p->CopyData (buffer, sizeof (buffer));
+  buffer[0] = m_flags;
+  buffer[2] = m_hopCount;
+  // Destination sequence number, after the flags, reserved, hop count, ID and destination
+  buffer[11] = (m_dstSeqNo >> 24) & 0xff;
+  buffer[12] = (m_dstSeqNo >> 16) & 0xff;
+  buffer[13] = (m_dstSeqNo >> 8) & 0xff;
+  buffer[14] = m_dstSeqNo & 0xff;
+  return Create<Packet> (buffer, sizeof (buffer));
+}
+
 bool
 RreqHeader::operator== (RreqHeader const & o) const
 {
   return (m_flags == o.m_flags && m_reserved == o.m_reserved
           && m_hopCount == o.m_hopCount && m_requestID == o.m_requestID
           && m_dst == o.m_dst && m_dstSeqNo == o.m_dstSeqNo
-          && m_origin == o.m_origin && m_originSeqNo == o.m_originSeqNo);
+          && m_origin == o.m_origin && m_originSeqNo == o.m_originSeqNo
+          && m_forwarders == o.m_forwarders);
 }
 
 //-----------------------------------------------------------------------------
@@ -311,7 +391,16 @@ RrepHeader::RrepHeader (uint8_t prefixSize, uint8_t hopCount, Ipv4Address dst,
     m_txErrorCount(errorCount),
     m_freeSpace(freeSpace),
     m_positionX(positionX),
-    m_positionY(positionY)
+    m_positionY(positionY),
+    m_velocityX (0),
+    m_velocityY (0),
+    m_timestamp (0),
+    m_residualEnergy (255),
+    m_helloSeqNo (0),
+    m_presentFields (ALL_FIELDS),
+    m_originX (0),
+    m_originY (0),
+    m_resolution (1)
 {
   m_lifeTime = uint32_t (lifeTime.GetMilliSeconds ());
 }
@@ -335,10 +424,87 @@ RrepHeader::GetInstanceTypeId () const
   return GetTypeId ();
 }
 
+namespace {
+/**
+ * \param value the value to encode
+ * \returns the number of bytes of the variable length encoding
+ */
+uint32_t
+VarIntSize (uint32_t value)
+{
+  uint32_t size = 1;
+  while (value >= 0x80)
+    {
+      value >>= 7;
+      ++size;
+    }
+  return size;
+}
+/**
+ * Write a variable length integer, 7 bits per byte, least significant first
+ * \param i the buffer iterator
+ * \param value the value
+ */
+void
+WriteVarInt (Buffer::Iterator & i, uint32_t value)
+{
+  while (value >= 0x80)
+    {
+      i.WriteU8 (uint8_t (value | 0x80));
+      value >>= 7;
+    }
+  i.WriteU8 (uint8_t (value));
+}
+/**
+ * Read a variable length integer
+ * \param i the buffer iterator
+ * \returns the value
+ */
+uint32_t
+ReadVarInt (Buffer::Iterator & i)
+{
+  uint32_t value = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7)
+    {
+      uint8_t byte = i.ReadU8 ();
+      value |= uint32_t (byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        {
+          break;
+        }
+    }
+  return value;
+}
+}
+
 uint32_t
 RrepHeader::GetSerializedSize () const
 {
-  return 19 + 4 * 4;
+  uint32_t size = 19;
+  if (IsCompact ())
+    {
+      size += 1;
+      size += HasField (TX_ERROR_COUNT) ? VarIntSize (m_txErrorCount) : 0;
+      size += HasField (FREE_SPACE) ? VarIntSize (m_freeSpace) : 0;
+      size += HasField (POSITION) ? 4 : 0;
+    }
+  else
+    {
+      size += 4 * 4;
+    }
+  if (HasMotion ())
+    {
+      size += 8;
+    }
+  if (HasResidualEnergy ())
+    {
+      size += 1;
+    }
+  if (HasLinkQuality ())
+    {
+      size += 3 + 5 * m_linkQuality.size ();
+    }
+  return size;
 }
 void
 RrepHeader::Serialize (Buffer::Iterator i) const
@@ -350,10 +516,51 @@ RrepHeader::Serialize (Buffer::Iterator i) const
   i.WriteHtonU32 (m_dstSeqNo);
   WriteTo (i, m_origin);
   i.WriteHtonU32 (m_lifeTime);
-  i.WriteU32 (m_txErrorCount);
-  i.WriteU32 (m_freeSpace);
-  i.WriteU32 (m_positionX);
-  i.WriteU32 (m_positionY);
+  if (IsCompact ())
+    {
+      i.WriteU8 (m_presentFields);
+      if (HasField (TX_ERROR_COUNT))
+        {
+          WriteVarInt (i, m_txErrorCount);
+        }
+      if (HasField (FREE_SPACE))
+        {
+          WriteVarInt (i, m_freeSpace);
+        }
+      if (HasField (POSITION))
+        {
+          i.WriteHtonU16 (QuantizeCoordinate (m_positionX, m_originX));
+          i.WriteHtonU16 (QuantizeCoordinate (m_positionY, m_originY));
+        }
+    }
+  else
+    {
+      i.WriteU32 (m_txErrorCount);
+      i.WriteU32 (m_freeSpace);
+      i.WriteU32 (m_positionX);
+      i.WriteU32 (m_positionY);
+    }
+  if (HasMotion ())
+    {
+      i.WriteHtonU16 (uint16_t (m_velocityX));
+      i.WriteHtonU16 (uint16_t (m_velocityY));
+      i.WriteHtonU32 (m_timestamp);
+    }
+  if (HasResidualEnergy ())
+    {
+      i.WriteU8 (m_residualEnergy);
+    }
+  if (HasLinkQuality ())
+    {
+      i.WriteHtonU16 (m_helloSeqNo);
+      i.WriteU8 ((uint8_t) m_linkQuality.size ());
+      for (std::vector<std::pair<Ipv4Address, uint8_t> >::const_iterator j = m_linkQuality.begin ();
+           j != m_linkQuality.end (); ++j)
+        {
+          WriteTo (i, j->first);
+          i.WriteU8 (j->second);
+        }
+    }
 }
 uint32_t
 RrepHeader::Deserialize (Buffer::Iterator start)
@@ -367,11 +574,49 @@ RrepHeader::Deserialize (Buffer::Iterator start)
   m_dstSeqNo = i.ReadNtohU32 ();
   ReadFrom (i, m_origin);
   m_lifeTime = i.ReadNtohU32 ();
-  m_txErrorCount = i.ReadU32();
-  m_freeSpace = i.ReadU32();
-  m_positionX = i.ReadU32();
-  m_positionY = i.ReadU32();
-
+  if (IsCompact ())
+    {
+      m_presentFields = i.ReadU8 () & ALL_FIELDS;
+      m_txErrorCount = HasField (TX_ERROR_COUNT) ? ReadVarInt (i) : 0;
+      m_freeSpace = HasField (FREE_SPACE) ? ReadVarInt (i) : 0;
+      m_positionX = 0;
+      m_positionY = 0;
+      if (HasField (POSITION))
+        {
+          m_positionX = m_originX + uint32_t (i.ReadNtohU16 () * m_resolution + 0.5);
+          m_positionY = m_originY + uint32_t (i.ReadNtohU16 () * m_resolution + 0.5);
+        }
+    }
+  else
+    {
+      m_presentFields = ALL_FIELDS;
+      m_txErrorCount = i.ReadU32();
+      m_freeSpace = i.ReadU32();
+      m_positionX = i.ReadU32();
+      m_positionY = i.ReadU32();
+    }
+  m_velocityX = 0;
+  m_velocityY = 0;
+  m_timestamp = 0;
+  if (HasMotion ())
+    {
+      m_velocityX = int16_t (i.ReadNtohU16 ());
+      m_velocityY = int16_t (i.ReadNtohU16 ());
+      m_timestamp = i.ReadNtohU32 ();
+    }
+  m_residualEnergy = HasResidualEnergy () ? i.ReadU8 () : 255;
+  m_linkQuality.clear ();
+  if (HasLinkQuality ())
+    {
+      m_helloSeqNo = i.ReadNtohU16 ();
+      uint8_t count = i.ReadU8 ();
+      Ipv4Address neighbor;
+      for (uint8_t k = 0; k < count; ++k)
+        {
+          ReadFrom (i, neighbor);
+          m_linkQuality.push_back (std::make_pair (neighbor, i.ReadU8 ()));
+        }
+    }
 
   uint32_t dist = i.GetDistanceFrom (start);
   NS_ASSERT (dist == GetSerializedSize ());
@@ -434,14 +679,145 @@ RrepHeader::GetPrefixSize () const
   return m_prefixSize;
 }
 
+void
+RrepHeader::SetHelloSeqNo (uint16_t seqNo)
+{
+  m_flags |= (1 << 5);
+  m_helloSeqNo = seqNo;
+}
+
+bool
+RrepHeader::HasLinkQuality () const
+{
+  return (m_flags & (1 << 5));
+}
+
+bool
+RrepHeader::AddLinkQuality (Ipv4Address neighbor, uint8_t ratio)
+{
+  if (m_linkQuality.size () == 255)
+    {
+      return false;
+    }
+  m_flags |= (1 << 5);
+  m_linkQuality.push_back (std::make_pair (neighbor, ratio));
+  return true;
+}
+
+bool
+RrepHeader::LookupLinkQuality (Ipv4Address neighbor, uint8_t & ratio) const
+{
+  for (std::vector<std::pair<Ipv4Address, uint8_t> >::const_iterator i = m_linkQuality.begin ();
+       i != m_linkQuality.end (); ++i)
+    {
+      if (i->first == neighbor)
+        {
+          ratio = i->second;
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+RrepHeader::SetMotion (double velocityX, double velocityY, Time timestamp)
+{
+  m_flags |= (1 << 3);
+  // Saturate to the +-327 m/s the 16 bit fields can carry
+  m_velocityX = int16_t (std::max (-32767.0, std::min (32767.0, std::floor (velocityX * 100 + 0.5))));
+  m_velocityY = int16_t (std::max (-32767.0, std::min (32767.0, std::floor (velocityY * 100 + 0.5))));
+  m_timestamp = uint32_t (timestamp.GetMilliSeconds ());
+}
+
+bool
+RrepHeader::HasMotion () const
+{
+  return (m_flags & (1 << 3));
+}
+
+void
+RrepHeader::SetResidualEnergy (double fraction)
+{
+  m_flags |= (1 << 2);
+  m_residualEnergy = uint8_t (std::max (0.0, std::min (1.0, fraction)) * 255 + 0.5);
+}
+
+bool
+RrepHeader::HasResidualEnergy () const
+{
+  return (m_flags & (1 << 2));
+}
+
+void
+RrepHeader::SetCompact (bool compact)
+{
+  if (compact)
+    {
+      m_flags |= (1 << 4);
+    }
+  else
+    {
+      m_flags &= ~(1 << 4);
+      m_presentFields = ALL_FIELDS;
+    }
+}
+
+bool
+RrepHeader::IsCompact () const
+{
+  return (m_flags & (1 << 4));
+}
+
+void
+RrepHeader::SetCompactOrigin (uint32_t originX, uint32_t originY, double resolution)
+{
+  NS_ASSERT (resolution > 0);
+  m_originX = originX;
+  m_originY = originY;
+  m_resolution = resolution;
+}
+
+void
+RrepHeader::OmitFields (uint8_t fields)
+{
+  NS_ASSERT_MSG (IsCompact (), "Only the compact encoding can leave fields out");
+  m_presentFields &= ~fields;
+}
+
+uint16_t
+RrepHeader::QuantizeCoordinate (uint32_t value, uint32_t origin) const
+{
+  if (value <= origin)
+    {
+      return 0;
+    }
+  double steps = (value - origin) / m_resolution + 0.5;
+  return steps >= 65535 ? 65535 : uint16_t (steps);
+}
+
+Ptr<Packet>
+RrepHeader::CreateForwarded (Ptr<const Packet> p) const
+{
+  std::vector<uint8_t> buffer (GetSerializedSize ());
+  p->CopyData (&buffer[0], buffer.size ());
+  buffer[0] = m_flags;
+  buffer[2] = m_hopCount;
+  return Create<Packet> (&buffer[0], buffer.size ());
+}
+
 bool
 RrepHeader::operator== (RrepHeader const & o) const
 {
   return (m_flags == o.m_flags && m_prefixSize == o.m_prefixSize
           && m_hopCount == o.m_hopCount && m_dst == o.m_dst && m_dstSeqNo == o.m_dstSeqNo
           && m_origin == o.m_origin && m_lifeTime == o.m_lifeTime 
-          && m_txErrorCount == o.m_txErrorCount && m_freeSpace == o.m_freeSpace
-          && m_positionX == o.m_positionX && m_positionY == o.m_positionY);
+          && m_presentFields == o.m_presentFields
+          && (!HasField (TX_ERROR_COUNT) || m_txErrorCount == o.m_txErrorCount)
+          && (!HasField (FREE_SPACE) || m_freeSpace == o.m_freeSpace)
+          && (!HasField (POSITION) || (m_positionX == o.m_positionX && m_positionY == o.m_positionY))
+          && m_velocityX == o.m_velocityX && m_velocityY == o.m_velocityY && m_timestamp == o.m_timestamp
+          && m_residualEnergy == o.m_residualEnergy
+          && m_helloSeqNo == o.m_helloSeqNo && m_linkQuality == o.m_linkQuality);
 }
 
 void
@@ -455,6 +831,13 @@ RrepHeader::SetHello (Ipv4Address origin, uint32_t srcSeqNo, Time lifetime)
   m_origin = origin;
   m_lifeTime = lifetime.GetMilliSeconds ();
   m_txErrorCount = 0;
+  m_velocityX = 0;
+  m_velocityY = 0;
+  m_timestamp = 0;
+  m_residualEnergy = 255;
+  m_helloSeqNo = 0;
+  m_linkQuality.clear ();
+  m_presentFields = ALL_FIELDS;
 }
 
 std::ostream &
@@ -537,7 +920,8 @@ operator<< (std::ostream & os, RrepAckHeader const & h )
 //-----------------------------------------------------------------------------
 RerrHeader::RerrHeader ()
   : m_flag (0),
-    m_reserved (0)
+    m_reserved (0),
+    m_destCount (0)
 {
 }
 
@@ -571,12 +955,11 @@ RerrHeader::Serialize (Buffer::Iterator i ) const
 {
   i.WriteU8 (m_flag);
   i.WriteU8 (m_reserved);
-  i.WriteU8 (GetDestCount ());
-  std::map<Ipv4Address, uint32_t>::const_iterator j;
-  for (j = m_unreachableDstSeqNo.begin (); j != m_unreachableDstSeqNo.end (); ++j)
+  i.WriteU8 (m_destCount);
+  for (uint8_t j = 0; j < m_destCount; ++j)
     {
-      WriteTo (i, (*j).first);
-      i.WriteHtonU32 ((*j).second);
+      i.WriteHtonU32 (m_unreachableDst[j].Get ());
+      i.WriteHtonU32 (m_unreachableSeqNo[j]);
     }
 }
 
@@ -586,15 +969,11 @@ RerrHeader::Deserialize (Buffer::Iterator start )
   Buffer::Iterator i = start;
   m_flag = i.ReadU8 ();
   m_reserved = i.ReadU8 ();
-  uint8_t dest = i.ReadU8 ();
-  m_unreachableDstSeqNo.clear ();
-  Ipv4Address address;
-  uint32_t seqNo;
-  for (uint8_t k = 0; k < dest; ++k)
+  m_destCount = i.ReadU8 ();
+  for (uint8_t k = 0; k < m_destCount; ++k)
     {
-      ReadFrom (i, address);
-      seqNo = i.ReadNtohU32 ();
-      m_unreachableDstSeqNo.insert (std::make_pair (address, seqNo));
+      m_unreachableDst[k].Set (i.ReadNtohU32 ());
+      m_unreachableSeqNo[k] = i.ReadNtohU32 ();
     }
 
   uint32_t dist = i.GetDistanceFrom (start);
@@ -606,10 +985,9 @@ void
 RerrHeader::Print (std::ostream &os ) const
 {
   os << "Unreachable destination (ipv4 address, seq. number):";
-  std::map<Ipv4Address, uint32_t>::const_iterator j;
-  for (j = m_unreachableDstSeqNo.begin (); j != m_unreachableDstSeqNo.end (); ++j)
+  for (uint8_t j = 0; j < m_destCount; ++j)
     {
-      os << (*j).first << ", " << (*j).second;
+      os << m_unreachableDst[j] << ", " << m_unreachableSeqNo[j];
     }
   os << "No delete flag " << (*this).GetNoDelete ();
 }
@@ -636,33 +1014,40 @@ RerrHeader::GetNoDelete () const
 bool
 RerrHeader::AddUnDestination (Ipv4Address dst, uint32_t seqNo )
 {
-  if (m_unreachableDstSeqNo.find (dst) != m_unreachableDstSeqNo.end ())
+  for (uint8_t k = 0; k < m_destCount; ++k)
     {
-      return true;
+      if (m_unreachableDst[k] == dst)
+        {
+          return true;
+        }
     }
-
-  NS_ASSERT (GetDestCount () < 255); // can't support more than 255 destinations in single RERR
-  m_unreachableDstSeqNo.insert (std::make_pair (dst, seqNo));
+  if (m_destCount == MaxUnDestinations)
+    {
+      // can't support more than 255 destinations in single RERR
+      return false;
+    }
+  m_unreachableDst[m_destCount] = dst;
+  m_unreachableSeqNo[m_destCount] = seqNo;
+  ++m_destCount;
   return true;
 }
 
 bool
 RerrHeader::RemoveUnDestination (std::pair<Ipv4Address, uint32_t> & un )
 {
-  if (m_unreachableDstSeqNo.empty ())
+  if (m_destCount == 0)
     {
       return false;
     }
-  std::map<Ipv4Address, uint32_t>::iterator i = m_unreachableDstSeqNo.begin ();
-  un = *i;
-  m_unreachableDstSeqNo.erase (i);
+  --m_destCount;
+  un = std::make_pair (m_unreachableDst[m_destCount], m_unreachableSeqNo[m_destCount]);
   return true;
 }
 
 void
 RerrHeader::Clear ()
 {
-  m_unreachableDstSeqNo.clear ();
+  m_destCount = 0;
   m_flag = 0;
   m_reserved = 0;
 }
@@ -675,17 +1060,12 @@ RerrHeader::operator== (RerrHeader const & o ) const
       return false;
     }
 
-  std::map<Ipv4Address, uint32_t>::const_iterator j = m_unreachableDstSeqNo.begin ();
-  std::map<Ipv4Address, uint32_t>::const_iterator k = o.m_unreachableDstSeqNo.begin ();
   for (uint8_t i = 0; i < GetDestCount (); ++i)
     {
-      if ((j->first != k->first) || (j->second != k->second))
+      if ((m_unreachableDst[i] != o.m_unreachableDst[i]) || (m_unreachableSeqNo[i] != o.m_unreachableSeqNo[i]))
         {
           return false;
         }
-
-      j++;
-      k++;
     }
   return true;
 }
@@ -696,5 +1076,84 @@ operator<< (std::ostream & os, RerrHeader const & h )
   h.Print (os);
   return os;
 }
+//-----------------------------------------------------------------------------
+// Neighbor state
+//-----------------------------------------------------------------------------
+NeighborStateHeader::NeighborStateHeader (uint32_t txErrorCount, uint32_t freeSpace,
+                                          uint32_t positionX, uint32_t positionY)
+  : m_txErrorCount (txErrorCount),
+    m_freeSpace (freeSpace),
+    m_positionX (positionX),
+    m_positionY (positionY)
+{
+}
+
+NS_OBJECT_ENSURE_REGISTERED (NeighborStateHeader);
+
+TypeId
+NeighborStateHeader::GetTypeId ()
+{
+  static TypeId tid = TypeId ("ns3::aodvDbscan::NeighborStateHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("aodvDbscan")
+    .AddConstructor<NeighborStateHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+NeighborStateHeader::GetInstanceTypeId () const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+NeighborStateHeader::GetSerializedSize () const
+{
+  return VarIntSize (m_txErrorCount) + VarIntSize (m_freeSpace) + 8;
+}
+
+void
+NeighborStateHeader::Serialize (Buffer::Iterator i) const
+{
+  WriteVarInt (i, m_txErrorCount);
+  WriteVarInt (i, m_freeSpace);
+  i.WriteHtonU32 (m_positionX);
+  i.WriteHtonU32 (m_positionY);
+}
+
+uint32_t
+NeighborStateHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  m_txErrorCount = ReadVarInt (i);
+  m_freeSpace = ReadVarInt (i);
+  m_positionX = i.ReadNtohU32 ();
+  m_positionY = i.ReadNtohU32 ();
+  uint32_t dist = i.GetDistanceFrom (start);
+  NS_ASSERT (dist == GetSerializedSize ());
+  return dist;
+}
+
+void
+NeighborStateHeader::Print (std::ostream &os) const
+{
+  os << "txErrors " << m_txErrorCount << " freeSpace " << m_freeSpace
+     << " position (" << m_positionX << ", " << m_positionY << ")";
+}
+
+bool
+NeighborStateHeader::operator== (NeighborStateHeader const & o) const
+{
+  return (m_txErrorCount == o.m_txErrorCount && m_freeSpace == o.m_freeSpace
+          && m_positionX == o.m_positionX && m_positionY == o.m_positionY);
+}
+
+std::ostream &
+operator<< (std::ostream & os, NeighborStateHeader const & h)
+{
+  h.Print (os);
+  return os;
+}
 }
 }
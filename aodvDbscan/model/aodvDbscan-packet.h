@@ -33,9 +33,14 @@
 #include "ns3/enum.h"
 #include "ns3/ipv4-address.h"
 #include <map>
+#include <vector>
 #include "ns3/nstime.h"
+#include "ns3/ptr.h"
 
 namespace ns3 {
+
+class Packet;
+
 namespace aodvDbscan {
 
 /**
@@ -89,6 +94,22 @@ public:
   {
     return m_valid;
   }
+  /**
+   * Mark that a NeighborStateHeader follows this header. The flag travels
+   * in the most significant bit of the type byte.
+   * \param f true if the sender's state is piggybacked
+   */
+  void SetNeighborState (bool f)
+  {
+    m_neighborState = f;
+  }
+  /**
+   * \returns true if a NeighborStateHeader follows this header
+   */
+  bool HasNeighborState () const
+  {
+    return m_neighborState;
+  }
   /**
    * \brief Comparison operator
    * \param o header to compare
@@ -98,6 +119,7 @@ public:
 private:
   MessageType m_type; ///< type of the message
   bool m_valid; ///< Indicates if the message is valid
+  bool m_neighborState; ///< Indicates if a NeighborStateHeader follows
 };
 
 /**
@@ -127,6 +149,17 @@ std::ostream & operator<< (std::ostream & os, TypeHeader const & h);
   |                  Originator Sequence Number                   |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   \endverbatim
+
+  A RREQ broadcast to a selected cluster lists the intended forwarders, signalled
+  by the F flag (bit 2 of the flags). Only listed neighbors and the destination
+  process such a RREQ.
+  \verbatim
+  0                   1                   2                   3
+  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  | Forwarder Cnt |  Forwarder IP Addresses ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
 */
 class RreqHeader : public Header
 {
@@ -289,6 +322,44 @@ public:
    */
   bool GetUnknownSeqno () const;
 
+  /**
+   * \brief Add a neighbor to the list of intended forwarders
+   * \param forwarder the neighbor IP address
+   * \return false if the list is full
+   */
+  bool AddForwarder (Ipv4Address forwarder);
+  /**
+   * \brief Check whether the RREQ is addressed to a list of forwarders
+   * \return true if the F flag is set
+   */
+  bool HasForwarders () const;
+  /**
+   * \brief Check whether a neighbor is an intended forwarder
+   * \param forwarder the neighbor IP address
+   * \return true if the RREQ lists no forwarders or lists the neighbor
+   */
+  bool IsForwarder (Ipv4Address forwarder) const;
+  /**
+   * \brief Get the number of intended forwarders
+   * \return the number of forwarders listed
+   */
+  uint8_t GetForwarderCount () const
+  {
+    return (uint8_t) m_forwarders.size ();
+  }
+  /// Remove the list of intended forwarders
+  void ClearForwarders ();
+  /**
+   * \brief Build the RREQ a node forwards from the one it received
+   *
+   * The fixed fields are copied out of the received bytes and the flags, the hop count
+   * and the destination sequence number of this header written over them, so the
+   * message is not serialized again. The list of forwarders must have been cleared.
+   * \param p the received packet, starting with the RREQ this header was read from
+   * \return a packet holding the forwarded RREQ only
+   */
+  Ptr<Packet> CreateForwarded (Ptr<const Packet> p) const;
+
   /**
    * \brief Comparison operator
    * \param o RREQ header to compare
@@ -296,7 +367,7 @@ public:
    */
   bool operator== (RreqHeader const & o) const;
 private:
-  uint8_t        m_flags;          ///< |J|R|G|D|U| bit flags, see RFC
+  uint8_t        m_flags;          ///< |J|R|G|D|U|F| bit flags, see RFC
   uint8_t        m_reserved;       ///< Not used (must be 0)
   uint8_t        m_hopCount;       ///< Hop Count
   uint32_t       m_requestID;      ///< RREQ ID
@@ -304,6 +375,7 @@ private:
   uint32_t       m_dstSeqNo;       ///< Destination Sequence Number
   Ipv4Address    m_origin;         ///< Originator IP Address
   uint32_t       m_originSeqNo;    ///< Source Sequence Number
+  std::vector<Ipv4Address> m_forwarders; ///< Intended forwarders, if F flag is set
 };
 
 /**
@@ -331,10 +403,63 @@ std::ostream & operator<< (std::ostream & os, RreqHeader const &);
   |                           Lifetime                            |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   \endverbatim
+
+  Hello messages may carry a link quality extension, signalled by the L flag (bit 5 of the flags):
+  \verbatim
+  0                   1                   2                   3
+  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |       Hello Sequence Number   |  Neighbor Cnt |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |                     Neighbor IP Address (1)                   |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  | Delivery Ratio|  Additional (address, ratio) pairs ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
+
+  The TX error count, free space and position follow the lifetime as four 32 bit
+  fields. With the C flag (bit 4 of the flags) set they are encoded compactly
+  instead: a bitmap of the fields present, the counters as variable length
+  integers (7 bits per byte, high bit set on all but the last byte) and the
+  position as two 16 bit coordinates quantized relative to an origin and
+  resolution configured alike on all nodes. Fields left out of a hello are
+  unchanged since the previous hello of the sender, whether that one was full
+  or compact; every CompactRefreshInterval-th hello carries all fields.
+
+  With the V flag (bit 3 of the flags) set, a motion extension follows these
+  fields, ahead of the link quality extension: the velocity of the node as two
+  signed 16 bit values in cm/s and the time in milliseconds the position and
+  velocity were sampled at.
+  \verbatim
+  0                   1                   2                   3
+  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |          Velocity X           |          Velocity Y           |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |                           Timestamp                           |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
+  \verbatim
+  0                   1                   2                   3
+  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |    Present    |  TX error count (1-5 bytes), free space (1-5 bytes)
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |          Quantized X          |          Quantized Y          |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
 */
 class RrepHeader : public Header
 {
 public:
+  /// Fields that may be left out of the compact encoding
+  enum CompactField
+  {
+    TX_ERROR_COUNT = 1,  //!< TX error count
+    FREE_SPACE = 2,      //!< free queue space
+    POSITION = 4,        //!< X and Y position
+    ALL_FIELDS = 7       //!< all of the above
+  };
   /**
    * constructor
    *
@@ -512,6 +637,117 @@ public:
     m_positionY = positionY;
   }
 
+  /**
+   * \brief Set the hello sequence number and enable the link quality extension
+   * \param seqNo the hello sequence number
+   */
+  void SetHelloSeqNo (uint16_t seqNo);
+  /**
+   * \brief Get the hello sequence number
+   * \return the hello sequence number
+   */
+  uint16_t GetHelloSeqNo () const
+  {
+    return m_helloSeqNo;
+  }
+  /**
+   * \brief Check whether the link quality extension is present
+   * \return true if the extension is present
+   */
+  bool HasLinkQuality () const;
+  /**
+   * \brief Add the delivery ratio at which hellos of a neighbor are received
+   * \param neighbor the neighbor IP address
+   * \param ratio the delivery ratio scaled to [0, 255]
+   * \return false if the extension is full
+   */
+  bool AddLinkQuality (Ipv4Address neighbor, uint8_t ratio);
+  /**
+   * \brief Lookup the delivery ratio reported for a neighbor
+   * \param neighbor the neighbor IP address
+   * \param ratio the delivery ratio scaled to [0, 255], if found
+   * \return true if the neighbor is listed
+   */
+  bool LookupLinkQuality (Ipv4Address neighbor, uint8_t & ratio) const;
+  /**
+   * \brief Set the velocity of the node and the time its position was sampled at
+   * \param velocityX the x velocity in m/s
+   * \param velocityY the y velocity in m/s
+   * \param timestamp the time the position and velocity were sampled at
+   */
+  void SetMotion (double velocityX, double velocityY, Time timestamp);
+  /**
+   * \brief Check whether the motion extension is present
+   * \return true if the V flag is set
+   */
+  bool HasMotion () const;
+  /**
+   * \brief Get the velocity, quantized to cm/s
+   * \return the x and y velocity in m/s
+   */
+  std::pair<double, double> GetVelocity () const
+  {
+    return std::make_pair (m_velocityX / 100.0, m_velocityY / 100.0);
+  }
+  /**
+   * \brief Get the time the position and velocity were sampled at
+   * \return the timestamp
+   */
+  Time GetTimestamp () const
+  {
+    return MilliSeconds (m_timestamp);
+  }
+  /**
+   * \brief Set the residual energy of the node
+   * \param fraction the remaining fraction of the initial energy, in [0, 1]
+   */
+  void SetResidualEnergy (double fraction);
+  /**
+   * \brief Check whether the residual energy is present
+   * \return true if the E flag is set
+   */
+  bool HasResidualEnergy () const;
+  /**
+   * \brief Get the residual energy, quantized to 1/255
+   * \return the remaining fraction of the initial energy, 1 if not present
+   */
+  double GetResidualEnergy () const
+  {
+    return m_residualEnergy / 255.0;
+  }
+  /**
+   * \brief Set the compact encoding of the TX error count, free space and position
+   * \param compact true to use the compact encoding
+   */
+  void SetCompact (bool compact);
+  /**
+   * \brief Check whether the compact encoding is used
+   * \return true if the C flag is set
+   */
+  bool IsCompact () const;
+  /**
+   * \brief Set the reference the compact encoding quantizes positions against.
+   * Must be set alike on sender and receiver, before serializing or deserializing.
+   * \param originX the x coordinate of the origin
+   * \param originY the y coordinate of the origin
+   * \param resolution the distance one quantization step stands for
+   */
+  void SetCompactOrigin (uint32_t originX, uint32_t originY, double resolution);
+  /**
+   * \brief Leave fields out of the compact encoding
+   * \param fields the bitwise or of the CompactField values to leave out
+   */
+  void OmitFields (uint8_t fields);
+  /**
+   * \brief Check whether a field is carried by the header
+   * \param field the CompactField to check
+   * \return false if the field was left out of the compact encoding
+   */
+  bool HasField (CompactField field) const
+  {
+    return (m_presentFields & field);
+  }
+
   /**
    * Configure RREP to be a Hello message
    *
@@ -520,6 +756,15 @@ public:
    * \param lifetime the lifetime of the message
    */
   void SetHello (Ipv4Address src, uint32_t srcSeqNo, Time lifetime);
+  /**
+   * \brief Build the RREP a node forwards from the one it received
+   *
+   * The received bytes are copied with the flags and the hop count of this header
+   * written over them, so the message is not serialized again.
+   * \param p the received packet, starting with the RREP this header was read from
+   * \return a packet holding the forwarded RREP only
+   */
+  Ptr<Packet> CreateForwarded (Ptr<const Packet> p) const;
 
   /**
    * \brief Comparison operator
@@ -528,6 +773,14 @@ public:
    */
   bool operator== (RrepHeader const & o) const;
 private:
+  /**
+   * \brief Quantize a coordinate for the compact encoding
+   * \param value the coordinate
+   * \param origin the origin coordinate
+   * \return the number of resolution steps from the origin, saturated to 16 bits
+   */
+  uint16_t QuantizeCoordinate (uint32_t value, uint32_t origin) const;
+
   uint8_t       m_flags;            ///< A - acknowledgment required flag
   uint8_t       m_prefixSize;       ///< Prefix Size
   uint8_t       m_hopCount;         ///< Hop Count
@@ -539,8 +792,17 @@ private:
   uint32_t      m_freeSpace;        ///< free space left in this node
   uint32_t      m_positionX;        ///< x position of node
   uint32_t      m_positionY;        ///< y position of node
-  
-  
+  int16_t       m_velocityX;        ///< x velocity in cm/s, if V flag is set
+  int16_t       m_velocityY;        ///< y velocity in cm/s, if V flag is set
+  uint32_t      m_timestamp;        ///< Position sampling time in milliseconds, if V flag is set
+  uint8_t       m_residualEnergy;   ///< Residual energy scaled to [0, 255], if E flag is set
+  uint16_t      m_helloSeqNo;       ///< Hello sequence number, if L flag is set
+  /// Delivery ratio of hellos received from each neighbor, if L flag is set
+  std::vector<std::pair<Ipv4Address, uint8_t> > m_linkQuality;
+  uint8_t       m_presentFields;    ///< CompactField values carried, if C flag is set
+  uint32_t      m_originX;          ///< x of the compact position origin (not serialized)
+  uint32_t      m_originY;          ///< y of the compact position origin (not serialized)
+  double        m_resolution;       ///< Compact position resolution (not serialized)
 };
 
 /**
@@ -614,6 +876,10 @@ std::ostream & operator<< (std::ostream & os, RrepAckHeader const &);
   |Additional Unreachable Destination Sequence Numbers (if needed)|
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   \endverbatim
+
+  Unreachable destinations are kept in insertion order in an array sized to the
+  255 destinations DestCount can express, so building, clearing and parsing a
+  RERR never allocates.
 */
 class RerrHeader : public Header
 {
@@ -664,9 +930,21 @@ public:
    */
   uint8_t GetDestCount () const
   {
-    return (uint8_t)m_unreachableDstSeqNo.size ();
+    return m_destCount;
+  }
+  /**
+   * \brief Get an unreachable destination without removing it
+   * \param index the index of the destination, less than GetDestCount ()
+   * \return unreachable pair (address + sequence number)
+   */
+  std::pair<Ipv4Address, uint32_t> GetUnDestination (uint8_t index) const
+  {
+    return std::make_pair (m_unreachableDst[index], m_unreachableSeqNo[index]);
   }
 
+  /// Maximum number of unreachable destinations in a single RERR
+  static const uint8_t MaxUnDestinations = 255;
+
   /**
    * \brief Comparison operator
    * \param o RERR header to compare
@@ -677,8 +955,11 @@ private:
   uint8_t m_flag;            ///< No delete flag
   uint8_t m_reserved;        ///< Not used (must be 0)
 
-  /// List of Unreachable destination: IP addresses and sequence numbers
-  std::map<Ipv4Address, uint32_t> m_unreachableDstSeqNo;
+  uint8_t m_destCount;       ///< Number of unreachable destinations
+  /// Unreachable destination IP addresses
+  Ipv4Address m_unreachableDst[MaxUnDestinations];
+  /// Unreachable destination sequence numbers
+  uint32_t m_unreachableSeqNo[MaxUnDestinations];
 };
 
 /**
@@ -688,6 +969,91 @@ private:
   */
 std::ostream & operator<< (std::ostream & os, RerrHeader const &);
 
+/**
+* \ingroup aodvDbscan
+* \brief Neighbor state piggybacked on control messages
+  \verbatim
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |  TX Error Count (varint)  ... |   Free Space (varint)   ...   |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |                          Position X                           |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |                          Position Y                           |
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
+
+  Carries the same per-neighbor state as a hello, describing the node that
+  transmitted the message (the IP source), so that neighbors overhearing
+  control traffic do not need a separate hello to learn it. Present when
+  the preceding TypeHeader has its neighbor state flag set.
+*/
+class NeighborStateHeader : public Header
+{
+public:
+  /**
+   * constructor
+   *
+   * \param txErrorCount the sender's TX error count
+   * \param freeSpace the sender's free queue space
+   * \param positionX the sender's X position
+   * \param positionY the sender's Y position
+   */
+  NeighborStateHeader (uint32_t txErrorCount = 0, uint32_t freeSpace = 0,
+                       uint32_t positionX = 0, uint32_t positionY = 0);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId ();
+  TypeId GetInstanceTypeId () const;
+  uint32_t GetSerializedSize () const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+  void Print (std::ostream &os) const;
+
+  /**
+   * \returns the TX error count
+   */
+  uint32_t GetTxErrorCount () const
+  {
+    return m_txErrorCount;
+  }
+  /**
+   * \returns the free queue space
+   */
+  uint32_t GetFreeSpace () const
+  {
+    return m_freeSpace;
+  }
+  /**
+   * \returns the position as (x, y)
+   */
+  std::pair<uint32_t, uint32_t> GetPosition () const
+  {
+    return std::make_pair (m_positionX, m_positionY);
+  }
+
+  /**
+   * \brief Comparison operator
+   * \param o header to compare
+   * \return true if the headers are equal
+   */
+  bool operator== (NeighborStateHeader const & o) const;
+private:
+  uint32_t m_txErrorCount; ///< TX error count
+  uint32_t m_freeSpace;    ///< Free queue space
+  uint32_t m_positionX;    ///< X position
+  uint32_t m_positionY;    ///< Y position
+};
+
+/**
+  * \brief Stream output operator
+  * \param os output stream
+  * \return updated stream
+  */
+std::ostream & operator<< (std::ostream & os, NeighborStateHeader const &);
+
 }  // namespace aodvDbscan
 }  // namespace ns3
 
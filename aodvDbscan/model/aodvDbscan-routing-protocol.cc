@@ -34,6 +34,7 @@
 #include "aodvDbscan-routing-protocol.h"
 #include "ns3/log.h"
 #include "ns3/boolean.h"
+#include "ns3/double.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/trace-source-accessor.h"
@@ -45,7 +46,9 @@
 #include "ns3/wifi-mac-queue.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/energy-source-container.h"
 #include <algorithm>
+#include <cmath>
 #include <limits>
 
 namespace ns3 {
@@ -164,7 +167,46 @@ RoutingProtocol::RoutingProtocol ()
     m_maxQueueTime (Seconds (30)),
     m_destinationOnly (false),
     m_gratuitousReply (true),
+    m_macCacheCapacity (64),
     m_enableHello (false),
+    m_enableLinkQuality (false),
+    m_linkQualityWindow (10),
+    m_enableDpdBloomFilter (false),
+    m_dpdBloomCapacity (1000),
+    m_dpdFalsePositiveRate (0.001),
+    m_compactEncoding (false),
+    m_compactOriginX (0),
+    m_compactOriginY (0),
+    m_compactResolution (1),
+    m_compactRefreshInterval (5),
+    m_enableMotion (false),
+    m_multiTargetRreq (false),
+    m_maxExtrapolation (Seconds (5)),
+    m_enablePiggyback (false),
+    m_locationCacheCapacity (256),
+    m_epsilon (0.3),
+    m_minPts (2),
+    m_greedyFallbackNeighbors (3),
+    m_multipath (false),
+    m_localRepair (false),
+    m_maxRepairTtl (10),
+    m_predictiveRediscovery (false),
+    m_linkRange (250),
+    m_preemptiveMargin (Seconds (2)),
+    m_destinationRreqRate (2),
+    m_destinationRreqBurst (5),
+    m_discoveryCoalescingWindow (MilliSeconds (500)),
+    m_distanceTtl (false),
+    m_replyAggregationWindow (Seconds (0)),
+    m_energyAware (false),
+    m_energyWeight (1),
+    m_locationMaxAge (Seconds (30)),
+    m_locationHalfLife (Seconds (10)),
+    m_adaptiveHello (false),
+    m_minHelloInterval (MilliSeconds (250)),
+    m_maxHelloInterval (Seconds (4)),
+    m_helloMaxDisplacement (20),
+    m_helloChurnThreshold (0.25),
     m_routingTable (m_deletePeriod),
     m_queue (m_maxQueueLen, m_maxQueueTime),
     m_requestId (0),
@@ -174,8 +216,15 @@ RoutingProtocol::RoutingProtocol ()
     m_nb (m_helloInterval * 2),
     m_rreqCount (0),
     m_rerrCount (0),
+    m_helloSeqNo (0),
+    m_hellosSinceRefresh (0),
+    m_lastHelloTxError (0),
+    m_lastHelloFreeSpace (0),
+    m_lastHelloPosition (0, 0),
     m_txerrorCount(0),
     m_htimer (Timer::CANCEL_ON_DESTROY),
+    m_currentHelloInterval (Seconds (1)),
+    m_lastLinkChanges (0),
     m_rreqRateLimitTimer (Timer::CANCEL_ON_DESTROY),
     m_rerrRateLimitTimer (Timer::CANCEL_ON_DESTROY),
     m_lastBcastTime (Seconds (0))
@@ -286,6 +335,11 @@ RoutingProtocol::GetTypeId (void)
                    MakeBooleanAccessor (&RoutingProtocol::SetDestinationOnlyFlag,
                                         &RoutingProtocol::GetDestinationOnlyFlag),
                    MakeBooleanChecker ())
+    .AddAttribute ("MacCacheCapacity", "Maximum number of neighbor IP to MAC mappings cached, "
+                   "the least recently used are evicted.",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&RoutingProtocol::m_macCacheCapacity),
+                   MakeUintegerChecker<uint32_t> (1))
     .AddAttribute ("EnableHello", "Indicates whether a hello messages enable.",
                    BooleanValue (true),
                    MakeBooleanAccessor (&RoutingProtocol::SetHelloEnable,
@@ -296,11 +350,205 @@ RoutingProtocol::GetTypeId (void)
                    MakeBooleanAccessor (&RoutingProtocol::SetBroadcastEnable,
                                         &RoutingProtocol::GetBroadcastEnable),
                    MakeBooleanChecker ())
+    .AddAttribute ("EnableLinkQuality", "Indicates whether hellos advertise delivery ratios so that "
+                   "neighbors can estimate the ETX of their links.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_enableLinkQuality),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LinkQualityWindow", "Number of hello intervals the hello delivery ratio is measured over.",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&RoutingProtocol::SetLinkQualityWindow,
+                                         &RoutingProtocol::GetLinkQualityWindow),
+                   MakeUintegerChecker<uint16_t> (1))
+    .AddAttribute ("EnableDpdBloomFilter", "Indicates whether duplicate broadcast data packets are detected with rotating "
+                   "Bloom filters of fixed size instead of an exact cache of all packets seen.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_enableDpdBloomFilter),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DpdBloomCapacity", "Expected number of broadcast data packets seen within PathDiscoveryTime, "
+                   "used to size the Bloom filters.",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&RoutingProtocol::m_dpdBloomCapacity),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("DpdFalsePositiveRate", "Target probability that the Bloom filters report a new broadcast data packet as duplicate.",
+                   DoubleValue (0.001),
+                   MakeDoubleAccessor (&RoutingProtocol::m_dpdFalsePositiveRate),
+                   MakeDoubleChecker<double> (1e-9, 0.5))
+    .AddAttribute ("CompactEncoding", "Indicates whether RREPs and hellos carry TX error count, free space and "
+                   "position in the compact encoding. All nodes must agree on the origin and resolution.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_compactEncoding),
+                   MakeBooleanChecker ())
+    .AddAttribute ("CompactOriginX", "X coordinate of the origin compact positions are quantized against.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&RoutingProtocol::m_compactOriginX),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CompactOriginY", "Y coordinate of the origin compact positions are quantized against.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&RoutingProtocol::m_compactOriginY),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CompactResolution", "Distance one step of a 16 bit compact coordinate stands for.",
+                   DoubleValue (1),
+                   MakeDoubleAccessor (&RoutingProtocol::m_compactResolution),
+                   MakeDoubleChecker<double> (0.001))
+    .AddAttribute ("CompactRefreshInterval", "With the compact encoding, every how many hellos all fields are sent "
+                   "rather than only those changed since the previous hello.",
+                   UintegerValue (5),
+                   MakeUintegerAccessor (&RoutingProtocol::m_compactRefreshInterval),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("EnableMotion", "Indicates whether RREPs and hellos carry the velocity of the node, so that "
+                   "forwarder selection can dead reckon the current position of the destination.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_enableMotion),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxExtrapolation", "Longest time a destination position is dead reckoned forward.",
+                   TimeValue (Seconds (5)),
+                   MakeTimeAccessor (&RoutingProtocol::m_maxExtrapolation),
+                   MakeTimeChecker ())
+    .AddAttribute ("EnableMultiTargetRreq", "Indicates whether a RREQ reaches the selected cluster as a single broadcast "
+                   "listing the cluster members as forwarders, rather than as one unicast per member.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_multiTargetRreq),
+                   MakeBooleanChecker ())
+    .AddAttribute ("EnablePiggyback", "Indicates whether control messages carry the sender's TX error count, free space "
+                   "and position, so that any control message can stand in for a hello.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_enablePiggyback),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LocationCacheCapacity", "Maximum number of nodes whose last known position is remembered, "
+                   "the least recently used one is forgotten first.",
+                   UintegerValue (256),
+                   MakeUintegerAccessor (&RoutingProtocol::m_locationCacheCapacity),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("LocationMaxAge", "Age after which a known position is no longer used and RREQs "
+                   "for the node are broadcast.",
+                   TimeValue (Seconds (30)),
+                   MakeTimeAccessor (&RoutingProtocol::m_locationMaxAge),
+                   MakeTimeChecker ())
+    .AddAttribute ("LocationHalfLife", "Age at which the confidence in a known position has halved. "
+                   "Less certain positions select wider clusters.",
+                   TimeValue (Seconds (10)),
+                   MakeTimeAccessor (&RoutingProtocol::m_locationHalfLife),
+                   MakeTimeChecker ())
+    .AddAttribute ("Epsilon", "Radius of the DBSCAN neighborhood in the normalized feature space, for a fresh "
+                   "destination position. It grows up to twice as the confidence in the position decays.",
+                   DoubleValue (0.3),
+                   MakeDoubleAccessor (&RoutingProtocol::m_epsilon),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("MinPts", "Minimum number of neighbors within the DBSCAN neighborhood of a core point.",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&RoutingProtocol::m_minPts),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("GreedyFallbackNeighbors", "Number of neighbors closest to the destination a RREQ is sent to "
+                   "when no cluster is found. The RREQ is broadcast if no neighbor is closer than this node, "
+                   "or if this is 0.",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&RoutingProtocol::m_greedyFallbackNeighbors),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("EnableMultipath", "Indicates whether RREPs arriving through other neighbors are kept as "
+                   "alternate next hops, used instead of rediscovery when the link to the next hop breaks.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_multipath),
+                   MakeBooleanChecker ())
+    .AddAttribute ("EnableLocalRepair", "Indicates whether the node upstream of a broken link buffers the packets "
+                   "in flight and repairs the route with a TTL-limited RREQ sent to the cluster near the "
+                   "destination's last known position, instead of reporting the route broken to the source.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_localRepair),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxRepairTtl", "Largest TTL of a local repair RREQ. Routes to destinations further away are "
+                   "reported broken.",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&RoutingProtocol::m_maxRepairTtl),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("EnablePredictiveRediscovery", "Indicates whether a route is rediscovered in the background "
+                   "when the link to its next hop is predicted to break, from the positions and velocities "
+                   "of both ends. Needs EnableMotion on the neighbors.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_predictiveRediscovery),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LinkRange", "Distance in meters at which a link is predicted to break.",
+                   DoubleValue (250),
+                   MakeDoubleAccessor (&RoutingProtocol::m_linkRange),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("PreemptiveMargin", "How long before the predicted break of a link the rediscovery starts. "
+                   "Should exceed the time a route discovery takes.",
+                   TimeValue (Seconds (2)),
+                   MakeTimeAccessor (&RoutingProtocol::m_preemptiveMargin),
+                   MakeTimeChecker ())
+    .AddAttribute ("DestinationRreqRate", "Maximum number of RREQ per second for one destination, in the long run. "
+                   "RreqRateLimit still caps the RREQs for all destinations.",
+                   DoubleValue (2),
+                   MakeDoubleAccessor (&RoutingProtocol::m_destinationRreqRate),
+                   MakeDoubleChecker<double> (0.001))
+    .AddAttribute ("DestinationRreqBurst", "Maximum number of RREQ one destination may be sent back to back.",
+                   UintegerValue (5),
+                   MakeUintegerAccessor (&RoutingProtocol::m_destinationRreqBurst),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("DiscoveryCoalescingWindow", "Shortest time between two route discoveries started for queued "
+                   "packets to the same destination. Packets queued within the window wait for a single discovery.",
+                   TimeValue (MilliSeconds (500)),
+                   MakeTimeAccessor (&RoutingProtocol::m_discoveryCoalescingWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("EnableDistanceTtl", "Indicates whether the first RREQ to a destination of known position "
+                   "gets the TTL of the distance to it divided by the distance to the farthest neighbor, "
+                   "skipping the smaller rings of the expanding ring search.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_distanceTtl),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ReplyAggregationWindow", "How long an intermediate node holds the RREPs and gratuitous RREPs "
+                   "it generates. Those to the same next hop leave in one packet, duplicates for the same "
+                   "destination, sequence number and origin are dropped. 0, the default, sends every RREP "
+                   "at once, without delaying a discovery.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&RoutingProtocol::m_replyAggregationWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("EnableEnergyAwareness", "Indicates whether hellos carry the residual energy of the node's "
+                   "energy source and the cluster a RREQ goes to is chosen favoring neighbors with more of it.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_energyAware),
+                   MakeBooleanChecker ())
+    .AddAttribute ("EnergyWeight", "Weight of the residual energy among the clustering features, "
+                   "the distance, TX errors, free space and link ETX weighing 1 each.",
+                   DoubleValue (1),
+                   MakeDoubleAccessor (&RoutingProtocol::m_energyWeight),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("EnableAdaptiveHello", "Indicates whether the hello interval shrinks with the node's speed and "
+                   "neighbor churn and grows up to MaxHelloInterval while the neighborhood is stable.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_adaptiveHello),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MinHelloInterval", "Shortest adaptive hello interval.",
+                   TimeValue (MilliSeconds (250)),
+                   MakeTimeAccessor (&RoutingProtocol::m_minHelloInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxHelloInterval", "Longest adaptive hello interval.",
+                   TimeValue (Seconds (4)),
+                   MakeTimeAccessor (&RoutingProtocol::m_maxHelloInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("HelloMaxDisplacement", "Distance in meters the node may move between two adaptive hellos.",
+                   DoubleValue (20),
+                   MakeDoubleAccessor (&RoutingProtocol::m_helloMaxDisplacement),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("HelloChurnThreshold", "Links opened or closed per neighbor within one hello interval "
+                   "above which the adaptive hello interval is halved.",
+                   DoubleValue (0.25),
+                   MakeDoubleAccessor (&RoutingProtocol::m_helloChurnThreshold),
+                   MakeDoubleChecker<double> (0))
     .AddAttribute ("UniformRv",
                    "Access to the underlying UniformRandomVariable",
                    StringValue ("ns3::UniformRandomVariable"),
                    MakePointerAccessor (&RoutingProtocol::m_uniformRandomVariable),
                    MakePointerChecker<UniformRandomVariable> ())
+    .AddTraceSource ("NextHelloInterval", "The time until the next hello, every time a hello is due.",
+                     MakeTraceSourceAccessor (&RoutingProtocol::m_nextHelloIntervalTrace),
+                     "ns3::aodvDbscan::RoutingProtocol::NextHelloIntervalTracedCallback")
+    .AddTraceSource ("NeighborChurn", "Links opened or closed per neighbor since the last hello.",
+                     MakeTraceSourceAccessor (&RoutingProtocol::m_neighborChurnTrace),
+                     "ns3::aodvDbscan::RoutingProtocol::NeighborChurnTracedCallback")
+    .AddTraceSource ("TxControl", "A control packet is sent to a neighbor or broadcast.",
+                     MakeTraceSourceAccessor (&RoutingProtocol::m_txControlTrace),
+                     "ns3::aodvDbscan::RoutingProtocol::TxControlTracedCallback")
   ;
   return tid;
 }
@@ -338,6 +586,27 @@ RoutingProtocol::DoDispose ()
       iter->first->Close ();
     }
   m_socketSubnetBroadcastAddresses.clear ();
+  for (std::map<Ipv4Address, LocalRepair>::iterator i = m_localRepairs.begin (); i != m_localRepairs.end (); ++i)
+    {
+      i->second.m_timer.Cancel ();
+    }
+  m_localRepairs.clear ();
+  for (std::map<Ipv4Address, Discovery>::iterator i = m_discoveries.begin (); i != m_discoveries.end (); ++i)
+    {
+      i->second.m_pending.Cancel ();
+    }
+  m_discoveries.clear ();
+  for (std::map<Ipv4Address, AggregatedReplies>::iterator i = m_aggregatedReplies.begin ();
+       i != m_aggregatedReplies.end (); ++i)
+    {
+      i->second.m_timer.Cancel ();
+    }
+  m_aggregatedReplies.clear ();
+  Ptr<Node> node = GetObject<Node> ();
+  if (node)
+    {
+      node->UnregisterProtocolHandler (MakeCallback (&RoutingProtocol::NotifyRxFrame, this));
+    }
   Ipv4RoutingProtocol::DoDispose ();
 }
 
@@ -369,6 +638,7 @@ RoutingProtocol::Start ()
     {
       m_nb.ScheduleTimer ();
     }
+  m_currentHelloInterval = m_helloInterval;
   m_rreqRateLimitTimer.SetFunction (&RoutingProtocol::RreqRateLimitTimerExpire,
                                     this);
   m_rreqRateLimitTimer.Schedule (Seconds (1));
@@ -377,6 +647,20 @@ RoutingProtocol::Start ()
                                     this);
   m_rerrRateLimitTimer.Schedule (Seconds (1));
 
+  if (m_enableDpdBloomFilter)
+    {
+      m_dpd.EnableBloomFilter (m_dpdBloomCapacity, m_dpdFalsePositiveRate);
+    }
+  m_locationCache.SetCapacity (m_locationCacheCapacity);
+  m_locationCache.SetMaxAge (m_locationMaxAge);
+  m_locationCache.SetHalfLife (m_locationHalfLife);
+  m_locationCache.SetMaxExtrapolation (m_maxExtrapolation);
+  m_routingTable.SetEnergyWeight (m_energyAware ? m_energyWeight : 0);
+  m_nb.SetMacCacheCapacity (m_macCacheCapacity);
+
+  // Learn neighbor MAC addresses from received control frames on any device
+  GetObject<Node> ()->RegisterProtocolHandler (MakeCallback (&RoutingProtocol::NotifyRxFrame, this),
+                                               Ipv4L3Protocol::PROT_NUMBER, 0, false);
 }
 
 Ptr<Ipv4Route>
@@ -413,6 +697,7 @@ RoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
         }
       UpdateRouteLifeTime (dst, m_activeRouteTimeout);
       UpdateRouteLifeTime (route->GetGateway (), m_activeRouteTimeout);
+      CheckLinkLifetime (dst, route->GetGateway ());
       return route;
     }
 
@@ -447,7 +732,7 @@ RoutingProtocol::DeferredRouteOutput (Ptr<const Packet> p, const Ipv4Header & he
       if (!result || ((rt.GetFlag () != IN_SEARCH) && result))
         {
           NS_LOG_LOGIC ("Send new RREQ for outbound packet to " << header.GetDestination ());
-          SendRequest (header.GetDestination ());
+          RequestDiscovery (header.GetDestination ());
         }
     }
 }
@@ -634,10 +919,25 @@ RoutingProtocol::Forwarding (Ptr<const Packet> p, const Ipv4Header & header,
 
           m_nb.Update (route->GetGateway (), m_activeRouteTimeout);
           m_nb.Update (toOrigin.GetNextHop (), m_activeRouteTimeout);
+          CheckLinkLifetime (dst, route->GetGateway ());
 
           ucb (route, p, header);
           return true;
         }
+      else if (toDst.GetFlag () == IN_SEARCH && m_localRepairs.find (dst) != m_localRepairs.end ())
+        {
+          // Hold the packet until the route is repaired. It is kept apart from the packets
+          // originated here, which SendPacketFromQueue gives our source address.
+          LocalRepair & repair = m_localRepairs[dst];
+          if (repair.m_packets.size () < m_maxQueueLen)
+            {
+              repair.m_packets.push_back (QueueEntry (p, header, ucb, ecb, m_maxQueueTime));
+              NS_LOG_LOGIC ("Route to " << dst << " under repair, packet " << p->GetUid () << " buffered");
+              return true;
+            }
+          NS_LOG_DEBUG ("Drop packet " << p->GetUid () << " because the repair buffer is full.");
+          return false;
+        }
       else
         {
           if (toDst.GetValidSeqNo ())
@@ -747,6 +1047,34 @@ RoutingProtocol::NotifyTxError (WifiMacDropReason reason, Ptr<const WifiMpdu> mp
   m_nb.GetTxErrorCallback ()(hdr);
 }
 
+void
+RoutingProtocol::NotifyRxFrame (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                                const Address &from, const Address &to, NetDevice::PacketType packetType)
+{
+  // Every IPv4 frame comes here, so only the IPv4 and UDP headers are read, without copying the packet
+  uint8_t buffer[28];
+  if (packet->GetSize () < sizeof (buffer) || !Mac48Address::IsMatchingType (from))
+    {
+      return;
+    }
+  packet->CopyData (buffer, sizeof (buffer));
+  // aodvDbscan control packets carry no IPv4 options
+  if (buffer[0] != 0x45 || buffer[9] != UdpL4Protocol::PROT_NUMBER
+      || ((buffer[22] << 8) | buffer[23]) != aodvDbscan_PORT)
+    {
+      return;
+    }
+  // Control messages are regenerated at each hop, so their source is always the transmitting neighbor
+  Ipv4Address source = Ipv4Address::Deserialize (buffer + 12);
+  int32_t interface = m_ipv4->GetInterfaceForDevice (device);
+  if (interface < 0 || IsMyOwnAddress (source))
+    {
+      return;
+    }
+  Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
+  m_nb.LearnMacAddress (source, Mac48Address::ConvertFrom (from), l3->GetInterface (interface)->GetArpCache ());
+}
+
 void
 RoutingProtocol::NotifyInterfaceDown (uint32_t i)
 {
@@ -979,29 +1307,52 @@ void
 RoutingProtocol::SendRequest (Ipv4Address dst)
 {
   NS_LOG_FUNCTION ( this << dst);
+  Discovery & discovery = GetDiscovery (dst);
+  if (discovery.m_pending.IsRunning ())
+    {
+      NS_LOG_LOGIC ("RREQ to " << dst << " already pending");
+      return;
+    }
+  RoutingTableEntry found;
+  if (m_routingTable.LookupValidRoute (dst, found))
+    {
+      // Found while the RREQ was deferred
+      SendPacketFromQueue (dst, found.GetRoute ());
+      return;
+    }
+  // One destination should not use up the RREQs of all the others
+  Time wait = RefillRequestTokens (discovery);
+  if (wait.IsStrictlyPositive ())
+    {
+      NS_LOG_LOGIC ("RREQ rate of " << dst << " reached, defer RREQ by " << wait.As (Time::S));
+      discovery.m_pending = Simulator::Schedule (wait, &RoutingProtocol::SendRequest, this, dst);
+      return;
+    }
   // A node SHOULD NOT originate more than RREQ_RATELIMIT RREQ messages per second.
   if (m_rreqCount == m_rreqRateLimit)
     {
-      Simulator::Schedule (m_rreqRateLimitTimer.GetDelayLeft () + MicroSeconds (100),
-                           &RoutingProtocol::SendRequest, this, dst);
+      discovery.m_pending = Simulator::Schedule (m_rreqRateLimitTimer.GetDelayLeft () + MicroSeconds (100),
+                                                 &RoutingProtocol::SendRequest, this, dst);
       return;
     }
   else
     {
       m_rreqCount++;
     }
+  discovery.m_tokens -= 1;
+  discovery.m_started = Simulator::Now ();
   // Create RREQ header
   RreqHeader rreqHeader;
   rreqHeader.SetDst (dst);
 
   RoutingTableEntry rt;
   // Using the Hop field in Routing Table to manage the expanding ring search
-  uint16_t ttl = m_ttlStart;
+  uint16_t ttl = InitialTtl (dst);
   if (m_routingTable.LookupRoute (dst, rt))
     {
       if (rt.GetFlag () != IN_SEARCH)
         {
-          ttl = std::min<uint16_t> (rt.GetHop () + m_ttlIncrement, m_netDiameter);
+          ttl = std::min<uint16_t> (std::max<uint16_t> (rt.GetHop () + m_ttlIncrement, ttl), m_netDiameter);
         }
       else
         {
@@ -1059,6 +1410,103 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
   m_requestId++;
   rreqHeader.SetId (m_requestId);
 
+  TransmitRequest (dst, rreqHeader, ttl);
+  ScheduleRreqRetry (dst);
+}
+
+void
+RoutingProtocol::RequestDiscovery (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  Discovery & discovery = GetDiscovery (dst);
+  if (discovery.m_pending.IsRunning ())
+    {
+      NS_LOG_LOGIC ("Discovery of " << dst << " already pending");
+      return;
+    }
+  Time sinceStart = Simulator::Now () - discovery.m_started;
+  if (sinceStart < m_discoveryCoalescingWindow)
+    {
+      NS_LOG_LOGIC ("Discovery of " << dst << " coalesced, next one in "
+                    << (m_discoveryCoalescingWindow - sinceStart).As (Time::S));
+      discovery.m_pending = Simulator::Schedule (m_discoveryCoalescingWindow - sinceStart,
+                                                 &RoutingProtocol::SendRequest, this, dst);
+      return;
+    }
+  SendRequest (dst);
+}
+
+uint16_t
+RoutingProtocol::InitialTtl (Ipv4Address dst)
+{
+  LocationCache::Position posDst;
+  if (!m_distanceTtl || !m_locationCache.Lookup (dst, posDst))
+    {
+      return m_ttlStart;
+    }
+  m_position = m_ipv4->GetObject<Node> ()->GetObject<MobilityModel> ()->GetPosition ();
+  double hopRange = m_routingTable.NeighborRange (m_position.x, m_position.y);
+  if (hopRange <= 0)
+    {
+      return m_ttlStart;
+    }
+  double dx = posDst.first - m_position.x;
+  double dy = posDst.second - m_position.y;
+  double hops = std::ceil (std::sqrt (dx * dx + dy * dy) / hopRange);
+  if (hops > m_ttlThreshold)
+    {
+      // The expanding ring search would jump to the whole network anyway
+      return m_netDiameter;
+    }
+  NS_LOG_LOGIC (dst << " about " << hops << " hops away, " << hopRange << " m per hop");
+  return std::max<uint16_t> (m_ttlStart, hops);
+}
+
+RoutingProtocol::Discovery &
+RoutingProtocol::GetDiscovery (Ipv4Address dst)
+{
+  std::map<Ipv4Address, Discovery>::iterator i = m_discoveries.find (dst);
+  if (i == m_discoveries.end ())
+    {
+      Discovery discovery;
+      discovery.m_tokens = m_destinationRreqBurst;
+      discovery.m_refilled = Simulator::Now ();
+      discovery.m_started = Simulator::Now () - m_discoveryCoalescingWindow;
+      i = m_discoveries.insert (std::make_pair (dst, discovery)).first;
+    }
+  return i->second;
+}
+
+Time
+RoutingProtocol::RefillRequestTokens (Discovery & discovery)
+{
+  double elapsed = (Simulator::Now () - discovery.m_refilled).GetSeconds ();
+  discovery.m_tokens = std::min<double> (m_destinationRreqBurst, discovery.m_tokens + elapsed * m_destinationRreqRate);
+  discovery.m_refilled = Simulator::Now ();
+  if (discovery.m_tokens >= 1)
+    {
+      return Seconds (0);
+    }
+  return Seconds ((1 - discovery.m_tokens) / m_destinationRreqRate);
+}
+
+bool
+RoutingProtocol::TakeRequestToken (Ipv4Address dst)
+{
+  Discovery & discovery = GetDiscovery (dst);
+  if (m_rreqCount == m_rreqRateLimit || RefillRequestTokens (discovery).IsStrictlyPositive ())
+    {
+      return false;
+    }
+  m_rreqCount++;
+  discovery.m_tokens -= 1;
+  discovery.m_started = Simulator::Now ();
+  return true;
+}
+
+void
+RoutingProtocol::TransmitRequest (Ipv4Address dst, RreqHeader rreqHeader, uint16_t ttl, Ipv4Address exclude)
+{
   //std::cout << "Sending...\n";
   // Send RREQ as subnet directed broadcast from each interface used by aodvDbscan
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
@@ -1078,8 +1526,7 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
       tag.SetTtl (ttl);
       packet->AddPacketTag (tag);
       packet->AddHeader (rreqHeader);
-      TypeHeader tHeader (aodvDbscanTYPE_RREQ);
-      packet->AddHeader (tHeader);
+      AddTypeHeader (packet, aodvDbscanTYPE_RREQ);
       // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
       Ipv4Address destination;
       if (iface.GetMask () == Ipv4Mask::GetOnes ())
@@ -1088,14 +1535,14 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
             destination = Ipv4Address ("255.255.255.255");
             NS_LOG_DEBUG ("Send RREQ with id " << rreqHeader.GetId () << " to socket");
             m_lastBcastTime = Simulator::Now ();
-          Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, destination);
+          Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, packet, destination);
             
           }
-        else if(m_lastKnownPosition.find(dst) == m_lastKnownPosition.end())
+        else if(!m_locationCache.IsKnown (dst))
           {
             destination = iface.GetBroadcast ();
             m_lastBcastTime = Simulator::Now ();
-            Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, destination);
+            Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, packet, destination);
             
    
            
@@ -1105,18 +1552,26 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
       else 
       {
         std::vector<Ipv4Address>selectedCluster;
-        if(m_lastKnonwCluster.find(dst) != m_lastKnonwCluster.end())
+        bool cached = m_lastKnonwCluster.find(dst) != m_lastKnonwCluster.end();
+        if(cached)
         {
             //std::cout << rreqHeader.GetId() << " " << dst << " used from list\n";
             selectedCluster = m_lastKnonwCluster[dst];
         }
         else
         {
-            std::pair<uint32_t, uint32_t> posDst = m_lastKnownPosition.find(dst)->second;
-          
-            selectedCluster = m_routingTable.DBSCAN(dst, posDst.first, posDst.second,0.3,2);
+            LocationCache::Position posDst;
+            m_locationCache.Lookup (dst, posDst);
+            // A less certain position selects a wider cluster
+            double epsilon = m_epsilon * (2 - m_locationCache.GetConfidence (dst));
+            selectedCluster = m_routingTable.DBSCAN(dst, posDst.first, posDst.second, epsilon, m_minPts);
+            if (selectedCluster.empty ())
+            {
+              selectedCluster = SelectGreedyForwarders (posDst);
+            }
         
         }
+        selectedCluster.erase (std::remove (selectedCluster.begin (), selectedCluster.end (), exclude), selectedCluster.end ());
          
         int interval = m_uniformRandomVariable->GetInteger (0, 10);
         int neighbours = selectedCluster.size();
@@ -1124,32 +1579,149 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
         {
             destination = iface.GetBroadcast ();
             m_lastBcastTime = Simulator::Now ();
-            Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, destination);
+            Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, packet, destination);
             continue;
    
         }
-        for(int i=0;i<neighbours;i++)
+        if (m_multiTargetRreq)
+        {
+          SendRequestToCluster (socket, iface, rreqHeader, ttl, selectedCluster);
+        }
+        else
         {
-          destination = selectedCluster[i];
-          NS_LOG_DEBUG ("Send RREQ with id " << rreqHeader.GetId () << " to socket");
-          Simulator::Schedule (Time (MilliSeconds ((i+1) * interval)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+          // Tracked so that the unicasts still pending when a route is found can be cancelled
+          std::vector<EventId> & fanOut = m_rreqFanOuts[std::make_pair (dst, rreqHeader.GetId ())];
+          for(int i=0;i<neighbours;i++)
+          {
+            destination = selectedCluster[i];
+            NS_LOG_DEBUG ("Send RREQ with id " << rreqHeader.GetId () << " to socket");
+            fanOut.push_back (Simulator::Schedule (Time (MilliSeconds ((i+1) * interval)), &RoutingProtocol::SendControl, this, socket, packet, destination));
+          }
+          m_lastBcastTime = Simulator::Now () + Time(MilliSeconds(neighbours * interval));
         }
-        m_lastBcastTime = Simulator::Now () + Time(MilliSeconds(neighbours * interval));
         m_lastKnonwCluster[dst] = selectedCluster;
-        
-        Simulator::Schedule(Time(Seconds(1)), &RoutingProtocol::ClusterTimerExpire, this, dst);
+        if (!cached)
+        {
+          // A reused cluster is forgotten by the timer of the RREQ that selected it
+          Simulator::Schedule(Time(Seconds(1)), &RoutingProtocol::ClusterTimerExpire, this, dst);
+        }
       }
       
     }
-  ScheduleRreqRetry (dst);
+}
+
+void
+RoutingProtocol::CheckLinkLifetime (Ipv4Address dst, Ipv4Address nextHop)
+{
+  if (!m_predictiveRediscovery)
+    {
+      return;
+    }
+  std::map<Ipv4Address, Time>::iterator last = m_preemptiveRequests.find (dst);
+  if (last != m_preemptiveRequests.end () && Simulator::Now () - last->second < m_pathDiscoveryTime)
+    {
+      return;
+    }
+  LocationCache::Position position;
+  double vx;
+  double vy;
+  if (!m_locationCache.Lookup (nextHop, position) || !m_locationCache.GetVelocity (nextHop, vx, vy))
+    {
+      return;
+    }
+  Ptr<MobilityModel> mobility = m_ipv4->GetObject<Node> ()->GetObject<MobilityModel> ();
+  Vector ownPosition = mobility->GetPosition ();
+  Vector ownVelocity = mobility->GetVelocity ();
+  Time lifetime = LocationCache::LinkLifetime (position.first - ownPosition.x, position.second - ownPosition.y,
+                                               vx - ownVelocity.x, vy - ownVelocity.y, m_linkRange);
+  if (lifetime > m_preemptiveMargin)
+    {
+      return;
+    }
+  RoutingTableEntry toDst;
+  if (!m_routingTable.LookupValidRoute (dst, toDst) || !TakeRequestToken (dst))
+    {
+      return;
+    }
+  NS_LOG_DEBUG ("Link to " << nextHop << " predicted to break in " << lifetime.As (Time::S)
+                << ", rediscover route to " << dst);
+  m_preemptiveRequests[dst] = Simulator::Now ();
+  RreqHeader rreqHeader;
+  rreqHeader.SetDst (dst);
+  // Only a route fresher than the one about to break replaces it
+  rreqHeader.SetDstSeqno (toDst.GetSeqNo () + 1);
+  if (m_gratuitousReply)
+    {
+      rreqHeader.SetGratuitousRrep (true);
+    }
+  if (m_destinationOnly)
+    {
+      rreqHeader.SetDestinationOnly (true);
+    }
+  m_seqNo++;
+  rreqHeader.SetOriginSeqno (m_seqNo);
+  m_requestId++;
+  rreqHeader.SetId (m_requestId);
+  // The next hop about to break must not carry the RREQ looking for a way around it
+  TransmitRequest (dst, rreqHeader, std::min<uint16_t> (toDst.GetHop () + m_ttlIncrement, m_netDiameter), nextHop);
+}
+
+void
+RoutingProtocol::SendRequestToCluster (Ptr<Socket> socket, Ipv4InterfaceAddress const & iface, RreqHeader rreqHeader,
+                                       uint8_t ttl, std::vector<Ipv4Address> const & cluster)
+{
+  for (std::vector<Ipv4Address>::const_iterator i = cluster.begin (); i != cluster.end (); ++i)
+    {
+      if (!rreqHeader.AddForwarder (*i))
+        {
+          break;
+        }
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag tag;
+  tag.SetTtl (ttl);
+  packet->AddPacketTag (tag);
+  packet->AddHeader (rreqHeader);
+  AddTypeHeader (packet, aodvDbscanTYPE_RREQ);
+  NS_LOG_DEBUG ("Send RREQ with id " << rreqHeader.GetId () << " to " << (uint32_t) rreqHeader.GetForwarderCount () << " forwarders");
+  m_lastBcastTime = Simulator::Now ();
+  Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, packet, iface.GetBroadcast ());
 }
 
 void
 RoutingProtocol::SendTo (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination)
 {
+  m_txControlTrace (packet, destination);
   socket->SendTo (packet, 0, InetSocketAddress (destination, aodvDbscan_PORT));
+}
+
+void
+RoutingProtocol::SendControl (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination)
+{
+  if (m_enablePiggyback)
+    {
+      // Whatever the destination, the message carried our state, the next hello can wait
+      m_lastBcastTime = Simulator::Now ();
+    }
+  SendTo (socket, packet, destination);
+}
 
+void
+RoutingProtocol::AddTypeHeader (Ptr<Packet> packet, MessageType type)
+{
+  TypeHeader tHeader (type);
+  if (m_enablePiggyback)
+    {
+      // Added once however many times the message is sent, the state is a few milliseconds old at most
+      m_position = m_ipv4->GetObject<Node> ()->GetObject<MobilityModel> ()->GetPosition ();
+      NeighborStateHeader stateHeader (m_txerrorCount, m_queue.GetFreeQueueLen (),
+                                       (uint32_t) m_position.x, (uint32_t) m_position.y);
+      packet->AddHeader (stateHeader);
+      tHeader.SetNeighborState (true);
+    }
+  packet->AddHeader (tHeader);
 }
+
 void
 RoutingProtocol::ScheduleRreqRetry (Ipv4Address dst)
 {
@@ -1230,6 +1802,12 @@ RoutingProtocol::RecvaodvDbscan (Ptr<Socket> socket)
       NS_LOG_DEBUG ("aodvDbscan message " << packet->GetUid () << " with unknown type received: " << tHeader.Get () << ". Drop");
       return; // drop
     }
+  if (tHeader.HasNeighborState ())
+    {
+      NeighborStateHeader stateHeader;
+      packet->RemoveHeader (stateHeader);
+      ProcessNeighborState (stateHeader, sender);
+    }
   switch (tHeader.Get ())
     {
     case aodvDbscanTYPE_RREQ:
@@ -1239,7 +1817,21 @@ RoutingProtocol::RecvaodvDbscan (Ptr<Socket> socket)
       }
     case aodvDbscanTYPE_RREP:
       {
-        RecvReply (packet, receiver, sender);
+        // Aggregated RREPs follow each other in one packet
+        while (true)
+          {
+            packet->RemoveAtStart (RecvReply (packet, receiver, sender));
+            if (packet->GetSize () == 0)
+              {
+                break;
+              }
+            packet->RemoveHeader (tHeader);
+            if (!tHeader.IsValid () || tHeader.Get () != aodvDbscanTYPE_RREP)
+              {
+                NS_LOG_DEBUG ("Unexpected message after RREP in packet " << packet->GetUid () << ". Drop");
+                break;
+              }
+          }
         break;
       }
     case aodvDbscanTYPE_RERR:
@@ -1301,6 +1893,7 @@ RoutingProtocol::UpdateRouteToNeighbor (Ipv4Address sender, Ipv4Address receiver
                                                   /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0),
                                                   /*hops=*/ 1, /*next hop=*/ sender, /*lifetime=*/ std::max (m_activeRouteTimeout, toNeighbor.GetLifeTime ())
                                                   );
+          newEntry.CopyAdvertisedState (toNeighbor);
           m_routingTable.Update (newEntry);
 
         }
@@ -1309,11 +1902,12 @@ RoutingProtocol::UpdateRouteToNeighbor (Ipv4Address sender, Ipv4Address receiver
 }
 
 void
-RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address src)
+RoutingProtocol::RecvRequest (Ptr<const Packet> p, Ipv4Address receiver, Ipv4Address src)
 {
   NS_LOG_FUNCTION (this);
+  // Only peek: a forwarded RREQ is built from the received bytes, see below
   RreqHeader rreqHeader;
-  p->RemoveHeader (rreqHeader);
+  p->PeekHeader (rreqHeader);
 
   // A node ignores all RREQs received from any node in its blacklist
   RoutingTableEntry toPrev;
@@ -1326,6 +1920,13 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
         }
     }
 
+  // A RREQ broadcast to a cluster is only for the listed forwarders and the destination
+  if (!rreqHeader.IsForwarder (receiver) && !IsMyOwnAddress (rreqHeader.GetDst ()))
+    {
+      NS_LOG_DEBUG ("Ignoring RREQ addressed to other forwarders");
+      return;
+    }
+
   uint32_t id = rreqHeader.GetId ();
   Ipv4Address origin = rreqHeader.GetOrigin ();
   
@@ -1465,25 +2066,31 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
     }
 
   SocketIpTtlTag tag;
-  p->RemovePacketTag (tag);
+  p->PeekPacketTag (tag);
   if (tag.GetTtl () < 2)
     {
       NS_LOG_DEBUG ("TTL exceeded. Drop RREQ origin " << src << " destination " << dst );
       return;
     }
 
+  /*
+   * One packet is forwarded on every interface, the socket copies (copy-on-write) it on each
+   * send. It is built from the received bytes with only the hop count and sequence fields
+   * patched, rather than serialized again.
+   */
+  // Forwarders of the next hop are chosen below
+  rreqHeader.ClearForwarders ();
+  Ptr<Packet> packet = rreqHeader.CreateForwarded (p);
+  SocketIpTtlTag ttl;
+  ttl.SetTtl (tag.GetTtl () - 1);
+  packet->AddPacketTag (ttl);
+  AddTypeHeader (packet, aodvDbscanTYPE_RREQ);
+
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
          m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
     {
       Ptr<Socket> socket = j->first;
       Ipv4InterfaceAddress iface = j->second;
-      Ptr<Packet> packet = Create<Packet> ();
-      SocketIpTtlTag ttl;
-      ttl.SetTtl (tag.GetTtl () - 1);
-      packet->AddPacketTag (ttl);
-      packet->AddHeader (rreqHeader);
-      TypeHeader tHeader (aodvDbscanTYPE_RREQ);
-      packet->AddHeader (tHeader);
       // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
       Ipv4Address destination;
       
@@ -1492,16 +2099,16 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
         {
           destination = Ipv4Address ("255.255.255.255");
            m_lastBcastTime = Simulator::Now ();
-          Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, destination);
+          Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, packet, destination);
 
           
         }
-        else if(m_lastKnownPosition.find(dst) == m_lastKnownPosition.end() || m_routingTable.isEmpty()) 
+        else if(!m_locationCache.IsKnown (dst) || m_routingTable.isEmpty()) 
         { 
           
             destination = iface.GetBroadcast ();
             m_lastBcastTime = Simulator::Now ();
-           Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, destination);
+           Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, packet, destination);
 
         }
          
@@ -1516,9 +2123,15 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
         }
         else
         {
-            std::pair<uint32_t, uint32_t> posDst = m_lastKnownPosition.find(dst)->second;
-          
-            selectedCluster = m_routingTable.DBSCAN(dst, posDst.first, posDst.second,0.3,2);
+            LocationCache::Position posDst;
+            m_locationCache.Lookup (dst, posDst);
+            // A less certain position selects a wider cluster
+            double epsilon = m_epsilon * (2 - m_locationCache.GetConfidence (dst));
+            selectedCluster = m_routingTable.DBSCAN(dst, posDst.first, posDst.second, epsilon, m_minPts);
+            if (selectedCluster.empty ())
+            {
+              selectedCluster = SelectGreedyForwarders (posDst);
+            }
         
         }
         int interval = m_uniformRandomVariable->GetInteger (0, 10);
@@ -1527,17 +2140,26 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
         {
             destination = iface.GetBroadcast ();
             m_lastBcastTime = Simulator::Now ();
-            Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, destination);
+            Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, packet, destination);
             continue;
    
         }
-        for(int i=0;i<neighbours;i++)
+        if (m_multiTargetRreq)
+        {
+          SendRequestToCluster (socket, iface, rreqHeader, tag.GetTtl () - 1, selectedCluster);
+        }
+        else
         {
-          destination = selectedCluster[i];
-          NS_LOG_DEBUG ("Send RREQ with id " << rreqHeader.GetId () << " to socket");
-          Simulator::Schedule (Time (MilliSeconds ((i+1) * interval)), &RoutingProtocol::SendTo, this, socket, packet, destination);
+          // Tracked so that the unicasts still pending when a route is found can be cancelled
+          std::vector<EventId> & fanOut = m_rreqFanOuts[std::make_pair (dst, rreqHeader.GetId ())];
+          for(int i=0;i<neighbours;i++)
+          {
+            destination = selectedCluster[i];
+            NS_LOG_DEBUG ("Send RREQ with id " << rreqHeader.GetId () << " to socket");
+            fanOut.push_back (Simulator::Schedule (Time (MilliSeconds ((i+1) * interval)), &RoutingProtocol::SendControl, this, socket, packet, destination));
+          }
+          m_lastBcastTime = Simulator::Now () + Time(MilliSeconds(neighbours * interval));
         }
-        m_lastBcastTime = Simulator::Now () + Time(MilliSeconds(neighbours * interval));
         m_lastKnonwCluster[dst] = selectedCluster;
         
 
@@ -1570,16 +2192,17 @@ RoutingProtocol::SendReply (RreqHeader const & rreqHeader, RoutingTableEntry con
                                           /*dstSeqNo=*/ m_seqNo, /*origin=*/ toOrigin.GetDestination (), /*lifeTime=*/ m_myRouteTimeout,
                                           /*txerrors=*/m_txerrorCount, /*freeSpace=*/ m_queue.GetFreeQueueLen(),
                                           /*positionX=*/(uint32_t) m_position.x, /*positionY=*/(uint32_t) m_position.y);
+  ApplyCompactEncoding (rrepHeader);
+  ApplyMotion (rrepHeader);
   Ptr<Packet> packet = Create<Packet> ();
   SocketIpTtlTag tag;
   tag.SetTtl (toOrigin.GetHop ());
   packet->AddPacketTag (tag);
   packet->AddHeader (rrepHeader);
-  TypeHeader tHeader (aodvDbscanTYPE_RREP);
-  packet->AddHeader (tHeader);
+  AddTypeHeader (packet, aodvDbscanTYPE_RREP);
   Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
   NS_ASSERT (socket);
-  socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetNextHop (), aodvDbscan_PORT));
+  SendControl (socket, packet, toOrigin.GetNextHop ());
 }
 
 void
@@ -1594,6 +2217,11 @@ RoutingProtocol::SendReplyByIntermediateNode (RoutingTableEntry & toDst, Routing
                                           /*origin=*/ toOrigin.GetDestination (), /*lifetime=*/ toDst.GetLifeTime (),
                                           /*txerrors=*/ toDst.GetTxErrorCount(), /*freeSpace=*/toDst.GetFreeSpace(),
                                           /*positionX=*/toDst.GetPositionX(), /*positionY*/toDst.GetPositionY());
+  ApplyCompactEncoding (rrepHeader);
+  if (m_compactEncoding && !toDst.HasPosition ())
+    {
+      rrepHeader.OmitFields (RrepHeader::POSITION);
+    }
   /* If the node we received a RREQ for is a neighbor we are
    * probably facing a unidirectional link... Better request a RREP-ack
    */
@@ -1611,16 +2239,9 @@ RoutingProtocol::SendReplyByIntermediateNode (RoutingTableEntry & toDst, Routing
   m_routingTable.Update (toDst);
   m_routingTable.Update (toOrigin);
 
-  Ptr<Packet> packet = Create<Packet> ();
-  SocketIpTtlTag tag;
-  tag.SetTtl (toOrigin.GetHop ());
-  packet->AddPacketTag (tag);
-  packet->AddHeader (rrepHeader);
-  TypeHeader tHeader (aodvDbscanTYPE_RREP);
-  packet->AddHeader (tHeader);
   Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
   NS_ASSERT (socket);
-  socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetNextHop (), aodvDbscan_PORT));
+  AggregateReply (socket, toOrigin.GetNextHop (), rrepHeader, toOrigin.GetHop ());
 
   // Generating gratuitous RREPs
   if (gratRep)
@@ -1632,64 +2253,162 @@ RoutingProtocol::SendReplyByIntermediateNode (RoutingTableEntry & toDst, Routing
                                                  /*lifetime=*/ toOrigin.GetLifeTime (), 
                                                  /*txerrors=*/toOrigin.GetTxErrorCount(), /*freeSpace=*/toOrigin.GetFreeSpace(),
                                                  /*positionX*/ toOrigin.GetPositionX(), /*positiony=*/toOrigin.GetPositionY());
-      Ptr<Packet> packetToDst = Create<Packet> ();
-      SocketIpTtlTag gratTag;
-      gratTag.SetTtl (toDst.GetHop ());
-      packetToDst->AddPacketTag (gratTag);
-      packetToDst->AddHeader (gratRepHeader);
-      TypeHeader type (aodvDbscanTYPE_RREP);
-      packetToDst->AddHeader (type);
+      ApplyCompactEncoding (gratRepHeader);
+      if (m_compactEncoding && !toOrigin.HasPosition ())
+        {
+          gratRepHeader.OmitFields (RrepHeader::POSITION);
+        }
       Ptr<Socket> socket = FindSocketWithInterfaceAddress (toDst.GetInterface ());
       NS_ASSERT (socket);
-      NS_LOG_LOGIC ("Send gratuitous RREP " << packet->GetUid ());
-      socket->SendTo (packetToDst, 0, InetSocketAddress (toDst.GetNextHop (), aodvDbscan_PORT));
+      NS_LOG_LOGIC ("Send gratuitous RREP to " << toDst.GetDestination ());
+      AggregateReply (socket, toDst.GetNextHop (), gratRepHeader, toDst.GetHop ());
     }
 }
 
 void
-RoutingProtocol::SendReplyAck (Ipv4Address neighbor)
-{
-  NS_LOG_FUNCTION (this << " to " << neighbor);
-  RrepAckHeader h;
-  TypeHeader typeHeader (aodvDbscanTYPE_RREP_ACK);
-  Ptr<Packet> packet = Create<Packet> ();
-  SocketIpTtlTag tag;
-  tag.SetTtl (1);
-  packet->AddPacketTag (tag);
-  packet->AddHeader (h);
-  packet->AddHeader (typeHeader);
-  RoutingTableEntry toNeighbor;
-  m_routingTable.LookupRoute (neighbor, toNeighbor);
-  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toNeighbor.GetInterface ());
-  NS_ASSERT (socket);
-  socket->SendTo (packet, 0, InetSocketAddress (neighbor, aodvDbscan_PORT));
-}
-
-void
-RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sender)
+RoutingProtocol::AggregateReply (Ptr<Socket> socket, Ipv4Address nextHop, RrepHeader const & rrepHeader, uint8_t ttl)
 {
-  NS_LOG_FUNCTION (this << " src " << sender);
-  RrepHeader rrepHeader;
-  p->RemoveHeader (rrepHeader);
-  Ipv4Address dst = rrepHeader.GetDst ();
-  NS_LOG_LOGIC ("RREP destination " << dst << " RREP origin " << rrepHeader.GetOrigin ());
-
-  uint8_t hop = rrepHeader.GetHopCount () + 1;
-  rrepHeader.SetHopCount (hop);
-
-  if(m_lastKnownPosition.find(rrepHeader.GetDst()) != m_lastKnownPosition.end())
+  NS_LOG_FUNCTION (this << nextHop << rrepHeader.GetDst () << rrepHeader.GetOrigin ());
+  AggregatedReplies & held = m_aggregatedReplies[nextHop];
+  if (held.m_replies.empty ())
+    {
+      held.m_socket = socket;
+      held.m_ttl = 0;
+    }
+  else if (held.m_socket != socket)
+    {
+      // The next hop is now reached through another interface
+      SendAggregatedReplies (nextHop);
+      AggregateReply (socket, nextHop, rrepHeader, ttl);
+      return;
+    }
+  held.m_ttl = std::max (held.m_ttl, ttl);
+  bool duplicate = false;
+  for (std::vector<RrepHeader>::iterator i = held.m_replies.begin (); i != held.m_replies.end (); ++i)
+    {
+      if (i->GetDst () == rrepHeader.GetDst () && i->GetDstSeqno () == rrepHeader.GetDstSeqno ()
+          && i->GetOrigin () == rrepHeader.GetOrigin ())
+        {
+          NS_LOG_LOGIC ("RREP to " << rrepHeader.GetOrigin () << " for " << rrepHeader.GetDst () << " already held");
+          if (rrepHeader.GetHopCount () < i->GetHopCount ())
+            {
+              *i = rrepHeader;
+            }
+          duplicate = true;
+          break;
+        }
+    }
+  if (!duplicate)
+    {
+      held.m_replies.push_back (rrepHeader);
+    }
+  if (m_replyAggregationWindow.IsZero ())
+    {
+      SendAggregatedReplies (nextHop);
+    }
+  else if (!held.m_timer.IsRunning ())
+    {
+      held.m_timer = Simulator::Schedule (m_replyAggregationWindow, &RoutingProtocol::SendAggregatedReplies, this, nextHop);
+    }
+}
+
+void
+RoutingProtocol::SendAggregatedReplies (Ipv4Address nextHop)
+{
+  std::map<Ipv4Address, AggregatedReplies>::iterator i = m_aggregatedReplies.find (nextHop);
+  if (i == m_aggregatedReplies.end ())
+    {
+      return;
+    }
+  AggregatedReplies held = i->second;
+  m_aggregatedReplies.erase (i);
+  held.m_timer.Cancel ();
+  if (held.m_replies.empty ())
+    {
+      return;
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag tag;
+  tag.SetTtl (held.m_ttl);
+  packet->AddPacketTag (tag);
+  // The first RREP goes outermost
+  for (std::vector<RrepHeader>::reverse_iterator j = held.m_replies.rbegin (); j != held.m_replies.rend (); ++j)
+    {
+      packet->AddHeader (*j);
+      if (j + 1 == held.m_replies.rend ())
+        {
+          // Only the outermost message carries our state
+          AddTypeHeader (packet, aodvDbscanTYPE_RREP);
+        }
+      else
+        {
+          packet->AddHeader (TypeHeader (aodvDbscanTYPE_RREP));
+        }
+    }
+  NS_LOG_DEBUG ("Send " << held.m_replies.size () << " RREPs to " << nextHop << " in one packet");
+  SendControl (held.m_socket, packet, nextHop);
+}
+
+void
+RoutingProtocol::SendReplyAck (Ipv4Address neighbor)
+{
+  NS_LOG_FUNCTION (this << " to " << neighbor);
+  RrepAckHeader h;
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag tag;
+  tag.SetTtl (1);
+  packet->AddPacketTag (tag);
+  packet->AddHeader (h);
+  AddTypeHeader (packet, aodvDbscanTYPE_RREP_ACK);
+  RoutingTableEntry toNeighbor;
+  m_routingTable.LookupRoute (neighbor, toNeighbor);
+  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toNeighbor.GetInterface ());
+  NS_ASSERT (socket);
+  SendControl (socket, packet, neighbor);
+}
+
+uint32_t
+RoutingProtocol::RecvReply (Ptr<const Packet> p, Ipv4Address receiver, Ipv4Address sender)
+{
+  NS_LOG_FUNCTION (this << " src " << sender);
+  RrepHeader rrepHeader;
+  rrepHeader.SetCompactOrigin (m_compactOriginX, m_compactOriginY, m_compactResolution);
+  // Only peek: a forwarded RREP is built from the received bytes, see below
+  uint32_t size = p->PeekHeader (rrepHeader);
+  Ipv4Address dst = rrepHeader.GetDst ();
+  NS_LOG_LOGIC ("RREP destination " << dst << " RREP origin " << rrepHeader.GetOrigin ());
+
+  uint8_t hop = rrepHeader.GetHopCount () + 1;
+  rrepHeader.SetHopCount (hop);
+
+  // A compact hello leaves the position out when unchanged. Without a timestamp, only a
+  // position heard from the destination itself is known to be fresh, a relayed one may be
+  // as old as the route it came with.
+  Time sampled = rrepHeader.HasMotion () ? rrepHeader.GetTimestamp () : Simulator::Now ();
+  bool fresh = rrepHeader.HasMotion () || sender == dst;
+  if (rrepHeader.HasField (RrepHeader::POSITION) && fresh)
   {
-    m_lastKnownPosition[rrepHeader.GetDst()] = rrepHeader.GetPosition();
+    m_locationCache.SetPosition (rrepHeader.GetDst(), rrepHeader.GetPosition(), sampled);
   }
-  else 
+  if (rrepHeader.HasMotion ())
   {
-    m_lastKnownPosition[rrepHeader.GetDst()] = rrepHeader.GetPosition();
+    m_locationCache.SetVelocity (rrepHeader.GetDst(), rrepHeader.GetVelocity ().first, rrepHeader.GetVelocity ().second, sampled);
+  }
+  else if (rrepHeader.HasField (RrepHeader::POSITION) && fresh)
+  {
+    // A position sent without motion cannot be extrapolated
+    m_locationCache.ClearVelocity (rrepHeader.GetDst());
+  }
+  else if (dst == rrepHeader.GetOrigin ())
+  {
+    // A compact hello without position tells the neighbor has not moved
+    m_locationCache.Refresh (dst, sampled);
   }
   // If RREP is Hello message
   if (dst == rrepHeader.GetOrigin ())
     {
       ProcessHello (rrepHeader, receiver);
-      return;
+      return size;
     }
 
   /*
@@ -1705,10 +2424,15 @@ RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sen
   Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (receiver));
   RoutingTableEntry newEntry (/*device=*/ dev, /*dst=*/ dst, /*validSeqNo=*/ true, /*seqno=*/ rrepHeader.GetDstSeqno (),
                                           /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0),/*hop=*/ hop,
-                                          /*nextHop=*/ sender, /*lifeTime=*/ rrepHeader.GetLifeTime (), 
-                                          /*txError=*/rrepHeader.GetTxErrorCount(), /*positionX=*/rrepHeader.GetPosition().first, /*positionY=*/rrepHeader.GetPosition().second);
+                                          /*nextHop=*/ sender, /*lifeTime=*/ rrepHeader.GetLifeTime ());
   RoutingTableEntry toDst;
-  if (m_routingTable.LookupRoute (dst, toDst))
+  bool known = m_routingTable.LookupRoute (dst, toDst);
+  if (known)
+    {
+      newEntry.CopyAdvertisedState (toDst);
+    }
+  ApplyAdvertisedState (rrepHeader, newEntry);
+  if (known)
     {
       /*
        * The existing entry is updated only in the following circumstances:
@@ -1731,13 +2455,29 @@ RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sen
             {
               m_routingTable.Update (newEntry);
             }
-          // (iv)  the sequence numbers are the same, and the New Hop Count is smaller than the hop count in route table entry.
-          else if ((rrepHeader.GetDstSeqno () == toDst.GetSeqNo ()) && (hop < toDst.GetHop ()))
+          // (iv)  the sequence numbers are the same, and the New Hop Count is smaller than the hop count in route table entry,
+          // or as small but the first hop is a link of lower ETX.
+          else if ((rrepHeader.GetDstSeqno () == toDst.GetSeqNo ())
+                   && (hop < toDst.GetHop ()
+                       || (hop == toDst.GetHop () && m_enableLinkQuality && sender != toDst.GetNextHop ()
+                           && m_nb.GetEtx (sender) < m_nb.GetEtx (toDst.GetNextHop ()))))
             {
+              if (m_multipath && toDst.GetFlag () == VALID && toDst.GetInterface () == newEntry.GetInterface ())
+                {
+                  // The replaced path and its alternates become alternates of the shorter one
+                  newEntry.AdoptAlternates (toDst);
+                }
               m_routingTable.Update (newEntry);
             }
-          
-          
+          // (v) the sequence numbers are the same and the path is not shorter: keep it as an alternate,
+          // unless it could loop, see RoutingTableEntry::AddAlternate
+          else if (m_multipath && (rrepHeader.GetDstSeqno () == toDst.GetSeqNo ()) && toDst.GetFlag () == VALID
+                   && toDst.GetInterface () == newEntry.GetInterface ()
+                   && toDst.AddAlternate (sender, hop, rrepHeader.GetLifeTime ()))
+            {
+              NS_LOG_LOGIC ("Alternate next hop " << sender << " to " << dst << ", " << hop << " hops");
+              m_routingTable.Update (toDst);
+            }
         }
     }
   else
@@ -1746,6 +2486,12 @@ RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sen
       NS_LOG_LOGIC ("add new route");
       m_routingTable.AddRoute (newEntry);
     }
+  // toDst is still the entry before the update, it tells below whether a discovery was on
+  RoutingTableEntry found;
+  if (m_routingTable.LookupValidRoute (dst, found))
+    {
+      CancelRequestFanOuts (dst);
+    }
   // Acknowledge receipt of the RREP by sending a RREP-ACK message back
   if (rrepHeader.GetAckRequired ())
     {
@@ -1761,16 +2507,17 @@ RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sen
           m_addressReqTimer[dst].Cancel ();
           m_addressReqTimer.erase (dst);
         }
+      FinishLocalRepair (dst);
       m_routingTable.LookupRoute (dst, toDst);
       //std::cout << "SendPacketFromQueue: " << sender << "\n";
       SendPacketFromQueue (dst, toDst.GetRoute ());
-      return;
+      return size;
     }
 
   RoutingTableEntry toOrigin;
   if (!m_routingTable.LookupRoute (rrepHeader.GetOrigin (), toOrigin) || toOrigin.GetFlag () == IN_SEARCH)
     {
-      return; // Impossible! drop.
+      return size; // Impossible! drop.
     }
   toOrigin.SetLifeTime (std::max (m_activeRouteTimeout, toOrigin.GetLifeTime ()));
   m_routingTable.Update (toOrigin);
@@ -1795,24 +2542,23 @@ RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sen
       m_routingTable.Update (toNextHopToOrigin);
     }
   SocketIpTtlTag tag;
-  p->RemovePacketTag (tag);
+  p->PeekPacketTag (tag);
   if (tag.GetTtl () < 2)
     {
       NS_LOG_DEBUG ("TTL exceeded. Drop RREP destination " << dst << " origin " << rrepHeader.GetOrigin ());
-      return;
+      return size;
     }
 
   
-  Ptr<Packet> packet = Create<Packet> ();
+  Ptr<Packet> packet = rrepHeader.CreateForwarded (p);
   SocketIpTtlTag ttl;
   ttl.SetTtl (tag.GetTtl () - 1);
   packet->AddPacketTag (ttl);
-  packet->AddHeader (rrepHeader);
-  TypeHeader tHeader (aodvDbscanTYPE_RREP);
-  packet->AddHeader (tHeader);
+  AddTypeHeader (packet, aodvDbscanTYPE_RREP);
   Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
   NS_ASSERT (socket);
-  socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetNextHop (), aodvDbscan_PORT));
+  SendControl (socket, packet, toOrigin.GetNextHop ());
+  return size;
 }
 
 void
@@ -1828,6 +2574,27 @@ RoutingProtocol::RecvReplyAck (Ipv4Address neighbor)
     }
 }
 
+void
+RoutingProtocol::ProcessNeighborState (NeighborStateHeader const & stateHeader, Ipv4Address sender)
+{
+  NS_LOG_FUNCTION (this << "from " << sender << " " << stateHeader);
+  // The message did what a hello would have: show the neighbor is alive and what its state is
+  if (m_enableHello)
+    {
+      m_nb.Update (sender, Time (m_allowedHelloLoss * m_helloInterval));
+    }
+  RoutingTableEntry toNeighbor;
+  if (m_routingTable.LookupRoute (sender, toNeighbor))
+    {
+      toNeighbor.SetTxErrorCount (stateHeader.GetTxErrorCount ());
+      toNeighbor.SetFreeSpace (stateHeader.GetFreeSpace ());
+      toNeighbor.SetPosition (stateHeader.GetPosition ().first, stateHeader.GetPosition ().second);
+      m_routingTable.Update (toNeighbor);
+    }
+  // Keeps the velocity, which is then extrapolated from the fresh position
+  m_locationCache.SetPosition (sender, stateHeader.GetPosition (), Simulator::Now ());
+}
+
 void
 RoutingProtocol::ProcessHello (RrepHeader const & rrepHeader, Ipv4Address receiver )
 {
@@ -1842,20 +2609,46 @@ RoutingProtocol::ProcessHello (RrepHeader const & rrepHeader, Ipv4Address receiv
    */
 
   
+  if (m_compactEncoding && !m_nb.IsNeighbor (rrepHeader.GetDst ()))
+    {
+      // The new neighbor knows nothing we could leave out, send all fields next time
+      m_hellosSinceRefresh = 0;
+    }
+  // An adaptive neighbor may announce its next hello later than our own interval
+  Time helloLifetime = std::max (Time (m_allowedHelloLoss * m_helloInterval), rrepHeader.GetLifeTime ());
+  if (m_enableHello)
+    {
+      m_nb.Update (rrepHeader.GetDst (), helloLifetime);
+    }
+  double etx = 1;
+  if (m_enableHello && rrepHeader.HasLinkQuality ())
+    {
+      // The hello lifetime covers AllowedHelloLoss intervals of the sender
+      Time interval = m_allowedHelloLoss ? Seconds (rrepHeader.GetLifeTime ().GetSeconds () / m_allowedHelloLoss) : m_helloInterval;
+      m_nb.RecordHello (rrepHeader.GetDst (), rrepHeader.GetHelloSeqNo (), interval);
+      uint8_t ratio;
+      if (rrepHeader.LookupLinkQuality (receiver, ratio))
+        {
+          m_nb.SetForwardDeliveryRatio (rrepHeader.GetDst (), ratio / 255.0);
+        }
+      etx = m_nb.GetEtx (rrepHeader.GetDst ());
+      NS_LOG_LOGIC ("ETX of link to " << rrepHeader.GetDst () << " is " << etx);
+    }
+
   RoutingTableEntry toNeighbor;
   if (!m_routingTable.LookupRoute (rrepHeader.GetDst (), toNeighbor))
     {
       Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (receiver));
       RoutingTableEntry newEntry (/*device=*/ dev, /*dst=*/ rrepHeader.GetDst (), /*validSeqNo=*/ true, /*seqno=*/ rrepHeader.GetDstSeqno (),
                                               /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0),
-                                              /*hop=*/ 1, /*nextHop=*/ rrepHeader.GetDst (), /*lifeTime=*/ rrepHeader.GetLifeTime (), 
-                                              /*txError=*/rrepHeader.GetTxErrorCount(), /*positionX=*/rrepHeader.GetPosition().first, 
-                                              /*positiony=*/rrepHeader.GetPosition().second, /*freespace*/rrepHeader.GetFreeSpace());
+                                              /*hop=*/ 1, /*nextHop=*/ rrepHeader.GetDst (), /*lifeTime=*/ rrepHeader.GetLifeTime ());
+      ApplyAdvertisedState (rrepHeader, newEntry);
+      newEntry.SetLinkEtx (etx);
       m_routingTable.AddRoute (newEntry);
     }
   else
     {
-      toNeighbor.SetLifeTime (std::max (Time (m_allowedHelloLoss * m_helloInterval), toNeighbor.GetLifeTime ()));
+      toNeighbor.SetLifeTime (std::max (helloLifetime, toNeighbor.GetLifeTime ()));
       toNeighbor.SetSeqNo (rrepHeader.GetDstSeqno ());
       toNeighbor.SetValidSeqNo (true);
       toNeighbor.SetFlag (VALID);
@@ -1863,16 +2656,10 @@ RoutingProtocol::ProcessHello (RrepHeader const & rrepHeader, Ipv4Address receiv
       toNeighbor.SetInterface (m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0));
       toNeighbor.SetHop (1);
       toNeighbor.SetNextHop (rrepHeader.GetDst ());
-      toNeighbor.SetTxErrorCount(rrepHeader.GetTxErrorCount());
-      toNeighbor.SetFreeSpace(rrepHeader.GetFreeSpace());
-      toNeighbor.SetPositionX(rrepHeader.GetPosition().first);
-      toNeighbor.SetPositionY(rrepHeader.GetPosition().second);
+      ApplyAdvertisedState (rrepHeader, toNeighbor);
+      toNeighbor.SetLinkEtx (etx);
       m_routingTable.Update (toNeighbor);
     }
-  if (m_enableHello)
-    {
-      m_nb.Update (rrepHeader.GetDst (), Time (m_allowedHelloLoss * m_helloInterval));
-    }
 }
 
 void
@@ -1903,13 +2690,12 @@ RoutingProtocol::RecvError (Ptr<Packet> p, Ipv4Address src )
     {
       if (!rerrHeader.AddUnDestination (i->first, i->second))
         {
-          TypeHeader typeHeader (aodvDbscanTYPE_RERR);
           Ptr<Packet> packet = Create<Packet> ();
           SocketIpTtlTag tag;
           tag.SetTtl (1);
           packet->AddPacketTag (tag);
           packet->AddHeader (rerrHeader);
-          packet->AddHeader (typeHeader);
+          AddTypeHeader (packet, aodvDbscanTYPE_RERR);
           SendRerrMessage (packet, precursors);
           rerrHeader.Clear ();
         }
@@ -1923,13 +2709,12 @@ RoutingProtocol::RecvError (Ptr<Packet> p, Ipv4Address src )
     }
   if (rerrHeader.GetDestCount () != 0)
     {
-      TypeHeader typeHeader (aodvDbscanTYPE_RERR);
       Ptr<Packet> packet = Create<Packet> ();
       SocketIpTtlTag tag;
       tag.SetTtl (1);
       packet->AddPacketTag (tag);
       packet->AddHeader (rerrHeader);
-      packet->AddHeader (typeHeader);
+      AddTypeHeader (packet, aodvDbscanTYPE_RERR);
       SendRerrMessage (packet, precursors);
     }
   m_routingTable.InvalidateRoutesWithDst (unreachable);
@@ -1942,6 +2727,40 @@ RoutingProtocol::ClusterTimerExpire(Ipv4Address dst)
   {
     m_lastKnonwCluster.erase(dst);
   }
+  // Forget the fan-outs to dst that have completed
+  FanOutMap::iterator i = m_rreqFanOuts.lower_bound (std::make_pair (dst, uint32_t (0)));
+  while (i != m_rreqFanOuts.end () && i->first.first == dst)
+    {
+      if (i->second.empty () || i->second.back ().IsExpired ())
+        {
+          m_rreqFanOuts.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+void
+RoutingProtocol::CancelRequestFanOuts (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  FanOutMap::iterator i = m_rreqFanOuts.lower_bound (std::make_pair (dst, uint32_t (0)));
+  while (i != m_rreqFanOuts.end () && i->first.first == dst)
+    {
+      uint32_t cancelled = 0;
+      for (std::vector<EventId>::iterator j = i->second.begin (); j != i->second.end (); ++j)
+        {
+          if (j->IsRunning ())
+            {
+              j->Cancel ();
+              ++cancelled;
+            }
+        }
+      NS_LOG_LOGIC ("Route to " << dst << " found, " << cancelled << " unicasts of RREQ " << i->first.second << " cancelled");
+      m_rreqFanOuts.erase (i++);
+    }
 }
 void
 RoutingProtocol::RouteRequestTimerExpire (Ipv4Address dst)
@@ -1987,6 +2806,8 @@ void
 RoutingProtocol::HelloTimerExpire ()
 {
   NS_LOG_FUNCTION (this);
+  // Chosen before the hello goes out, the hello advertises a lifetime for it
+  Time interval = NextHelloInterval ();
   Time offset = Time (Seconds (0));
   if (m_lastBcastTime > Time (Seconds (0)))
     {
@@ -1998,17 +2819,80 @@ RoutingProtocol::HelloTimerExpire ()
       SendHello ();
     }
   m_htimer.Cancel ();
-  Time diff = m_helloInterval - offset;
+  Time diff = interval - offset;
   m_htimer.Schedule (std::max (Time (Seconds (0)), diff));
   m_lastBcastTime = Time (Seconds (0));
 }
 
+Time
+RoutingProtocol::NextHelloInterval ()
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t changes = m_nb.GetLinkChanges () - m_lastLinkChanges;
+  m_lastLinkChanges = m_nb.GetLinkChanges ();
+  double churn = double (changes) / std::max<uint32_t> (1, m_nb.GetNeighborCount ());
+  m_neighborChurnTrace (churn);
+  if (!m_adaptiveHello)
+    {
+      m_nextHelloIntervalTrace (m_helloInterval);
+      return m_helloInterval;
+    }
+
+  double interval = m_currentHelloInterval.GetSeconds ();
+  if (churn > m_helloChurnThreshold)
+    {
+      // Links come and go, refresh the neighborhood quickly
+      interval /= 2;
+    }
+  else
+    {
+      // Stable neighborhood, back off gradually
+      interval *= 1.25;
+    }
+  Vector velocity = m_ipv4->GetObject<Node> ()->GetObject<MobilityModel> ()->GetVelocity ();
+  double speed = std::sqrt (velocity.x * velocity.x + velocity.y * velocity.y);
+  if (speed > 0)
+    {
+      // Neighbors should not see us further than HelloMaxDisplacement from the last advertised position
+      interval = std::min (interval, m_helloMaxDisplacement / speed);
+    }
+  m_currentHelloInterval = std::max (m_minHelloInterval, std::min (m_maxHelloInterval, Seconds (interval)));
+  NS_LOG_LOGIC ("Churn " << churn << " speed " << speed << ", next hello in " << m_currentHelloInterval.As (Time::S));
+  m_nextHelloIntervalTrace (m_currentHelloInterval);
+  return m_currentHelloInterval;
+}
+
 void
 RoutingProtocol::RreqRateLimitTimerExpire ()
 {
   NS_LOG_FUNCTION (this);
   m_rreqCount = 0;
   m_rreqRateLimitTimer.Schedule (Seconds (1));
+  // Forget the destinations back to a full bucket with nothing pending
+  for (std::map<Ipv4Address, Discovery>::iterator i = m_discoveries.begin (); i != m_discoveries.end (); )
+    {
+      if (!i->second.m_pending.IsRunning () && Simulator::Now () - i->second.m_started >= m_discoveryCoalescingWindow
+          && RefillRequestTokens (i->second).IsZero () && i->second.m_tokens >= m_destinationRreqBurst)
+        {
+          m_discoveries.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+  // Background RREQs older than PathDiscoveryTime no longer hold back the next one
+  for (std::map<Ipv4Address, Time>::iterator i = m_preemptiveRequests.begin (); i != m_preemptiveRequests.end (); )
+    {
+      if (Simulator::Now () - i->second >= m_pathDiscoveryTime)
+        {
+          m_preemptiveRequests.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
 }
 
 void
@@ -2038,6 +2922,25 @@ RoutingProtocol::SendHello ()
    */
 
   m_position = m_ipv4->GetObject<Node>()->GetObject<MobilityModel> ()->GetPosition();
+  m_helloSeqNo++;
+  uint32_t freeSpace = m_queue.GetFreeQueueLen ();
+  std::pair<uint32_t, uint32_t> position ((uint32_t) m_position.x, (uint32_t) m_position.y);
+  uint8_t unchanged = 0;
+  if (m_compactEncoding && m_hellosSinceRefresh != 0)
+    {
+      unchanged |= (m_txerrorCount == m_lastHelloTxError) ? RrepHeader::TX_ERROR_COUNT : 0;
+      unchanged |= (freeSpace == m_lastHelloFreeSpace) ? RrepHeader::FREE_SPACE : 0;
+      unchanged |= (position == m_lastHelloPosition) ? RrepHeader::POSITION : 0;
+    }
+  m_hellosSinceRefresh = (m_hellosSinceRefresh + 1) % m_compactRefreshInterval;
+  m_lastHelloTxError = m_txerrorCount;
+  m_lastHelloFreeSpace = freeSpace;
+  m_lastHelloPosition = position;
+  std::vector<std::pair<Ipv4Address, double> > ratios;
+  if (m_enableLinkQuality)
+    {
+      m_nb.GetReverseDeliveryRatios (ratios);
+    }
     
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
     {
@@ -2045,8 +2948,26 @@ RoutingProtocol::SendHello ()
       Ipv4InterfaceAddress iface = j->second;
       
       RrepHeader helloHeader (/*prefix size=*/ 0, /*hops=*/ 0, /*dst=*/ iface.GetLocal (), /*dst seqno=*/ m_seqNo,
-                                               /*origin=*/ iface.GetLocal (),/*lifetime=*/ Time (m_allowedHelloLoss * m_helloInterval),
-                                               /*txError=*/ m_txerrorCount, /*freespace=*/ m_queue.GetFreeQueueLen(), /*positionx=*/ (uint32_t)m_position.x, /*positiony*/(uint32_t) m_position.y);
+                                               /*origin=*/ iface.GetLocal (),/*lifetime=*/ Time (m_allowedHelloLoss * m_currentHelloInterval),
+                                               /*txError=*/ m_txerrorCount, /*freespace=*/ freeSpace, /*positionx=*/ position.first, /*positiony*/ position.second);
+      ApplyCompactEncoding (helloHeader);
+      ApplyMotion (helloHeader);
+      ApplyResidualEnergy (helloHeader);
+      if (unchanged)
+        {
+          helloHeader.OmitFields (unchanged);
+        }
+      if (m_enableLinkQuality)
+        {
+          helloHeader.SetHelloSeqNo (m_helloSeqNo);
+          for (std::vector<std::pair<Ipv4Address, double> >::const_iterator k = ratios.begin (); k != ratios.end (); ++k)
+            {
+              if (!helloHeader.AddLinkQuality (k->first, uint8_t (k->second * 255 + 0.5)))
+                {
+                  break;
+                }
+            }
+        }
       Ptr<Packet> packet = Create<Packet> ();
       SocketIpTtlTag tag;
       tag.SetTtl (1);
@@ -2069,6 +2990,269 @@ RoutingProtocol::SendHello ()
     }
 }
 
+void
+RoutingProtocol::ApplyCompactEncoding (RrepHeader & rrepHeader) const
+{
+  if (m_compactEncoding)
+    {
+      rrepHeader.SetCompact (true);
+      rrepHeader.SetCompactOrigin (m_compactOriginX, m_compactOriginY, m_compactResolution);
+    }
+}
+
+void
+RoutingProtocol::ApplyAdvertisedState (RrepHeader const & rrepHeader, RoutingTableEntry & entry) const
+{
+  // A compact RREP leaves out the fields unchanged since the previous one
+  if (rrepHeader.HasField (RrepHeader::TX_ERROR_COUNT))
+    {
+      entry.SetTxErrorCount (rrepHeader.GetTxErrorCount ());
+    }
+  if (rrepHeader.HasField (RrepHeader::FREE_SPACE))
+    {
+      entry.SetFreeSpace (rrepHeader.GetFreeSpace ());
+    }
+  if (rrepHeader.HasField (RrepHeader::POSITION))
+    {
+      entry.SetPosition (rrepHeader.GetPosition ().first, rrepHeader.GetPosition ().second);
+    }
+  if (rrepHeader.HasResidualEnergy ())
+    {
+      entry.SetResidualEnergy (rrepHeader.GetResidualEnergy ());
+    }
+}
+
+void
+RoutingProtocol::ApplyMotion (RrepHeader & rrepHeader) const
+{
+  if (m_enableMotion)
+    {
+      Vector velocity = m_ipv4->GetObject<Node> ()->GetObject<MobilityModel> ()->GetVelocity ();
+      rrepHeader.SetMotion (velocity.x, velocity.y, Simulator::Now ());
+    }
+}
+
+void
+RoutingProtocol::ApplyResidualEnergy (RrepHeader & rrepHeader) const
+{
+  if (!m_energyAware)
+    {
+      return;
+    }
+  Ptr<energy::EnergySourceContainer> sources = m_ipv4->GetObject<Node> ()->GetObject<energy::EnergySourceContainer> ();
+  if (sources && sources->GetN () > 0)
+    {
+      rrepHeader.SetResidualEnergy (sources->Get (0)->GetEnergyFraction ());
+    }
+}
+
+std::vector<Ipv4Address>
+RoutingProtocol::SelectGreedyForwarders (LocationCache::Position const & posDst)
+{
+  if (m_greedyFallbackNeighbors == 0)
+    {
+      return std::vector<Ipv4Address> ();
+    }
+  m_position = m_ipv4->GetObject<Node> ()->GetObject<MobilityModel> ()->GetPosition ();
+  double dx = posDst.first - m_position.x;
+  double dy = posDst.second - m_position.y;
+  std::vector<Ipv4Address> forwarders = m_routingTable.GreedyNeighbors (posDst.first, posDst.second,
+                                                                        std::sqrt (dx * dx + dy * dy),
+                                                                        m_greedyFallbackNeighbors);
+  NS_LOG_LOGIC ("No cluster, " << forwarders.size () << " greedy forwarders");
+  return forwarders;
+}
+
+bool
+RoutingProtocol::StartLocalRepair (Ipv4Address dst, Ipv4Address brokenHop)
+{
+  NS_LOG_FUNCTION (this << dst << brokenHop);
+  // LOCAL_ADD_TTL of RFC 3561
+  const uint16_t localAddTtl = 2;
+  RoutingTableEntry toDst;
+  if (!m_routingTable.LookupRoute (dst, toDst) || toDst.GetFlag () != VALID
+      || toDst.GetHop () + localAddTtl > m_maxRepairTtl || !m_locationCache.IsKnown (dst))
+    {
+      return false;
+    }
+  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toDst.GetInterface ());
+  if (!socket)
+    {
+      return false;
+    }
+  LocationCache::Position posDst;
+  m_locationCache.Lookup (dst, posDst);
+  double epsilon = m_epsilon * (2 - m_locationCache.GetConfidence (dst));
+  std::vector<Ipv4Address> cluster = m_routingTable.DBSCAN (dst, posDst.first, posDst.second, epsilon, m_minPts);
+  if (cluster.empty ())
+    {
+      cluster = SelectGreedyForwarders (posDst);
+    }
+  cluster.erase (std::remove (cluster.begin (), cluster.end (), brokenHop), cluster.end ());
+  if (cluster.empty ())
+    {
+      NS_LOG_LOGIC ("No cluster toward " << dst << ", route not repaired");
+      return false;
+    }
+  if (!TakeRequestToken (dst))
+    {
+      NS_LOG_LOGIC ("RREQ rate reached, route to " << dst << " not repaired");
+      return false;
+    }
+
+  uint16_t ttl = toDst.GetHop () + localAddTtl;
+  RreqHeader rreqHeader;
+  rreqHeader.SetDst (dst);
+  // The repaired route must be fresher than the broken one
+  rreqHeader.SetDstSeqno (toDst.GetSeqNo () + 1);
+  if (m_gratuitousReply)
+    {
+      rreqHeader.SetGratuitousRrep (true);
+    }
+  if (m_destinationOnly)
+    {
+      rreqHeader.SetDestinationOnly (true);
+    }
+  m_seqNo++;
+  rreqHeader.SetOriginSeqno (m_seqNo);
+  m_requestId++;
+  rreqHeader.SetId (m_requestId);
+  rreqHeader.SetOrigin (toDst.GetInterface ().GetLocal ());
+  m_rreqIdCache.IsDuplicate (toDst.GetInterface ().GetLocal (), m_requestId);
+
+  Time repairTime = 2 * m_nodeTraversalTime * (ttl + m_timeoutBuffer);
+  LocalRepair & repair = m_localRepairs[dst];
+  repair.m_timer.Cancel ();
+  repair.m_hops = toDst.GetHop ();
+  repair.m_seqNo = toDst.GetSeqNo ();
+  toDst.GetPrecursors (repair.m_precursors);
+  repair.m_timer = Simulator::Schedule (repairTime, &RoutingProtocol::LocalRepairTimerExpire, this, dst);
+  toDst.SetFlag (IN_SEARCH);
+  toDst.SetLifeTime (repairTime);
+  m_routingTable.Update (toDst);
+  NS_LOG_DEBUG ("Repair route to " << dst << " with RREQ " << rreqHeader.GetId () << ", ttl " << ttl
+                << ", " << cluster.size () << " forwarders");
+
+  if (m_multiTargetRreq)
+    {
+      SendRequestToCluster (socket, toDst.GetInterface (), rreqHeader, ttl, cluster);
+      return true;
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag tag;
+  tag.SetTtl (ttl);
+  packet->AddPacketTag (tag);
+  packet->AddHeader (rreqHeader);
+  AddTypeHeader (packet, aodvDbscanTYPE_RREQ);
+  int interval = m_uniformRandomVariable->GetInteger (0, 10);
+  std::vector<EventId> & fanOut = m_rreqFanOuts[std::make_pair (dst, rreqHeader.GetId ())];
+  for (uint32_t i = 0; i < cluster.size (); i++)
+    {
+      fanOut.push_back (Simulator::Schedule (MilliSeconds ((i + 1) * interval), &RoutingProtocol::SendControl,
+                                             this, socket, packet, cluster[i]));
+    }
+  m_lastBcastTime = Simulator::Now () + MilliSeconds (cluster.size () * interval);
+  Simulator::Schedule (Seconds (1), &RoutingProtocol::ClusterTimerExpire, this, dst);
+  return true;
+}
+
+void
+RoutingProtocol::FinishLocalRepair (Ipv4Address dst)
+{
+  std::map<Ipv4Address, LocalRepair>::iterator i = m_localRepairs.find (dst);
+  RoutingTableEntry toDst;
+  if (i == m_localRepairs.end () || !m_routingTable.LookupValidRoute (dst, toDst))
+    {
+      return;
+    }
+  i->second.m_timer.Cancel ();
+  for (std::vector<Ipv4Address>::const_iterator j = i->second.m_precursors.begin ();
+       j != i->second.m_precursors.end (); ++j)
+    {
+      toDst.InsertPrecursor (*j);
+    }
+  m_routingTable.Update (toDst);
+  NS_LOG_DEBUG ("Route to " << dst << " repaired, " << (uint32_t) toDst.GetHop () << " hops instead of "
+                << i->second.m_hops);
+  SendRepairedPackets (i->second, toDst.GetRoute ());
+  if (toDst.GetHop () > i->second.m_hops && !i->second.m_precursors.empty ())
+    {
+      // The route is usable but longer, the sources may look for a better one
+      RerrHeader rerrHeader;
+      rerrHeader.SetNoDelete (true);
+      rerrHeader.AddUnDestination (dst, toDst.GetSeqNo ());
+      Ptr<Packet> packet = Create<Packet> ();
+      SocketIpTtlTag tag;
+      tag.SetTtl (1);
+      packet->AddPacketTag (tag);
+      packet->AddHeader (rerrHeader);
+      AddTypeHeader (packet, aodvDbscanTYPE_RERR);
+      SendRerrMessage (packet, i->second.m_precursors);
+    }
+  m_localRepairs.erase (i);
+}
+
+void
+RoutingProtocol::LocalRepairTimerExpire (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  std::map<Ipv4Address, LocalRepair>::iterator i = m_localRepairs.find (dst);
+  if (i == m_localRepairs.end ())
+    {
+      return;
+    }
+  LocalRepair repair = i->second;
+  m_localRepairs.erase (i);
+  RoutingTableEntry toDst;
+  if (m_routingTable.LookupValidRoute (dst, toDst))
+    {
+      SendRepairedPackets (repair, toDst.GetRoute ());
+      SendPacketFromQueue (dst, toDst.GetRoute ());
+      return;
+    }
+  NS_LOG_DEBUG ("Repair of the route to " << dst << " failed. Drop buffered packets and send RERR.");
+  for (std::vector<QueueEntry>::const_iterator j = repair.m_packets.begin (); j != repair.m_packets.end (); ++j)
+    {
+      j->GetErrorCallback () (j->GetPacket (), j->GetIpv4Header (), Socket::ERROR_NOROUTETOHOST);
+    }
+  m_queue.DropPacketWithDst (dst);
+  if (m_routingTable.LookupRoute (dst, toDst))
+    {
+      toDst.Invalidate (m_routingTable.GetBadLinkLifetime ());
+      m_routingTable.Update (toDst);
+    }
+  if (!repair.m_precursors.empty ())
+    {
+      RerrHeader rerrHeader;
+      rerrHeader.AddUnDestination (dst, repair.m_seqNo);
+      Ptr<Packet> packet = Create<Packet> ();
+      SocketIpTtlTag tag;
+      tag.SetTtl (1);
+      packet->AddPacketTag (tag);
+      packet->AddHeader (rerrHeader);
+      AddTypeHeader (packet, aodvDbscanTYPE_RERR);
+      SendRerrMessage (packet, repair.m_precursors);
+    }
+}
+
+void
+RoutingProtocol::SendRepairedPackets (LocalRepair & repair, Ptr<Ipv4Route> route)
+{
+  NS_LOG_FUNCTION (this << route->GetDestination ());
+  for (std::vector<QueueEntry>::const_iterator i = repair.m_packets.begin (); i != repair.m_packets.end (); ++i)
+    {
+      if (i->GetExpireTime () < Seconds (0))
+        {
+          NS_LOG_LOGIC ("Packet " << i->GetPacket ()->GetUid () << " held too long during the repair, dropped");
+          i->GetErrorCallback () (i->GetPacket (), i->GetIpv4Header (), Socket::ERROR_NOROUTETOHOST);
+          continue;
+        }
+      // Forwarded as it would have been without the break, from its own source
+      i->GetUnicastForwardCallback () (route, i->GetPacket (), i->GetIpv4Header ());
+    }
+  repair.m_packets.clear ();
+}
+
 void
 RoutingProtocol::SendPacketFromQueue (Ipv4Address dst, Ptr<Ipv4Route> route)
 {
@@ -2129,22 +3313,42 @@ RoutingProtocol::SendRerrWhenBreaksLinkToNextHop (Ipv4Address nextHop)
     {
       return;
     }
+  if (m_multipath)
+    {
+      // Routes with an alternate next hop survive the break, only the rest is reported
+      uint32_t switched = m_routingTable.SwitchToAlternates (nextHop);
+      NS_LOG_LOGIC (switched << " routes through " << nextHop << " moved to alternate next hops");
+    }
   toNextHop.GetPrecursors (precursors);
   rerrHeader.AddUnDestination (nextHop, toNextHop.GetSeqNo ());
   m_routingTable.GetListOfDestinationWithNextHop (nextHop, unreachable);
+  if (m_localRepair)
+    {
+      // Routes under repair are only reported if the repair fails
+      for (std::map<Ipv4Address, uint32_t>::iterator i = unreachable.begin (); i != unreachable.end (); )
+        {
+          if (i->first != nextHop && StartLocalRepair (i->first, nextHop))
+            {
+              unreachable.erase (i++);
+            }
+          else
+            {
+              ++i;
+            }
+        }
+    }
   for (std::map<Ipv4Address, uint32_t>::const_iterator i = unreachable.begin (); i
        != unreachable.end (); )
     {
       if (!rerrHeader.AddUnDestination (i->first, i->second))
         {
           NS_LOG_LOGIC ("Send RERR message with maximum size.");
-          TypeHeader typeHeader (aodvDbscanTYPE_RERR);
           Ptr<Packet> packet = Create<Packet> ();
           SocketIpTtlTag tag;
           tag.SetTtl (1);
           packet->AddPacketTag (tag);
           packet->AddHeader (rerrHeader);
-          packet->AddHeader (typeHeader);
+          AddTypeHeader (packet, aodvDbscanTYPE_RERR);
           SendRerrMessage (packet, precursors);
           rerrHeader.Clear ();
         }
@@ -2158,13 +3362,12 @@ RoutingProtocol::SendRerrWhenBreaksLinkToNextHop (Ipv4Address nextHop)
     }
   if (rerrHeader.GetDestCount () != 0)
     {
-      TypeHeader typeHeader (aodvDbscanTYPE_RERR);
       Ptr<Packet> packet = Create<Packet> ();
       SocketIpTtlTag tag;
       tag.SetTtl (1);
       packet->AddPacketTag (tag);
       packet->AddHeader (rerrHeader);
-      packet->AddHeader (typeHeader);
+      AddTypeHeader (packet, aodvDbscanTYPE_RERR);
       SendRerrMessage (packet, precursors);
     }
   unreachable.insert (std::make_pair (nextHop, toNextHop.GetSeqNo ()));
@@ -2195,14 +3398,14 @@ RoutingProtocol::SendRerrWhenNoRouteToForward (Ipv4Address dst,
   tag.SetTtl (1);
   packet->AddPacketTag (tag);
   packet->AddHeader (rerrHeader);
-  packet->AddHeader (TypeHeader (aodvDbscanTYPE_RERR));
+  AddTypeHeader (packet, aodvDbscanTYPE_RERR);
   if (m_routingTable.LookupValidRoute (origin, toOrigin))
     {
       Ptr<Socket> socket = FindSocketWithInterfaceAddress (
           toOrigin.GetInterface ());
       NS_ASSERT (socket);
       NS_LOG_LOGIC ("Unicast RERR to the source of the data transmission");
-      socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetNextHop (), aodvDbscan_PORT));
+      SendControl (socket, packet, toOrigin.GetNextHop ());
     }
   else
     {
@@ -2223,7 +3426,7 @@ RoutingProtocol::SendRerrWhenNoRouteToForward (Ipv4Address dst,
             {
               destination = iface.GetBroadcast ();
             }
-          socket->SendTo (packet->Copy (), 0, InetSocketAddress (destination, aodvDbscan_PORT));
+          SendControl (socket, packet, destination);
         }
     }
 }
@@ -2258,7 +3461,7 @@ RoutingProtocol::SendRerrMessage (Ptr<Packet> packet, std::vector<Ipv4Address> p
           Ptr<Socket> socket = FindSocketWithInterfaceAddress (toPrecursor.GetInterface ());
           NS_ASSERT (socket);
           NS_LOG_LOGIC ("one precursor => unicast RERR to " << toPrecursor.GetDestination () << " from " << toPrecursor.GetInterface ().GetLocal ());
-          Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, precursors.front ());
+          Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, packet, precursors.front ());
           m_rerrCount++;
         }
       return;
@@ -2293,7 +3496,7 @@ RoutingProtocol::SendRerrMessage (Ptr<Packet> packet, std::vector<Ipv4Address> p
         {
           destination = i->GetBroadcast ();
         }
-      Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, p, destination);
+      Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendControl, this, socket, p, destination);
     }
 }
 
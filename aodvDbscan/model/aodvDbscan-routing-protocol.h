@@ -33,6 +33,7 @@
 #include "aodvDbscan-packet.h"
 #include "aodvDbscan-neighbor.h"
 #include "aodvDbscan-dpd.h"
+#include "aodvDbscan-location-cache.h"
 #include "ns3/node.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/output-stream-wrapper.h"
@@ -40,6 +41,8 @@
 #include "ns3/ipv4-interface.h"
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/mobility-module.h"
+#include "ns3/traced-callback.h"
+#include "ns3/event-id.h"
 #include <map>
 #include "ns3/wifi-mac-queue.h" 
 namespace ns3 {
@@ -56,6 +59,26 @@ namespace aodvDbscan {
 class RoutingProtocol : public Ipv4RoutingProtocol
 {
 public:
+  /**
+   * TracedCallback signature for hello interval changes.
+   *
+   * \param [in] interval The time until the next hello.
+   */
+  typedef void (* NextHelloIntervalTracedCallback)(Time interval);
+  /**
+   * TracedCallback signature for neighbor churn measurements.
+   *
+   * \param [in] churn Links opened or closed per neighbor since the last hello.
+   */
+  typedef void (* NeighborChurnTracedCallback)(double churn);
+  /**
+   * TracedCallback signature for control packets handed to the socket.
+   *
+   * \param [in] packet The control packet, starting with its TypeHeader.
+   * \param [in] destination The neighbor or broadcast address it is sent to.
+   */
+  typedef void (* TxControlTracedCallback)(Ptr<const Packet> packet, Ipv4Address destination);
+
   /**
    * \brief Get the type ID.
    * \return the object TypeId
@@ -159,6 +182,23 @@ public:
   {
     return m_enableHello;
   }
+  /**
+   * Set the link quality window
+   * \param window the number of hellos the delivery ratio is measured over
+   */
+  void SetLinkQualityWindow (uint16_t window)
+  {
+    m_linkQualityWindow = window;
+    m_nb.SetLinkQualityWindow (window);
+  }
+  /**
+   * Get the link quality window
+   * \returns the number of hellos the delivery ratio is measured over
+   */
+  uint16_t GetLinkQualityWindow () const
+  {
+    return m_linkQualityWindow;
+  }
   /**
    * Set broadcast enable flag
    * \param f enable broadcast flag
@@ -189,6 +229,8 @@ public:
 protected:
   virtual void DoInitialize (void);
 private:
+  /// Test fixture driving the internals of a node directly
+  friend class RoutingProtocolFixture;
   /**
    * Notify that an MPDU was dropped.
    *
@@ -196,6 +238,18 @@ private:
    * \param mpdu the dropped MPDU
    */
   void NotifyTxError (WifiMacDropReason reason, Ptr<const WifiMpdu> mpdu);
+  /**
+   * Learn the MAC address of a neighbor from a received aodvDbscan control frame.
+   *
+   * \param device the receiving device
+   * \param packet the received IPv4 packet
+   * \param protocol the L3 protocol number
+   * \param from the sender MAC address
+   * \param to the receiver MAC address
+   * \param packetType the packet type
+   */
+  void NotifyRxFrame (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                      const Address &from, const Address &to, NetDevice::PacketType packetType);
 
   // Protocol parameters.
   uint32_t m_rreqRetries;             ///< Maximum number of retransmissions of RREQ with TTL = NetDiameter to discover a route
@@ -232,8 +286,47 @@ private:
   Time m_maxQueueTime;                 ///< The maximum period of time that a routing protocol is allowed to buffer a packet for.
   bool m_destinationOnly;              ///< Indicates only the destination may respond to this RREQ.
   bool m_gratuitousReply;              ///< Indicates whether a gratuitous RREP should be unicast to the node originated route discovery.
+  uint32_t m_macCacheCapacity;         ///< Maximum number of cached neighbor IP to MAC mappings
   bool m_enableHello;                  ///< Indicates whether a hello messages enable
   bool m_enableBroadcast;              ///< Indicates whether a a broadcast data packets forwarding enable
+  bool m_enableLinkQuality;            ///< Indicates whether hellos carry delivery ratios for ETX estimation
+  uint16_t m_linkQualityWindow;        ///< Number of hellos the delivery ratio is measured over
+  bool m_enableDpdBloomFilter;         ///< Indicates whether broadcast duplicates are detected with Bloom filters
+  uint32_t m_dpdBloomCapacity;         ///< Expected number of broadcast packets seen within PathDiscoveryTime
+  double m_dpdFalsePositiveRate;       ///< Target false positive rate of the broadcast duplicate detection
+  bool m_compactEncoding;              ///< Indicates whether RREPs and hellos use the compact encoding
+  uint32_t m_compactOriginX;           ///< x of the origin compact positions are quantized against
+  uint32_t m_compactOriginY;           ///< y of the origin compact positions are quantized against
+  double m_compactResolution;          ///< Distance of one compact position quantization step
+  uint32_t m_compactRefreshInterval;   ///< Every how many hellos all fields are sent
+  bool m_enableMotion;                 ///< Indicates whether RREPs and hellos carry velocity and timestamp
+  bool m_multiTargetRreq;              ///< Indicates whether a RREQ reaches its cluster as one broadcast listing the forwarders
+  Time m_maxExtrapolation;             ///< Longest time a position is dead reckoned forward
+  bool m_enablePiggyback;              ///< Indicates whether control messages carry our neighbor state
+  uint32_t m_locationCacheCapacity;    ///< Maximum number of nodes whose position is remembered
+  Time m_locationMaxAge;               ///< Age after which a position is no longer used for cluster selection
+  Time m_locationHalfLife;             ///< Age at which the confidence in a position has halved
+  double m_epsilon;                    ///< DBSCAN neighborhood radius for a fresh destination position
+  uint32_t m_minPts;                   ///< DBSCAN minimum number of neighbors of a core point
+  uint32_t m_greedyFallbackNeighbors;  ///< Number of neighbors making the most progress a RREQ goes to without a cluster
+  bool m_multipath;                    ///< Indicates whether alternate next hops are kept and used on link breaks
+  bool m_localRepair;                  ///< Indicates whether the upstream node of a broken link repairs the routes through it
+  uint16_t m_maxRepairTtl;             ///< Largest TTL of a local repair RREQ, longer routes are reported broken
+  bool m_predictiveRediscovery;        ///< Indicates whether routes are rediscovered before their next hop link is predicted to break
+  double m_linkRange;                  ///< Distance in meters at which a link is predicted to break
+  Time m_preemptiveMargin;             ///< How long before the predicted break of a link the rediscovery starts
+  double m_destinationRreqRate;        ///< RREQs per second one destination may be sent in the long run
+  uint32_t m_destinationRreqBurst;     ///< RREQs one destination may be sent back to back
+  Time m_discoveryCoalescingWindow;    ///< Shortest time between two discoveries of the same destination
+  bool m_distanceTtl;                  ///< Indicates whether the first RREQ TTL follows the distance to a known destination
+  Time m_replyAggregationWindow;       ///< How long an intermediate node holds RREPs to merge those to the same next hop
+  bool m_energyAware;                  ///< Indicates whether hellos carry the residual energy and clusters favor it
+  double m_energyWeight;               ///< Weight of the residual energy among the clustering features
+  bool m_adaptiveHello;                ///< Indicates whether the hello interval follows mobility and neighbor churn
+  Time m_minHelloInterval;             ///< Shortest adaptive hello interval
+  Time m_maxHelloInterval;             ///< Longest adaptive hello interval
+  double m_helloMaxDisplacement;       ///< Distance the node may move between two adaptive hellos
+  double m_helloChurnThreshold;        ///< Links changed per neighbor and interval above which hellos speed up
   //\}
 
   /// IP protocol
@@ -263,6 +356,16 @@ private:
   uint16_t m_rreqCount;
   /// Number of RERRs used for RERR rate control
   uint16_t m_rerrCount;
+  /// Sequence number of the last hello sent
+  uint16_t m_helloSeqNo;
+  /// Hellos sent since the last one carrying all fields
+  uint32_t m_hellosSinceRefresh;
+  /// TX error count advertised in the last hello
+  uint32_t m_lastHelloTxError;
+  /// Free space advertised in the last hello
+  uint32_t m_lastHelloFreeSpace;
+  /// Position advertised in the last hello
+  std::pair<uint32_t, uint32_t> m_lastHelloPosition;
 
   /// interaction count with ip addresses
   std::map<Ipv4Address, uint32_t> m_interactionCount;
@@ -270,8 +373,8 @@ private:
   uint32_t m_txerrorCount;
   /// my position
   Vector m_position;
-  /// last known position of nodes
-  std::map<Ipv4Address, std::pair<uint32_t, uint32_t> > m_lastKnownPosition;
+  /// last known position and velocity of nodes
+  LocationCache m_locationCache;
   /// last known cluster
   std::map<Ipv4Address, std::vector<Ipv4Address>> m_lastKnonwCluster;
   
@@ -348,6 +451,13 @@ private:
    * \param receiverIfaceAddr receiver interface IP address
    */
   void ProcessHello (RrepHeader const & rrepHeader, Ipv4Address receiverIfaceAddr);
+  /**
+   * Process the neighbor state piggybacked on a control message
+   *
+   * \param stateHeader the piggybacked state
+   * \param sender the neighbor which transmitted the message
+   */
+  void ProcessNeighborState (NeighborStateHeader const & stateHeader, Ipv4Address sender);
   /**
    * Create loopback route for given header
    *
@@ -370,14 +480,15 @@ private:
    * \param receiver receiver address
    * \param src sender address
    */
-  void RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address src);
+  void RecvRequest (Ptr<const Packet> p, Ipv4Address receiver, Ipv4Address src);
   /**
    * Receive RREP
-   * \param p packet
+   * \param p packet starting with the RREP, aggregated RREPs may follow it
    * \param my destination address
    * \param src sender address
+   * \returns the size of the RREP, where the next aggregated RREP starts
    */
-  void RecvReply (Ptr<Packet> p, Ipv4Address my, Ipv4Address src);
+  uint32_t RecvReply (Ptr<const Packet> p, Ipv4Address my, Ipv4Address src);
   /**
    * Receive RREP_ACK
    * \param neighbor neighbor address
@@ -399,12 +510,126 @@ private:
    * \param route route to use
    */
   void SendPacketFromQueue (Ipv4Address dst, Ptr<Ipv4Route> route);
+  /**
+   * Send a RREQ from every interface, to the cluster near the destination's known position
+   * or as a broadcast
+   * \param dst the destination
+   * \param rreqHeader the RREQ, completed with the origin of each interface
+   * \param ttl the TTL of the RREQ
+   * \param exclude a neighbor left out of the cluster, if any
+   */
+  void TransmitRequest (Ipv4Address dst, RreqHeader rreqHeader, uint16_t ttl, Ipv4Address exclude = Ipv4Address ());
+  /**
+   * Start a background RREQ if the link to the next hop of a route is predicted to break soon.
+   * The route stays in use until a fresher one is found.
+   * \param dst the destination of the route
+   * \param nextHop the next hop of the route
+   */
+  void CheckLinkLifetime (Ipv4Address dst, Ipv4Address nextHop);
+  /// Time of the last background RREQ per destination, forgotten after PathDiscoveryTime
+  std::map<Ipv4Address, Time> m_preemptiveRequests;
+  /**
+   * Broadcast a RREQ once, listing the selected cluster as its forwarders
+   * \param socket the socket to send on
+   * \param iface the interface of the socket
+   * \param rreqHeader RREQ message header
+   * \param ttl the TTL of the RREQ
+   * \param cluster the selected forwarders
+   */
+  void SendRequestToCluster (Ptr<Socket> socket, Ipv4InterfaceAddress const & iface, RreqHeader rreqHeader,
+                             uint8_t ttl, std::vector<Ipv4Address> const & cluster);
   /// Send hello
   void SendHello ();
+  /**
+   * Switch a RREP to the compact encoding, if enabled
+   * \param rrepHeader RREP message header
+   */
+  void ApplyCompactEncoding (RrepHeader & rrepHeader) const;
+  /**
+   * Copy the state a RREP advertises about its destination into a route, field by field
+   * \param rrepHeader RREP message header
+   * \param entry the route to the destination of the RREP
+   */
+  void ApplyAdvertisedState (RrepHeader const & rrepHeader, RoutingTableEntry & entry) const;
+  /**
+   * Add our velocity and the current time to a RREP carrying our position, if enabled
+   * \param rrepHeader RREP message header
+   */
+  void ApplyMotion (RrepHeader & rrepHeader) const;
+  /**
+   * Add the residual energy of the node's energy source to a hello, if enabled
+   * \param rrepHeader RREP message header
+   */
+  void ApplyResidualEnergy (RrepHeader & rrepHeader) const;
+  /**
+   * Select the neighbors making the most geographic progress toward a destination,
+   * used when DBSCAN finds no cluster
+   * \param posDst the estimated position of the destination
+   * \returns the forwarders, empty if no neighbor is closer to the destination than this node
+   */
+  std::vector<Ipv4Address> SelectGreedyForwarders (LocationCache::Position const & posDst);
+  /**
+   * Repair a route broken by the loss of its next hop with a TTL-limited RREQ sent only to
+   * the cluster near the destination's last known position
+   * \param dst the destination of the broken route
+   * \param brokenHop the next hop that was lost
+   * \returns false if the route cannot be repaired locally and must be reported broken
+   */
+  bool StartLocalRepair (Ipv4Address dst, Ipv4Address brokenHop);
+  /**
+   * Restore the precursors of a locally repaired route and tell them if the route got longer
+   * \param dst the destination a new route was found to
+   */
+  void FinishLocalRepair (Ipv4Address dst);
+  /**
+   * Report a route that could not be repaired in time and drop the packets buffered for it
+   * \param dst the destination of the broken route
+   */
+  void LocalRepairTimerExpire (Ipv4Address dst);
   /** Send RREQ
    * \param dst destination address
    */
   void SendRequest (Ipv4Address dst);
+  /**
+   * Start a route discovery for a packet waiting in the queue, unless one was started
+   * within the coalescing window, in which case a single discovery follows the window
+   * \param dst destination address
+   */
+  void RequestDiscovery (Ipv4Address dst);
+  /**
+   * Estimate the hops to a destination from its known position and the distance one hop covers
+   * \param dst destination address
+   * \returns the TTL of the first RREQ of a discovery
+   */
+  uint16_t InitialTtl (Ipv4Address dst);
+  /// RREQ rate control and coalescing of one destination
+  struct Discovery
+  {
+    double m_tokens;    ///< RREQs the destination may still be sent right away
+    Time m_refilled;    ///< when m_tokens was last refilled
+    Time m_started;     ///< when the last RREQ was sent
+    EventId m_pending;  ///< RREQ deferred by rate control or coalescing
+  };
+  /// Discovery state per destination
+  std::map<Ipv4Address, Discovery> m_discoveries;
+  /**
+   * \param dst destination address
+   * \returns the discovery state of the destination, created with a full bucket if needed
+   */
+  Discovery & GetDiscovery (Ipv4Address dst);
+  /**
+   * Refill the token bucket of a destination
+   * \param discovery the discovery state of the destination
+   * \returns the time until the destination may be sent a RREQ
+   */
+  Time RefillRequestTokens (Discovery & discovery);
+  /**
+   * Take a RREQ from the bucket of a destination and from the node wide rate limit, for a
+   * RREQ that is sent right away or not at all
+   * \param dst destination address
+   * \returns false if either rate is reached
+   */
+  bool TakeRequestToken (Ipv4Address dst);
   /** Send RREP
    * \param rreqHeader route request header
    * \param toOrigin routing table entry to originator
@@ -420,6 +645,31 @@ private:
    * \param neighbor neighbor address
    */
   void SendReplyAck (Ipv4Address neighbor);
+  /**
+   * Hold a RREP generated by this intermediate node for the aggregation window. The RREPs
+   * held for one next hop leave in a single packet, a RREP for the same destination,
+   * sequence number and origin as a held one replaces it only if shorter.
+   * \param socket the socket to send on
+   * \param nextHop the next hop toward the origin of the RREP
+   * \param rrepHeader the RREP
+   * \param ttl the TTL the RREP needs
+   */
+  void AggregateReply (Ptr<Socket> socket, Ipv4Address nextHop, RrepHeader const & rrepHeader, uint8_t ttl);
+  /**
+   * Send the RREPs held for a next hop
+   * \param nextHop the next hop
+   */
+  void SendAggregatedReplies (Ipv4Address nextHop);
+  /// RREPs held for one next hop
+  struct AggregatedReplies
+  {
+    Ptr<Socket> m_socket;               ///< the socket to send on
+    uint8_t m_ttl;                      ///< largest TTL the RREPs need
+    std::vector<RrepHeader> m_replies;  ///< the RREPs, in arrival order
+    EventId m_timer;                    ///< ends the aggregation window
+  };
+  /// RREPs held per next hop
+  std::map<Ipv4Address, AggregatedReplies> m_aggregatedReplies;
   /** Initiate RERR
    * \param nextHop next hop address
    */
@@ -445,6 +695,20 @@ private:
    * \param destination - destination node IP address
    */
   void SendTo (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
+  /**
+   * Send a control message to destination socket. With piggybacking, any
+   * control message defers the next hello, unicast ones included.
+   * \param socket - destination node socket
+   * \param packet - packet to send, built with AddTypeHeader
+   * \param destination - destination node IP address
+   */
+  void SendControl (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
+  /**
+   * Add the TypeHeader of a control message, preceded by our neighbor state if piggybacking is enabled
+   * \param packet the message, its header already added
+   * \param type the message type
+   */
+  void AddTypeHeader (Ptr<Packet> packet, MessageType type);
 
   /**
    * Select next forwarder of message
@@ -459,6 +723,21 @@ private:
   Timer m_htimer;
   /// Schedule next send of hello message
   void HelloTimerExpire ();
+  /**
+   * Measure neighbor churn since the last hello and choose the next hello interval
+   * \returns the time until the next hello
+   */
+  Time NextHelloInterval ();
+  /// Hello interval currently in use
+  Time m_currentHelloInterval;
+  /// Neighbor link changes seen at the last hello
+  uint32_t m_lastLinkChanges;
+  /// Trace of the chosen hello intervals
+  TracedCallback<Time> m_nextHelloIntervalTrace;
+  /// Trace of the neighbor churn, in links changed per neighbor, measured every hello interval
+  TracedCallback<double> m_neighborChurnTrace;
+  /// Trace of every control packet sent, hellos included
+  TracedCallback<Ptr<const Packet>, Ipv4Address> m_txControlTrace;
   /// RREQ rate limit timer
   Timer m_rreqRateLimitTimer;
   /// Reset RREQ count and schedule RREQ rate limit timer with delay 1 sec.
@@ -471,6 +750,34 @@ private:
   std::map<Ipv4Address, Timer> m_addressReqTimer;
   /// clear cluster
   void ClusterTimerExpire(Ipv4Address dst);
+  /// Destination and RREQ ID of a cluster fan-out
+  typedef std::pair<Ipv4Address, uint32_t> FanOutKey;
+  /// Staggered RREQ unicasts of each cluster fan-out
+  typedef std::map<FanOutKey, std::vector<EventId> > FanOutMap;
+  /// Pending and recent cluster fan-outs
+  FanOutMap m_rreqFanOuts;
+  /**
+   * Cancel the RREQ unicasts to a destination's cluster that have not been sent yet
+   * \param dst the destination a valid route was found to
+   */
+  void CancelRequestFanOuts (Ipv4Address dst);
+  /// A route under local repair
+  struct LocalRepair
+  {
+    EventId m_timer;                        ///< ends the repair
+    uint16_t m_hops;                        ///< hop count of the broken route
+    uint32_t m_seqNo;                       ///< destination sequence number of the broken route
+    std::vector<Ipv4Address> m_precursors;  ///< precursors of the broken route
+    std::vector<QueueEntry> m_packets;      ///< packets in transit held until the route is repaired
+  };
+  /// Routes under local repair, by destination
+  std::map<Ipv4Address, LocalRepair> m_localRepairs;
+  /**
+   * Forward the packets held during a local repair with their IP header as received
+   * \param repair the repair that held them
+   * \param route the repaired route
+   */
+  void SendRepairedPackets (LocalRepair & repair, Ptr<Ipv4Route> route);
   /**
    * Handle route discovery process
    * \param dst the destination IP address
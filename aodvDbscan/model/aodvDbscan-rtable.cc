@@ -61,7 +61,11 @@ RoutingTableEntry::RoutingTableEntry (Ptr<NetDevice> dev, Ipv4Address dst, bool
     m_txerrorCount(txError),
     m_positionX(positionX),
     m_positionY(positionY),
-    m_freeSpace(freeSpace)
+    m_positionKnown (false),
+    m_freeSpace(freeSpace),
+    m_linkEtx (1),
+    m_residualEnergy (1),
+    m_advertisedHops (hops)
 {
   m_ipv4Route = Create<Ipv4Route> ();
   m_ipv4Route->SetDestination (dst);
@@ -74,6 +78,17 @@ RoutingTableEntry::~RoutingTableEntry ()
 {
 }
 
+void
+RoutingTableEntry::CopyAdvertisedState (RoutingTableEntry const & other)
+{
+  m_txerrorCount = other.m_txerrorCount;
+  m_freeSpace = other.m_freeSpace;
+  m_positionX = other.m_positionX;
+  m_positionY = other.m_positionY;
+  m_positionKnown = other.m_positionKnown;
+  m_residualEnergy = other.m_residualEnergy;
+}
+
 bool
 RoutingTableEntry::InsertPrecursor (Ipv4Address id)
 {
@@ -165,6 +180,104 @@ RoutingTableEntry::GetPrecursors (std::vector<Ipv4Address> & prec) const
     }
 }
 
+bool
+RoutingTableEntry::AddAlternate (Ipv4Address nextHop, uint16_t hop, Time lifetime)
+{
+  NS_LOG_FUNCTION (this << nextHop << hop);
+  if (nextHop == GetNextHop ())
+    {
+      return false;
+    }
+  if (hop > m_advertisedHops || LookupPrecursor (nextHop))
+    {
+      NS_LOG_LOGIC ("Alternate through " << nextHop << " could form a loop");
+      return false;
+    }
+  Alternate alternate = { nextHop, hop, lifetime + Simulator::Now () };
+  std::vector<Alternate>::iterator worst = m_alternates.end ();
+  for (std::vector<Alternate>::iterator i = m_alternates.begin (); i != m_alternates.end (); ++i)
+    {
+      if (i->m_nextHop == nextHop)
+        {
+          *i = alternate;
+          return true;
+        }
+      if (worst == m_alternates.end () || i->m_hops > worst->m_hops)
+        {
+          worst = i;
+        }
+    }
+  if (m_alternates.size () < MaxAlternates)
+    {
+      m_alternates.push_back (alternate);
+      return true;
+    }
+  if (hop < worst->m_hops)
+    {
+      *worst = alternate;
+      return true;
+    }
+  return false;
+}
+
+void
+RoutingTableEntry::AdoptAlternates (RoutingTableEntry const & other)
+{
+  m_advertisedHops = std::max (m_advertisedHops, other.m_advertisedHops);
+  AddAlternate (other.GetNextHop (), other.GetHop (), other.GetLifeTime ());
+  for (std::vector<Alternate>::const_iterator i = other.m_alternates.begin (); i != other.m_alternates.end (); ++i)
+    {
+      AddAlternate (i->m_nextHop, i->m_hops, i->m_expire - Simulator::Now ());
+    }
+}
+
+bool
+RoutingTableEntry::DeleteAlternate (Ipv4Address nextHop)
+{
+  for (std::vector<Alternate>::iterator i = m_alternates.begin (); i != m_alternates.end (); ++i)
+    {
+      if (i->m_nextHop == nextHop)
+        {
+          m_alternates.erase (i);
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+RoutingTableEntry::GetAlternateNextHops (std::vector<Ipv4Address> & nextHops) const
+{
+  for (std::vector<Alternate>::const_iterator i = m_alternates.begin (); i != m_alternates.end (); ++i)
+    {
+      nextHops.push_back (i->m_nextHop);
+    }
+}
+
+bool
+RoutingTableEntry::SwitchToAlternate ()
+{
+  NS_LOG_FUNCTION (this);
+  std::vector<Alternate>::iterator best = m_alternates.end ();
+  for (std::vector<Alternate>::iterator i = m_alternates.begin (); i != m_alternates.end (); ++i)
+    {
+      if (!(i->m_expire < Simulator::Now ()) && (best == m_alternates.end () || i->m_hops < best->m_hops))
+        {
+          best = i;
+        }
+    }
+  if (best == m_alternates.end ())
+    {
+      return false;
+    }
+  NS_LOG_LOGIC ("Route to " << GetDestination () << " switched from " << GetNextHop () << " to " << best->m_nextHop);
+  SetNextHop (best->m_nextHop);
+  m_hops = best->m_hops;
+  m_lifeTime = best->m_expire;
+  m_alternates.erase (best);
+  return true;
+}
+
 void
 RoutingTableEntry::Invalidate (Time badLinkLifetime)
 {
@@ -175,6 +288,7 @@ RoutingTableEntry::Invalidate (Time badLinkLifetime)
     }
   m_flag = INVALID;
   m_reqCount = 0;
+  m_alternates.clear ();
   m_lifeTime = badLinkLifetime + Simulator::Now ();
 }
 
@@ -227,7 +341,8 @@ RoutingTableEntry::Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit /* =
  */
 
 RoutingTable::RoutingTable (Time t)
-  : m_badLinkLifetime (t)
+  : m_badLinkLifetime (t),
+    m_energyWeight (0)
 {
 }
 
@@ -348,6 +463,42 @@ RoutingTable::GetListOfDestinationWithNextHop (Ipv4Address nextHop, std::map<Ipv
     }
 }
 
+uint32_t
+RoutingTable::SwitchToAlternates (Ipv4Address nextHop)
+{
+  NS_LOG_FUNCTION (this << nextHop);
+  Purge ();
+  uint32_t switched = 0;
+  for (std::map<Ipv4Address, RoutingTableEntry>::iterator i =
+         m_ipv4AddressEntry.begin (); i != m_ipv4AddressEntry.end (); ++i)
+    {
+      RoutingTableEntry & entry = i->second;
+      entry.DeleteAlternate (nextHop);
+      if (entry.GetNextHop () != nextHop || entry.GetFlag () != VALID || i->first == nextHop)
+        {
+          continue;
+        }
+      // Alternates through neighbors we lost meanwhile are useless, those through
+      // neighbors which became precursors since could loop
+      std::vector<Ipv4Address> alternates;
+      entry.GetAlternateNextHops (alternates);
+      for (std::vector<Ipv4Address>::const_iterator j = alternates.begin (); j != alternates.end (); ++j)
+        {
+          std::map<Ipv4Address, RoutingTableEntry>::const_iterator neighbor = m_ipv4AddressEntry.find (*j);
+          if (neighbor == m_ipv4AddressEntry.end () || neighbor->second.GetFlag () != VALID
+              || neighbor->second.GetHop () != 1 || entry.LookupPrecursor (*j))
+            {
+              entry.DeleteAlternate (*j);
+            }
+        }
+      if (entry.SwitchToAlternate ())
+        {
+          ++switched;
+        }
+    }
+  return switched;
+}
+
 void
 RoutingTable::InvalidateRoutesWithDst (const std::map<Ipv4Address, uint32_t> & unreachable)
 {
@@ -399,9 +550,12 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
 
     // --- Step 1: Build feature vector -----------------------------------------
 
+    const int DIMS = 5;
+
     struct FeaturePoint {
         Ipv4Address ip;
-        double f[3];
+        double f[DIMS];
+        double etx;
     };
 
     std::vector<FeaturePoint> points;
@@ -414,7 +568,7 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
 
         if (ip.IsBroadcast() || ip.IsLocalhost() || ip.IsMulticast() ||
             ip.IsSubnetDirectedBroadcast(Ipv4Mask("255.255.255.0")) ||
-            entry.GetFlag() == INVALID || entry.GetHop() > 2)
+            entry.GetFlag() == INVALID || entry.GetHop() > 2 || !entry.HasPosition())
         {
             continue;
         }
@@ -427,6 +581,9 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
         p.f[0] = std::sqrt(dx*dx + dy*dy);
         p.f[1] = (double)entry.GetTxErrorCount();
         p.f[2] = (double)entry.GetFreeSpace();
+        p.f[3] = entry.GetLinkEtx();
+        p.f[4] = entry.GetResidualEnergy();
+        p.etx = entry.GetLinkEtx();
 
         points.push_back(p);
     }
@@ -436,9 +593,9 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
 
     // --- Step 2: Normalize features -------------------------------------------
 
-    double minv[3], maxv[3];
+    double minv[DIMS], maxv[DIMS];
 
-    for (int d = 0; d < 3; d++)
+    for (int d = 0; d < DIMS; d++)
     {
         minv[d] = maxv[d] = points[0].f[d];
 
@@ -457,6 +614,12 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
         }
     }
 
+    // features count alike, except the residual energy which is weighted
+    double weight[DIMS] = {1.0, 1.0, 1.0, 1.0, m_energyWeight};
+    for (int i = 0; i < n; i++)
+        for (int d = 0; d < DIMS; d++)
+            points[i].f[d] *= weight[d];
+
     // --- Step 3: DBSCAN -------------------------------------------------------
 
     const int UNVISITED = -1;
@@ -467,7 +630,7 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
 
     auto dist = [&](int a, int b) {
         double s = 0.0;
-        for (int d = 0; d < 3; d++) {
+        for (int d = 0; d < DIMS; d++) {
             double diff = points[a].f[d] - points[b].f[d];
             s += diff * diff;
         }
@@ -531,7 +694,8 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
 
     // --- Step 4: Cluster Scoring ----------------------------------------------
 
-    double ideal[3] = {0.0, 0.0, 1.0};
+    // close to destination, few errors, much free space, lossless link, full battery
+    double ideal[DIMS] = {0.0, 0.0, 1.0, 0.0, m_energyWeight};
 
     std::map<int, std::vector<int>> clusterMembers;
     for (int i = 0; i < n; i++)
@@ -545,16 +709,16 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
     {
         auto &members = c.second;
 
-        double centroid[3] = {0,0,0};
+        double centroid[DIMS] = {0,0,0,0,0};
         for (int idx : members)
-            for (int d=0; d<3; d++)
+            for (int d=0; d<DIMS; d++)
                 centroid[d] += points[idx].f[d];
 
-        for (int d=0; d<3; d++)
+        for (int d=0; d<DIMS; d++)
             centroid[d] /= members.size();
 
         double score = 0.0;
-        for (int d=0; d<3; d++)
+        for (int d=0; d<DIMS; d++)
             score += (centroid[d] - ideal[d]) * (centroid[d] - ideal[d]);
 
         if (score < bestScore)
@@ -571,21 +735,81 @@ RoutingTable::DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,
 
     // --- Step 5: Output --------------------------------------------------------
 
-    std::vector<Ipv4Address> output;
+    std::vector<int> selected;
 
-    if (bestCluster >= 0)
+    if (bestCluster < 0)
     {
-        for (int idx : clusterMembers[bestCluster])
-            output.push_back(points[idx].ip);
+        // no cluster, the caller falls back to greedy forwarding
+        return {};
     }
+    selected = clusterMembers[bestCluster];
+
+    // best links first, they are unicast to first
+    std::stable_sort(selected.begin(), selected.end(), [&](int a, int b) {
+        return points[a].etx < points[b].etx;
+    });
+
+    std::vector<Ipv4Address> output;
+    for (int idx : selected)
+        output.push_back(points[idx].ip);
 
-    if (output.empty())
+    return output;
+}
+
+std::vector<Ipv4Address>
+RoutingTable::GreedyNeighbors (uint32_t positionX, uint32_t positionY, double ownDistance, uint32_t count)
+{
+  NS_LOG_FUNCTION (this << positionX << positionY << ownDistance << count);
+  Purge ();
+  std::vector<std::pair<double, Ipv4Address> > candidates;
+  for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = m_ipv4AddressEntry.begin ();
+       i != m_ipv4AddressEntry.end (); ++i)
+    {
+      RoutingTableEntry const & entry = i->second;
+      if (entry.GetFlag () != VALID || entry.GetHop () != 1 || !entry.HasPosition ()
+          || i->first.IsBroadcast () || i->first.IsLocalhost () || i->first.IsMulticast ())
+        {
+          continue;
+        }
+      double dx = (double) positionX - entry.GetPositionX ();
+      double dy = (double) positionY - entry.GetPositionY ();
+      double distance = std::sqrt (dx * dx + dy * dy);
+      if (distance < ownDistance)
+        {
+          candidates.push_back (std::make_pair (distance, i->first));
+        }
+    }
+  uint32_t selected = std::min<uint32_t> (count, candidates.size ());
+  std::partial_sort (candidates.begin (), candidates.begin () + selected, candidates.end ());
+  std::vector<Ipv4Address> output;
+  for (uint32_t i = 0; i < selected; ++i)
     {
-        for (auto &p : points)
-            output.push_back(p.ip);
+      output.push_back (candidates[i].second);
     }
+  NS_LOG_DEBUG ("Greedy: " << output.size () << " of " << candidates.size () << " neighbors make progress");
+  return output;
+}
 
-    return output;
+double
+RoutingTable::NeighborRange (uint32_t positionX, uint32_t positionY)
+{
+  NS_LOG_FUNCTION (this << positionX << positionY);
+  Purge ();
+  double range = 0;
+  for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i = m_ipv4AddressEntry.begin ();
+       i != m_ipv4AddressEntry.end (); ++i)
+    {
+      RoutingTableEntry const & entry = i->second;
+      if (entry.GetFlag () != VALID || entry.GetHop () != 1 || !entry.HasPosition ()
+          || i->first.IsBroadcast () || i->first.IsLocalhost () || i->first.IsMulticast ())
+        {
+          continue;
+        }
+      double dx = (double) positionX - entry.GetPositionX ();
+      double dy = (double) positionY - entry.GetPositionY ();
+      range = std::max (range, std::sqrt (dx * dx + dy * dy));
+    }
+  return range;
 }
 
 void
@@ -113,6 +113,70 @@ public:
   void GetPrecursors (std::vector<Ipv4Address> & prec) const;
   //\}
 
+  ///\name Alternate next hops
+  //\{
+  /// Maximum number of alternate next hops per destination
+  static const uint8_t MaxAlternates = 3;
+  /**
+   * Remember another next hop toward the destination, learned from a RREP with the
+   * destination sequence number of this entry. Next hops are kept distinct, so the
+   * alternate paths do not share their first link. When the list is full the
+   * alternate with the most hops is replaced by a shorter one.
+   *
+   * As in AOMDV, an alternate is refused when it is longer than the advertised hop
+   * count of the entry, or when it goes through a precursor, since such paths may
+   * lead back through this node.
+   * \param nextHop the neighbor the RREP came from
+   * \param hop the hop count of the path through that neighbor
+   * \param lifetime the lifetime of the path
+   * \return true if the alternate was recorded
+   */
+  bool AddAlternate (Ipv4Address nextHop, uint16_t hop, Time lifetime);
+  /**
+   * Take over the next hop and the alternates of a longer route to the same destination
+   * as alternates of this one. The longer route may already have been advertised, so its
+   * advertised hop count is kept.
+   * \param other the route being replaced by this one
+   */
+  void AdoptAlternates (RoutingTableEntry const & other);
+  /**
+   * Forget the alternate through a neighbor
+   * \param nextHop the neighbor
+   * \return true if there was such an alternate
+   */
+  bool DeleteAlternate (Ipv4Address nextHop);
+  /**
+   * Appends the next hops of the alternates to nextHops
+   * \param nextHops vector of next hop addresses
+   */
+  void GetAlternateNextHops (std::vector<Ipv4Address> & nextHops) const;
+  /**
+   * Make the shortest alternate that has not expired the next hop of this entry.
+   * The alternate is removed from the list, the former next hop is not kept.
+   * \return true if there was an alternate to switch to
+   */
+  bool SwitchToAlternate ();
+  /**
+   * \returns the number of alternate next hops
+   */
+  uint32_t GetAlternateCount () const
+  {
+    return m_alternates.size ();
+  }
+  /**
+   * \returns the largest hop count this route may have been advertised with for its sequence number
+   */
+  uint16_t GetAdvertisedHop () const
+  {
+    return m_advertisedHops;
+  }
+  /// Delete all alternates
+  void DeleteAllAlternates ()
+  {
+    m_alternates.clear ();
+  }
+  //\}
+
   /**
    * Mark entry as "down" (i.e. disable it)
    * \param badLinkLifetime duration to keep entry marked as invalid
@@ -357,6 +421,31 @@ public:
   {
     return m_positionY;
   }
+  /**
+   * Set the position the node advertised and mark it known
+   * \param positionX the x coordinate
+   * \param positionY the y coordinate
+   */
+  void SetPosition (uint32_t positionX, uint32_t positionY)
+  {
+    m_positionX = positionX;
+    m_positionY = positionY;
+    m_positionKnown = true;
+  }
+  /**
+   * Check whether the node ever advertised its position
+   * \returns false if the position fields only hold their default
+   */
+  bool HasPosition () const
+  {
+    return m_positionKnown;
+  }
+  /**
+   * Take over the state advertised by the node from another entry to it,
+   * to keep it when a message leaves fields out
+   * \param other the previous entry to the same node
+   */
+  void CopyAdvertisedState (RoutingTableEntry const & other);
   
   /**
    * Get the error count of this node
@@ -402,6 +491,42 @@ public:
   {
     m_freeSpace = count;
   }
+  /**
+   * Get the expected transmission count of the link to this neighbor
+   *
+   * \return the link ETX, 1 if not measured
+   */
+  double GetLinkEtx () const
+  {
+    return m_linkEtx;
+  }
+  /**
+   * Set the expected transmission count of the link to this neighbor
+   *
+   * \param etx the link ETX
+   */
+  void SetLinkEtx (double etx)
+  {
+    m_linkEtx = etx;
+  }
+  /**
+   * Get the residual energy of this neighbor
+   *
+   * \return the remaining fraction of its initial energy, 1 if not advertised
+   */
+  double GetResidualEnergy () const
+  {
+    return m_residualEnergy;
+  }
+  /**
+   * Set the residual energy of this neighbor
+   *
+   * \param fraction the remaining fraction of its initial energy
+   */
+  void SetResidualEnergy (double fraction)
+  {
+    m_residualEnergy = fraction;
+  }
   
 
 
@@ -465,8 +590,26 @@ private:
   // position of this node
   uint32_t m_positionX;
   uint32_t m_positionY;
+  /// Whether the position was advertised by the node
+  bool m_positionKnown;
   // empty space of this node
   uint32_t m_freeSpace;
+  /// Expected transmission count of the link, measured from hello loss
+  double m_linkEtx;
+  /// Remaining fraction of the initial energy, advertised in hellos
+  double m_residualEnergy;
+
+  /// An alternate path to the destination
+  struct Alternate
+  {
+    Ipv4Address m_nextHop; ///< first hop of the path
+    uint16_t m_hops;       ///< hop count of the path
+    Time m_expire;         ///< expiration time of the path
+  };
+  /// Alternate paths, with next hops distinct from each other and from the current one
+  std::vector<Alternate> m_alternates;
+  /// Hop count the route may have been advertised with, alternates must not be longer
+  uint16_t m_advertisedHops;
 };
 
 /**
@@ -501,6 +644,22 @@ public:
   {
     m_badLinkLifetime = t;
   }
+  /**
+   * Set the weight of the residual energy among the DBSCAN features
+   *
+   * \param weight the weight, 0 to ignore the residual energy
+   */
+  void SetEnergyWeight (double weight)
+  {
+    m_energyWeight = weight;
+  }
+  /**
+   * \return the weight of the residual energy among the DBSCAN features
+   */
+  double GetEnergyWeight () const
+  {
+    return m_energyWeight;
+  }
   
   
   //\}
@@ -550,6 +709,15 @@ public:
    * \param unreachable
    */
   void GetListOfDestinationWithNextHop (Ipv4Address nextHop, std::map<Ipv4Address, uint32_t> & unreachable);
+  /**
+   * Move the valid routes through a broken link to an alternate next hop, and forget
+   * the alternates through that link. Only alternates whose next hop is still a valid
+   * neighbor are used.
+   *
+   * \param nextHop the neighbor the link to which broke
+   * \returns the number of routes moved to an alternate
+   */
+  uint32_t SwitchToAlternates (Ipv4Address nextHop);
   /**
    *   Update routing entries with this destination as follows:
    *  1. The destination sequence number of this routing entry, if it
@@ -584,6 +752,22 @@ public:
    */
   void Print (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const;
   std::vector<Ipv4Address> DBSCAN (Ipv4Address dst, uint32_t positionX, uint32_t positionY,double epsilon,int minPts);
+  /**
+   * Select the neighbors making the most geographic progress toward a position
+   * \param positionX x of the position to approach
+   * \param positionY y of the position to approach
+   * \param ownDistance distance from this node to the position, only closer neighbors qualify
+   * \param count the maximum number of neighbors
+   * \returns up to count valid one hop neighbors with a known position, closest to the position first
+   */
+  std::vector<Ipv4Address> GreedyNeighbors (uint32_t positionX, uint32_t positionY, double ownDistance, uint32_t count);
+  /**
+   * Estimate the distance one hop covers from the neighbors' positions
+   * \param positionX x of this node
+   * \param positionY y of this node
+   * \returns the distance to the farthest valid one hop neighbor with a known position, 0 without such neighbors
+   */
+  double NeighborRange (uint32_t positionX, uint32_t positionY);
 
   bool isEmpty()
   {
@@ -594,6 +778,8 @@ private:
   std::map<Ipv4Address, RoutingTableEntry> m_ipv4AddressEntry;
   /// Deletion time for invalid routes
   Time m_badLinkLifetime;
+  /// Weight of the residual energy among the DBSCAN features
+  double m_energyWeight;
   
   /**
    * const version of Purge, for use by Print() method
@@ -27,8 +27,15 @@
  */
 #include "ns3/aodvDbscan-id-cache.h"
 #include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/system-wall-clock-ms.h"
+#include <algorithm>
+#include <vector>
 
 namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("aodvDbscanIdCacheTestSuite");
+
 namespace aodvDbscan {
 
 /**
@@ -105,6 +112,141 @@ IdCacheTest::CheckTimeout3 ()
   NS_TEST_EXPECT_MSG_EQ (cache.GetSize (), 0, "All records expire");
 }
 
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Benchmark of the id cache against the former linear implementation
+ *
+ * Replays a RREQ flood: every 10 ms a burst of RREQs arrives from a set of
+ * originators, most of them copies already seen from other neighbors. The flood
+ * is replayed once through each cache, timing the whole replay; both caches have
+ * to agree on every answer.
+ */
+class IdCacheBenchmark : public TestCase
+{
+public:
+  IdCacheBenchmark () : TestCase ("Id Cache benchmark"),
+                        cache (Seconds (2.8))
+  {
+  }
+  virtual void DoRun ();
+
+private:
+  /// Vector backed cache scanning all entries on every check
+  struct LinearIdCache
+  {
+    /// Seen entry
+    struct UniqueId
+    {
+      Ipv4Address m_context; ///< originator
+      uint32_t m_id;         ///< RREQ ID
+      Time m_expire;         ///< expiration time
+    };
+    /// Expired entry predicate
+    struct IsExpired
+    {
+      /**
+       * \param u the entry
+       * \returns true if expired
+       */
+      bool operator() (const UniqueId & u) const
+      {
+        return (u.m_expire < Simulator::Now ());
+      }
+    };
+    /**
+     * \param addr the originator
+     * \param id the RREQ ID
+     * \returns true if the pair was seen
+     */
+    bool IsDuplicate (Ipv4Address addr, uint32_t id)
+    {
+      m_ids.erase (std::remove_if (m_ids.begin (), m_ids.end (), IsExpired ()), m_ids.end ());
+      for (std::vector<UniqueId>::const_iterator i = m_ids.begin (); i != m_ids.end (); ++i)
+        {
+          if (i->m_context == addr && i->m_id == id)
+            {
+              return true;
+            }
+        }
+      UniqueId uniqueId = { addr, id, m_lifetime + Simulator::Now () };
+      m_ids.push_back (uniqueId);
+      return false;
+    }
+    std::vector<UniqueId> m_ids; ///< seen entries
+    Time m_lifetime;             ///< entry lifetime
+  };
+  /**
+   * Deliver a burst of RREQs to one of the caches
+   * \param burst the burst number
+   * \param reference whether to use the reference cache
+   */
+  void Burst (uint32_t burst, bool reference);
+  /**
+   * Replay the whole flood through one of the caches
+   * \param reference whether to use the reference cache
+   * \returns the wall clock time of the replay in ms
+   */
+  int64_t Replay (bool reference);
+
+  /// ID cache under test
+  IdCache cache;
+  /// Reference cache
+  LinearIdCache m_reference;
+  /// Answers of the ID cache and of the reference cache, in order
+  std::vector<bool> m_answers[2];
+  /// Number of bursts
+  static const uint32_t Bursts = 500;
+  /// RREQs per burst
+  static const uint32_t BurstSize = 40;
+  /// Number of originators
+  static const uint32_t Originators = 50;
+};
+
+void
+IdCacheBenchmark::Burst (uint32_t burst, bool reference)
+{
+  for (uint32_t i = 0; i < BurstSize; ++i)
+    {
+      // Every RREQ is heard from four neighbors
+      uint32_t rreq = burst * BurstSize / 4 + i / 4;
+      Ipv4Address origin (0x0a000001 + rreq % Originators);
+      m_answers[reference].push_back (reference ? m_reference.IsDuplicate (origin, rreq / Originators)
+                                      : cache.IsDuplicate (origin, rreq / Originators));
+    }
+}
+
+int64_t
+IdCacheBenchmark::Replay (bool reference)
+{
+  m_answers[reference].reserve (Bursts * BurstSize);
+  for (uint32_t burst = 0; burst < Bursts; ++burst)
+    {
+      Simulator::Schedule (MilliSeconds (10 * burst), &IdCacheBenchmark::Burst, this, burst, reference);
+    }
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Run ();
+  int64_t ms = clock.End ();
+  Simulator::Destroy ();
+  return ms;
+}
+
+void
+IdCacheBenchmark::DoRun ()
+{
+  m_reference.m_lifetime = cache.GetLifeTime ();
+  int64_t cacheMs = Replay (false);
+  int64_t referenceMs = Replay (true);
+
+  NS_TEST_EXPECT_MSG_EQ ((m_answers[0] == m_answers[1]), true, "Both caches give the same answers");
+  NS_TEST_EXPECT_MSG_EQ (uint32_t (std::count (m_answers[1].begin (), m_answers[1].end (), true)), Bursts * BurstSize * 3 / 4,
+                         "Three of four copies are duplicates");
+  NS_LOG_INFO ("IdCache: " << Bursts * BurstSize << " RREQs, hashed " << cacheMs
+               << " ms, linear " << referenceMs << " ms");
+}
+
 /**
  * \ingroup aodvDbscan-test
  * \ingroup tests
@@ -117,6 +259,7 @@ public:
   IdCacheTestSuite () : TestSuite ("aodvDbscan-routing-id-cache", UNIT)
   {
     AddTestCase (new IdCacheTest, TestCase::QUICK);
+    AddTestCase (new IdCacheBenchmark, TestCase::EXTENSIVE);
   }
 } g_idCacheTestSuite; ///< the test suite
 
@@ -18,13 +18,30 @@
  * Authors: Pavel Boyko <boyko@iitp.ru>
  */
 #include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/aodvDbscan-dpd.h"
+#include "ns3/aodvDbscan-helper.h"
+#include "ns3/aodvDbscan-location-cache.h"
 #include "ns3/aodvDbscan-neighbor.h"
 #include "ns3/aodvDbscan-packet.h"
 #include "ns3/aodvDbscan-rqueue.h"
+#include "ns3/aodvDbscan-routing-protocol.h"
 #include "ns3/aodvDbscan-rtable.h"
+#include "ns3/boolean.h"
+#include "ns3/constant-velocity-mobility-model.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
 #include "ns3/ipv4-route.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/socket.h"
+#include "ns3/system-wall-clock-ms.h"
+#include <algorithm>
 
 namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("aodvDbscanTestSuite");
+
 namespace aodvDbscan {
 
 /**
@@ -109,6 +126,362 @@ NeighborTest::DoRun ()
   Simulator::Destroy ();
 }
 
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the neighbor count and link changes the adaptive hello interval reacts to
+ */
+struct NeighborLinkChangesTest : public TestCase
+{
+  NeighborLinkChangesTest () : TestCase ("Neighbor link changes"),
+                               neighbor (0)
+  {
+  }
+  virtual void DoRun ();
+  /// Check after the first three links expired
+  void CheckExpired ();
+  /// Check after all links expired
+  void CheckAllExpired ();
+  /// The Neighbors
+  Neighbors * neighbor;
+};
+
+void
+NeighborLinkChangesTest::CheckExpired ()
+{
+  NS_TEST_EXPECT_MSG_EQ (neighbor->GetNeighborCount (), 1, "One neighbor left");
+  NS_TEST_EXPECT_MSG_EQ (neighbor->GetLinkChanges (), 7, "Four links opened, three closed");
+}
+
+void
+NeighborLinkChangesTest::CheckAllExpired ()
+{
+  NS_TEST_EXPECT_MSG_EQ (neighbor->GetNeighborCount (), 0, "No neighbor left");
+  NS_TEST_EXPECT_MSG_EQ (neighbor->GetLinkChanges (), 8, "Four links opened, four closed");
+}
+
+void
+NeighborLinkChangesTest::DoRun ()
+{
+  Neighbors nb (Seconds (1));
+  neighbor = &nb;
+  NS_TEST_EXPECT_MSG_EQ (neighbor->GetLinkChanges (), 0, "No link yet");
+  neighbor->Update (Ipv4Address ("1.2.3.4"), Seconds (1));
+  neighbor->Update (Ipv4Address ("1.2.3.4"), Seconds (10));
+  NS_TEST_EXPECT_MSG_EQ (neighbor->GetLinkChanges (), 1, "Refreshing a link is no change");
+  neighbor->Update (Ipv4Address ("1.1.1.1"), Seconds (5));
+  neighbor->Update (Ipv4Address ("2.2.2.2"), Seconds (10));
+  neighbor->Update (Ipv4Address ("3.3.3.3"), Seconds (20));
+  NS_TEST_EXPECT_MSG_EQ (neighbor->GetNeighborCount (), 4, "Four neighbors");
+  NS_TEST_EXPECT_MSG_EQ (neighbor->GetLinkChanges (), 4, "Four links opened");
+
+  Simulator::Schedule (Seconds (15), &NeighborLinkChangesTest::CheckExpired, this);
+  Simulator::Schedule (Seconds (30), &NeighborLinkChangesTest::CheckAllExpired, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the hello interval, adaptive or not
+ */
+struct HelloIntervalTest : public TestCase
+{
+  HelloIntervalTest () : TestCase ("Hello interval")
+  {
+  }
+  virtual void DoRun ();
+  /**
+   * Record the interval until the next hello
+   * \param intervals the intervals of the node
+   * \param interval the interval chosen
+   */
+  static void Record (std::vector<Time> * intervals, Time interval);
+  /// Intervals chosen by the static adaptive node, the moving adaptive node and the fixed interval node
+  std::vector<Time> m_intervals[3];
+};
+
+void
+HelloIntervalTest::Record (std::vector<Time> * intervals, Time interval)
+{
+  intervals->push_back (interval);
+}
+
+void
+HelloIntervalTest::DoRun ()
+{
+  // Isolated nodes, no neighbor churn
+  NodeContainer nodes;
+  nodes.Create (3);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantVelocityMobilityModel");
+  mobility.Install (nodes);
+  // 40 m/s, HelloMaxDisplacement of 20 m every 0.5 s at most
+  nodes.Get (1)->GetObject<ConstantVelocityMobilityModel> ()->SetVelocity (Vector (40, 0, 0));
+
+  aodvDbscanHelper routing;
+  routing.Set ("EnableAdaptiveHello", BooleanValue (true));
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (routing);
+  stack.Install (nodes.Get (0));
+  stack.Install (nodes.Get (1));
+  routing.Set ("EnableAdaptiveHello", BooleanValue (false));
+  stack.SetRoutingHelper (routing);
+  stack.Install (nodes.Get (2));
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      nodes.Get (i)->GetObject<RoutingProtocol> ()->TraceConnectWithoutContext ("NextHelloInterval",
+                                                                                     MakeBoundCallback (&HelloIntervalTest::Record, &m_intervals[i]));
+    }
+  Simulator::Stop (Seconds (30));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_GT (m_intervals[0].size (), 2, "Hellos sent");
+  NS_TEST_EXPECT_MSG_EQ (m_intervals[0].front (), Seconds (1.25), "Stable neighborhood, backs off from HelloInterval");
+  for (uint32_t i = 1; i < m_intervals[0].size (); ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ ((m_intervals[0][i] >= m_intervals[0][i - 1]), true, "Never shrinks while stable");
+    }
+  NS_TEST_EXPECT_MSG_EQ (m_intervals[0].back (), Seconds (4), "Capped at MaxHelloInterval");
+  NS_TEST_ASSERT_MSG_GT (m_intervals[1].size (), 2, "Hellos sent");
+  for (uint32_t i = 0; i < m_intervals[1].size (); ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_intervals[1][i], Seconds (0.5), "Bounded by the displacement at the node's speed");
+    }
+  NS_TEST_ASSERT_MSG_GT (m_intervals[2].size (), 2, "Hellos sent");
+  for (uint32_t i = 0; i < m_intervals[2].size (); ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_intervals[2][i], Seconds (1), "HelloInterval when not adaptive");
+    }
+}
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the neighbor MAC cache
+ */
+struct NeighborMacCacheTest : public TestCase
+{
+  NeighborMacCacheTest () : TestCase ("Neighbor MAC cache")
+  {
+  }
+  virtual void DoRun ()
+  {
+    Neighbors nb (Seconds (1));
+    nb.LearnMacAddress (Ipv4Address ("1.2.3.4"), Mac48Address ("00:00:00:00:00:01"));
+    nb.Update (Ipv4Address ("1.2.3.4"), Seconds (10));
+    NS_TEST_EXPECT_MSG_EQ (nb.GetMacCacheHits (), 1, "Learned address served from cache");
+    NS_TEST_EXPECT_MSG_EQ (nb.GetArpLookups (), 0, "No ARP lookup needed");
+    nb.Update (Ipv4Address ("4.3.2.1"), Seconds (10));
+    NS_TEST_EXPECT_MSG_EQ (nb.GetMacCacheHits (), 1, "Unknown address");
+    NS_TEST_EXPECT_MSG_EQ (nb.GetArpLookups (), 1, "Unknown address goes to ARP");
+    nb.Update (Ipv4Address ("4.3.2.1"), Seconds (10));
+    NS_TEST_EXPECT_MSG_EQ (nb.GetArpLookups (), 2, "Unresolved address is not cached");
+    nb.LearnMacAddress (Ipv4Address ("4.3.2.1"), Mac48Address ("00:00:00:00:00:02"));
+    nb.Update (Ipv4Address ("4.3.2.1"), Seconds (10));
+    NS_TEST_EXPECT_MSG_EQ (nb.GetArpLookups (), 2, "Neighbor updated by LearnMacAddress");
+    nb.FlushMacCache ();
+    nb.Update (Ipv4Address ("5.5.5.5"), Seconds (10));
+    NS_TEST_EXPECT_MSG_EQ (nb.GetArpLookups (), 3, "Flushed cache goes to ARP");
+    NS_TEST_EXPECT_MSG_EQ (nb.GetMacCacheSize (), 0, "Nothing cached");
+
+    // A mapping taken from ARP is checked against its ARP entry on every use
+    Ptr<ArpCache> resolved = CreateObject<ArpCache> ();
+    resolved->Add (Ipv4Address ("3.3.3.3"))->SetMacAddress (Mac48Address ("00:00:00:00:00:03"));
+    Neighbors other (Seconds (1));
+    other.AddArpCache (resolved);
+    // Already expired, the neighbor is purged but its mapping stays cached
+    other.Update (Ipv4Address ("3.3.3.3"), Seconds (-1));
+    NS_TEST_EXPECT_MSG_EQ (other.GetMacCacheSize (), 1, "Resolved address cached");
+    other.Update (Ipv4Address ("3.3.3.3"), Seconds (-1));
+    NS_TEST_EXPECT_MSG_EQ (other.GetMacCacheHits (), 0, "No hit without sparing the ARP lookup");
+    NS_TEST_EXPECT_MSG_EQ (other.GetArpLookups (), 2, "ARP entry looked up again");
+
+    // Mappings learned on an interface are dropped with its ARP cache
+    Ptr<ArpCache> arp = CreateObject<ArpCache> ();
+    nb.AddArpCache (arp);
+    nb.LearnMacAddress (Ipv4Address ("6.6.6.6"), Mac48Address ("00:00:00:00:00:06"), arp);
+    nb.LearnMacAddress (Ipv4Address ("7.7.7.7"), Mac48Address ("00:00:00:00:00:07"));
+    NS_TEST_EXPECT_MSG_EQ (nb.GetMacCacheSize (), 2, "Both mappings cached");
+    nb.DelArpCache (arp);
+    NS_TEST_EXPECT_MSG_EQ (nb.GetMacCacheSize (), 1, "Mapping of the removed interface dropped");
+
+    // The cache is bounded
+    nb.SetMacCacheCapacity (2);
+    nb.LearnMacAddress (Ipv4Address ("8.8.8.8"), Mac48Address ("00:00:00:00:00:08"));
+    nb.LearnMacAddress (Ipv4Address ("9.9.9.9"), Mac48Address ("00:00:00:00:00:09"));
+    NS_TEST_EXPECT_MSG_EQ (nb.GetMacCacheSize (), 2, "Least recently used mapping evicted");
+    nb.SetMacCacheCapacity (1);
+    NS_TEST_EXPECT_MSG_EQ (nb.GetMacCacheSize (), 1, "Shrinking the capacity evicts");
+    Simulator::Destroy ();
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the hello-loss ETX estimator
+ */
+struct NeighborEtxTest : public TestCase
+{
+  NeighborEtxTest () : TestCase ("Neighbor ETX")
+  {
+  }
+  virtual void DoRun ()
+  {
+    Neighbors nb (Seconds (1));
+    Ipv4Address addr ("1.2.3.4");
+    nb.Update (addr, Seconds (10));
+    NS_TEST_EXPECT_MSG_EQ_TOL (nb.GetEtx (addr), Neighbors::MaxEtx, 1e-9, "No hellos seen yet");
+    nb.RecordHello (addr, 1, Seconds (1));
+    nb.RecordHello (addr, 2, Seconds (1));
+    nb.RecordHello (addr, 2, Seconds (1));
+    nb.RecordHello (addr, 4, Seconds (1));
+    NS_TEST_EXPECT_MSG_EQ_TOL (nb.GetReverseDeliveryRatio (addr), 0.75, 1e-9, "One of four hellos lost");
+    NS_TEST_EXPECT_MSG_EQ_TOL (nb.GetEtx (addr), 1 / (0.75 * 0.75), 1e-9, "Symmetric link assumed");
+    nb.SetForwardDeliveryRatio (addr, 0.5);
+    NS_TEST_EXPECT_MSG_EQ_TOL (nb.GetEtx (addr), 1 / (0.5 * 0.75), 1e-9, "Forward ratio reported");
+    nb.SetForwardDeliveryRatio (addr, 0);
+    NS_TEST_EXPECT_MSG_EQ_TOL (nb.GetEtx (addr), Neighbors::MaxEtx, 1e-9, "Dead link");
+    nb.SetLinkQualityWindow (3);
+    nb.RecordHello (addr, 5, Seconds (1));
+    nb.RecordHello (addr, 6, Seconds (1));
+    NS_TEST_EXPECT_MSG_EQ_TOL (nb.GetReverseDeliveryRatio (addr), 1, 1e-9, "Old hellos slide out of the window");
+
+    RrepHeader h;
+    h.SetHelloSeqNo (7);
+    NS_TEST_EXPECT_MSG_EQ (h.AddLinkQuality (addr, 200), true, "trivial");
+    Ptr<Packet> p = Create<Packet> ();
+    p->AddHeader (h);
+    RrepHeader h2;
+    uint32_t bytes = p->RemoveHeader (h2);
+    NS_TEST_EXPECT_MSG_EQ (bytes, h.GetSerializedSize (), "Extension is serialized");
+    NS_TEST_EXPECT_MSG_EQ (h, h2, "Round trip serialization works");
+    uint8_t ratio = 0;
+    NS_TEST_EXPECT_MSG_EQ (h2.HasLinkQuality (), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h2.GetHelloSeqNo (), 7, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h2.LookupLinkQuality (addr, ratio), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (ratio, 200, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h2.LookupLinkQuality (Ipv4Address ("4.3.2.1"), ratio), false, "trivial");
+    Simulator::Destroy ();
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the hello delivery ratio of links that go quiet
+ */
+struct NeighborOutageTest : public TestCase
+{
+  NeighborOutageTest () : TestCase ("Neighbor hello outage"),
+                          m_nb (Seconds (1)),
+                          m_outage ("1.1.1.1"),
+                          m_quiet ("2.2.2.2")
+  {
+  }
+  /// Neighbors under test
+  Neighbors m_nb;
+  /// Neighbor whose hellos are lost for longer than the window
+  Ipv4Address m_outage;
+  /// Neighbor that stops sending hellos
+  Ipv4Address m_quiet;
+  /**
+   * Check the reverse delivery ratio of a neighbor
+   * \param addr the IP address of the neighbor
+   * \param ratio the expected ratio
+   * \param msg what is checked
+   */
+  void CheckRatio (Ipv4Address addr, double ratio, std::string msg)
+  {
+    NS_TEST_EXPECT_MSG_EQ_TOL (m_nb.GetReverseDeliveryRatio (addr), ratio, 1e-9, msg);
+  }
+  virtual void DoRun ()
+  {
+    m_nb.Update (m_outage, Seconds (100));
+    m_nb.Update (m_quiet, Seconds (100));
+    for (uint16_t seqNo = 1; seqNo <= 10; ++seqNo)
+      {
+        Simulator::Schedule (Seconds (seqNo - 1), &Neighbors::RecordHello, &m_nb, m_quiet, seqNo, Seconds (1));
+        if (seqNo <= 5)
+          {
+            Simulator::Schedule (Seconds (seqNo - 1), &Neighbors::RecordHello, &m_nb, m_outage, seqNo, Seconds (1));
+          }
+      }
+    Simulator::Schedule (Seconds (9), &NeighborOutageTest::CheckRatio, this, m_quiet, 1, "Every hello received");
+    Simulator::Schedule (Seconds (9.2), &NeighborOutageTest::CheckRatio, this, m_quiet, 1, "Next hello not due yet");
+    Simulator::Schedule (Seconds (11.6), &NeighborOutageTest::CheckRatio, this, m_quiet, 0.8, "Two hellos missed since the last one");
+    Simulator::Schedule (Seconds (20), &NeighborOutageTest::CheckRatio, this, m_quiet, 0, "Whole window missed");
+
+    Simulator::Schedule (Seconds (29), &Neighbors::RecordHello, &m_nb, m_outage, 30, Seconds (1));
+    Simulator::Schedule (Seconds (29), &NeighborOutageTest::CheckRatio, this, m_outage, 0.1, "Outage counted as losses");
+    Simulator::Schedule (Seconds (30), &Neighbors::RecordHello, &m_nb, m_outage, 31, Seconds (1));
+    Simulator::Schedule (Seconds (30), &NeighborOutageTest::CheckRatio, this, m_outage, 0.2, "Recovering link");
+    Simulator::Stop (Seconds (31));
+    Simulator::Run ();
+    Simulator::Destroy ();
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the location cache
+ */
+struct LocationCacheTest : public TestCase
+{
+  LocationCacheTest () : TestCase ("Location cache")
+  {
+  }
+  virtual void DoRun ()
+  {
+    LocationCache cache (/*capacity=*/ 2, /*maxAge=*/ Seconds (30));
+    cache.SetHalfLife (Seconds (10));
+    Ipv4Address a ("1.1.1.1"), b ("2.2.2.2"), c ("3.3.3.3");
+    LocationCache::Position position;
+    cache.SetPosition (a, std::make_pair (10, 20), Seconds (0));
+    cache.SetPosition (b, std::make_pair (30, 40), Seconds (0));
+    NS_TEST_EXPECT_MSG_EQ (cache.Lookup (a, position), true, "Known position");
+    NS_TEST_EXPECT_MSG_EQ (position.second, 20, "trivial");
+    cache.SetPosition (c, std::make_pair (50, 60), Seconds (0));
+    NS_TEST_EXPECT_MSG_EQ (cache.GetSize (), 2, "Capacity respected");
+    NS_TEST_EXPECT_MSG_EQ (cache.IsKnown (b), false, "Least recently used position evicted");
+    NS_TEST_EXPECT_MSG_EQ (cache.IsKnown (a), true, "Recently used position kept");
+    NS_TEST_EXPECT_MSG_EQ_TOL (cache.GetConfidence (a), 1, 1e-9, "Fresh position");
+    NS_TEST_EXPECT_MSG_EQ_TOL (cache.GetConfidence (b), 0, 1e-9, "Unknown position");
+
+    cache.SetPosition (a, std::make_pair (10, 20), Seconds (-10));
+    NS_TEST_EXPECT_MSG_EQ_TOL (cache.GetConfidence (a), 0.5, 1e-9, "One half-life old");
+    cache.SetVelocity (c, 1, 0.5, Seconds (-2));
+    NS_TEST_EXPECT_MSG_EQ (cache.Lookup (c, position), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (position.first, 52, "Dead reckoned along the velocity");
+    NS_TEST_EXPECT_MSG_EQ (position.second, 61, "Dead reckoned along the velocity");
+    double vx = 0;
+    double vy = 0;
+    NS_TEST_EXPECT_MSG_EQ (cache.GetVelocity (c, vx, vy), true, "Known velocity");
+    NS_TEST_EXPECT_MSG_EQ_TOL (vy, 0.5, 1e-9, "Known velocity");
+    NS_TEST_EXPECT_MSG_EQ (cache.GetVelocity (a, vx, vy), false, "No velocity");
+    NS_TEST_EXPECT_MSG_EQ_TOL (LocationCache::LinkLifetime (100, 0, 10, 0, 250).GetSeconds (), 15, 1e-6, "Moving apart");
+    NS_TEST_EXPECT_MSG_EQ_TOL (LocationCache::LinkLifetime (100, 0, -10, 0, 250).GetSeconds (), 35, 1e-6, "Passing by");
+    NS_TEST_EXPECT_MSG_EQ (LocationCache::LinkLifetime (100, 0, 0, 0, 250), Time::Max (), "Not moving");
+    NS_TEST_EXPECT_MSG_EQ (LocationCache::LinkLifetime (300, 0, -10, 0, 250), Seconds (0), "Out of range");
+    cache.SetPosition (c, std::make_pair (50, 60), Seconds (-40));
+    NS_TEST_EXPECT_MSG_EQ (cache.Lookup (c, position), false, "Too old to be used");
+    NS_TEST_EXPECT_MSG_EQ (cache.GetSize (), 1, "Old position dropped");
+    NS_TEST_EXPECT_MSG_EQ (cache.Refresh (a, Seconds (0)), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ_TOL (cache.GetConfidence (a), 1, 1e-9, "Refreshed position");
+    Simulator::Destroy ();
+  }
+};
+
 /**
  * \ingroup aodvDbscan-test
  * \ingroup tests
@@ -132,6 +505,25 @@ struct TypeHeaderTest : public TestCase
     uint32_t bytes = p->RemoveHeader (h2);
     NS_TEST_EXPECT_MSG_EQ (bytes, 1, "Type header is 1 byte long");
     NS_TEST_EXPECT_MSG_EQ (h, h2, "Round trip serialization works");
+
+    // Neighbor state piggybacked on a RERR
+    NeighborStateHeader state (/*txErrorCount=*/ 3, /*freeSpace=*/ 200, /*positionX=*/ 1500, /*positionY=*/ 70000);
+    TypeHeader h3 (aodvDbscanTYPE_RERR);
+    h3.SetNeighborState (true);
+    p = Create<Packet> ();
+    p->AddHeader (state);
+    p->AddHeader (h3);
+    NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 12, "Type, varint counters and two 32 bit coordinates");
+    TypeHeader h4;
+    p->RemoveHeader (h4);
+    NS_TEST_EXPECT_MSG_EQ (h4.IsValid (), true, "The flag does not invalidate the type");
+    NS_TEST_EXPECT_MSG_EQ (h4.Get (), aodvDbscanTYPE_RERR, "The flag is masked out of the type");
+    NS_TEST_EXPECT_MSG_EQ (h4.HasNeighborState (), true, "Neighbor state flag");
+    NeighborStateHeader state2;
+    p->RemoveHeader (state2);
+    NS_TEST_EXPECT_MSG_EQ (state, state2, "Round trip serialization works");
+    NS_TEST_EXPECT_MSG_EQ (state2.GetPosition ().second, 70000, "Position");
+    NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 0, "Nothing left");
   }
 };
 
@@ -185,6 +577,40 @@ struct RreqHeaderTest : public TestCase
     NS_TEST_EXPECT_MSG_EQ (bytes, 23, "RREP is 23 bytes long");
     NS_TEST_EXPECT_MSG_EQ (h, h2, "Round trip serialization works");
 
+    NS_TEST_EXPECT_MSG_EQ (h.HasForwarders (), false, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h.IsForwarder (Ipv4Address ("10.0.0.1")), true, "Everybody forwards an unlisted RREQ");
+    NS_TEST_EXPECT_MSG_EQ (h.AddForwarder (Ipv4Address ("10.0.0.1")), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h.AddForwarder (Ipv4Address ("10.0.0.2")), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h.HasForwarders (), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h.GetSerializedSize (), 32, "Forwarder list adds count and addresses");
+    p = Create<Packet> ();
+    p->AddHeader (h);
+    RreqHeader h3;
+    bytes = p->RemoveHeader (h3);
+    NS_TEST_EXPECT_MSG_EQ (bytes, 32, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h, h3, "Round trip with forwarders works");
+    NS_TEST_EXPECT_MSG_EQ (h3.GetForwarderCount (), 2, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h3.IsForwarder (Ipv4Address ("10.0.0.2")), true, "Listed forwarder");
+    NS_TEST_EXPECT_MSG_EQ (h3.IsForwarder (Ipv4Address ("10.0.0.3")), false, "Not listed");
+    h3.ClearForwarders ();
+    NS_TEST_EXPECT_MSG_EQ (h3.GetSerializedSize (), 23, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h3, h2, "trivial");
+
+    // Forwarded the way RecvRequest does: patched from the received bytes
+    p = Create<Packet> ();
+    p->AddHeader (h);
+    p->PeekHeader (h3);
+    h3.ClearForwarders ();
+    h3.SetHopCount (8);
+    h3.SetDstSeqno (6);
+    h3.SetUnknownSeqno (false);
+    Ptr<Packet> forwarded = h3.CreateForwarded (p);
+    RreqHeader h4;
+    bytes = forwarded->RemoveHeader (h4);
+    NS_TEST_EXPECT_MSG_EQ (bytes, 23, "Forwarders left out");
+    NS_TEST_EXPECT_MSG_EQ (forwarded->GetSize (), 0, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h4, h3, "Patched fields read back");
+
   }
 };
 
@@ -237,6 +663,183 @@ struct RrepHeaderTest : public TestCase
     uint32_t bytes = p->RemoveHeader (h2);
     NS_TEST_EXPECT_MSG_EQ (bytes, 19, "RREP is 19 bytes long");
     NS_TEST_EXPECT_MSG_EQ (h, h2, "Round trip serialization works");
+
+    NS_TEST_EXPECT_MSG_EQ (h.HasMotion (), false, "trivial");
+    h.SetMotion (12.34, -3.2, MilliSeconds (7500));
+    NS_TEST_EXPECT_MSG_EQ (h.HasMotion (), true, "trivial");
+    p = Create<Packet> ();
+    p->AddHeader (h);
+    RrepHeader h3;
+    bytes = p->RemoveHeader (h3);
+    NS_TEST_EXPECT_MSG_EQ (bytes, h.GetSerializedSize (), "Motion extension is serialized");
+    NS_TEST_EXPECT_MSG_EQ (h, h3, "Round trip serialization works");
+    NS_TEST_EXPECT_MSG_EQ_TOL (h3.GetVelocity ().first, 12.34, 1e-9, "Velocity in cm/s");
+    NS_TEST_EXPECT_MSG_EQ_TOL (h3.GetVelocity ().second, -3.2, 1e-9, "Negative velocity");
+    NS_TEST_EXPECT_MSG_EQ (h3.GetTimestamp (), MilliSeconds (7500), "trivial");
+
+    NS_TEST_EXPECT_MSG_EQ (h.HasResidualEnergy (), false, "trivial");
+    NS_TEST_EXPECT_MSG_EQ_TOL (h.GetResidualEnergy (), 1, 1e-9, "Full when not advertised");
+    h.SetResidualEnergy (0.4);
+    p = Create<Packet> ();
+    p->AddHeader (h);
+    RrepHeader h4;
+    bytes = p->RemoveHeader (h4);
+    NS_TEST_EXPECT_MSG_EQ (bytes, h3.GetSerializedSize () + 1, "Residual energy takes one byte");
+    NS_TEST_EXPECT_MSG_EQ (h, h4, "Round trip serialization works");
+    NS_TEST_EXPECT_MSG_EQ_TOL (h4.GetResidualEnergy (), 0.4, 1.0 / 255, "Quantized residual energy");
+
+    // Forwarded the way RecvReply does: patched from the received bytes
+    h.SetAckRequired (true);
+    p = Create<Packet> ();
+    p->AddHeader (h2);
+    p->AddHeader (h);
+    p->PeekHeader (h4);
+    h4.SetHopCount (16);
+    h4.SetAckRequired (false);
+    Ptr<Packet> forwarded = h4.CreateForwarded (p);
+    RrepHeader h5;
+    bytes = forwarded->RemoveHeader (h5);
+    NS_TEST_EXPECT_MSG_EQ (bytes, h.GetSerializedSize (), "Aggregated RREP behind it left out");
+    NS_TEST_EXPECT_MSG_EQ (forwarded->GetSize (), 0, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h5, h4, "Patched fields read back");
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for a packet carrying several RREPs of different sizes
+ */
+struct AggregatedRrepTest : public TestCase
+{
+  AggregatedRrepTest () : TestCase ("aodvDbscan aggregated RREPs")
+  {
+  }
+  virtual void DoRun ()
+  {
+    std::vector<RrepHeader> replies;
+    replies.push_back (RrepHeader (/*prefixSize*/ 0, /*hopCount*/ 2, /*dst*/ Ipv4Address ("10.0.0.9"), /*dstSeqNo*/ 5,
+                                   /*origin*/ Ipv4Address ("10.0.0.1"), /*lifetime*/ Seconds (3),
+                                   /*txErrorCount*/ 1, /*freeSpace*/ 64, /*positionX*/ 1500, /*positionY*/ 2600));
+    replies.push_back (replies.back ());
+    replies.back ().SetDst (Ipv4Address ("10.0.0.8"));
+    replies.back ().SetCompact (true);
+    replies.back ().SetCompactOrigin (1000, 2000, 1);
+    replies.back ().OmitFields (RrepHeader::FREE_SPACE | RrepHeader::POSITION);
+    replies.push_back (replies.front ());
+    replies.back ().SetDst (Ipv4Address ("10.0.0.7"));
+    replies.back ().SetCompact (true);
+    replies.back ().SetCompactOrigin (1000, 2000, 1);
+    replies.back ().SetTxErrorCount (300);
+
+    // Built the way SendAggregatedReplies does, the first RREP outermost
+    Ptr<Packet> p = Create<Packet> ();
+    uint32_t size = 0;
+    for (std::vector<RrepHeader>::reverse_iterator i = replies.rbegin (); i != replies.rend (); ++i)
+      {
+        p->AddHeader (*i);
+        p->AddHeader (TypeHeader (aodvDbscanTYPE_RREP));
+        size += i->GetSerializedSize () + TypeHeader ().GetSerializedSize ();
+      }
+    NS_TEST_EXPECT_MSG_EQ (p->GetSize (), size, "Messages back to back");
+
+    // Read the way RecvaodvDbscan does
+    for (std::vector<RrepHeader>::const_iterator i = replies.begin (); i != replies.end (); ++i)
+      {
+        TypeHeader tHeader;
+        p->RemoveHeader (tHeader);
+        NS_TEST_EXPECT_MSG_EQ (tHeader.Get (), aodvDbscanTYPE_RREP, "RREP follows");
+        RrepHeader rrepHeader;
+        rrepHeader.SetCompactOrigin (1000, 2000, 1);
+        NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (rrepHeader), i->GetSerializedSize (), "Each RREP read to its end");
+        NS_TEST_EXPECT_MSG_EQ (rrepHeader, *i, "RREP " << i - replies.begin () << " parsed");
+      }
+    NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 0, "Nothing left after the last RREP");
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the compact RREP encoding
+ */
+struct RrepCompactHeaderTest : public TestCase
+{
+  RrepCompactHeaderTest () : TestCase ("aodvDbscan compact RREP")
+  {
+  }
+  /**
+   * Serialize and deserialize a header
+   * \param h the header
+   * \param h2 the deserialized header, configured with the same origin
+   * \returns the number of bytes read
+   */
+  uint32_t RoundTrip (const RrepHeader & h, RrepHeader & h2)
+  {
+    Ptr<Packet> p = Create<Packet> ();
+    p->AddHeader (h);
+    uint32_t bytes = p->RemoveHeader (h2);
+    NS_TEST_EXPECT_MSG_EQ (bytes, h.GetSerializedSize (), "(De)Serialized size match");
+    return bytes;
+  }
+  virtual void DoRun ()
+  {
+    RrepHeader h (/*prefixSize*/ 0, /*hopCount*/ 0, /*dst*/ Ipv4Address ("1.2.3.4"), /*dstSeqNo*/ 2,
+                                 /*origin*/ Ipv4Address ("1.2.3.4"), /*lifetime*/ Seconds (3),
+                                 /*txErrorCount*/ 5, /*freeSpace*/ 64, /*positionX*/ 1500, /*positionY*/ 2600);
+    NS_TEST_EXPECT_MSG_EQ (h.GetSerializedSize (), 35, "Fixed fields take 16 bytes");
+    h.SetCompact (true);
+    NS_TEST_EXPECT_MSG_EQ (h.IsCompact (), true, "trivial");
+    h.SetCompactOrigin (1000, 2000, 1);
+    NS_TEST_EXPECT_MSG_EQ (h.GetSerializedSize (), 26, "Compact fields take 7 bytes");
+
+    RrepHeader h2;
+    h2.SetCompactOrigin (1000, 2000, 1);
+    RoundTrip (h, h2);
+    NS_TEST_EXPECT_MSG_EQ (h, h2, "Round trip serialization works");
+    NS_TEST_EXPECT_MSG_EQ (h2.IsCompact (), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h2.GetTxErrorCount (), 5, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h2.GetFreeSpace (), 64, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h2.GetPosition ().first, 1500, "Position restored relative to origin");
+    NS_TEST_EXPECT_MSG_EQ (h2.GetPosition ().second, 2600, "Position restored relative to origin");
+
+    h.SetTxErrorCount (300);
+    h.SetFreeSpace (70000);
+    NS_TEST_EXPECT_MSG_EQ (h.GetSerializedSize (), 29, "Counters take 2 and 3 bytes");
+    RrepHeader h3;
+    h3.SetCompactOrigin (1000, 2000, 1);
+    RoundTrip (h, h3);
+    NS_TEST_EXPECT_MSG_EQ (h, h3, "Multi byte counters round trip");
+
+    h.OmitFields (RrepHeader::FREE_SPACE | RrepHeader::POSITION);
+    NS_TEST_EXPECT_MSG_EQ (h.GetSerializedSize (), 22, "Only the TX error count is left");
+    RrepHeader h4;
+    h4.SetCompactOrigin (1000, 2000, 1);
+    RoundTrip (h, h4);
+    NS_TEST_EXPECT_MSG_EQ (h, h4, "Round trip with omitted fields works");
+    NS_TEST_EXPECT_MSG_EQ (h4.HasField (RrepHeader::TX_ERROR_COUNT), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h4.HasField (RrepHeader::FREE_SPACE), false, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h4.HasField (RrepHeader::POSITION), false, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h4.GetTxErrorCount (), 300, "trivial");
+
+    RrepHeader q (/*prefixSize*/ 0, /*hopCount*/ 0, /*dst*/ Ipv4Address ("1.2.3.4"), /*dstSeqNo*/ 2,
+                                 /*origin*/ Ipv4Address ("1.2.3.4"), /*lifetime*/ Seconds (3),
+                                 /*txErrorCount*/ 0, /*freeSpace*/ 0, /*positionX*/ 12345, /*positionY*/ 500000);
+    q.SetCompact (true);
+    q.SetCompactOrigin (0, 0, 2.5);
+    q.SetHelloSeqNo (7);
+    q.AddLinkQuality (Ipv4Address ("4.3.2.1"), 128);
+    RrepHeader q2;
+    q2.SetCompactOrigin (0, 0, 2.5);
+    RoundTrip (q, q2);
+    NS_TEST_EXPECT_MSG_EQ_TOL (q2.GetPosition ().first, 12345, 1.25, "Quantized within half a step");
+    NS_TEST_EXPECT_MSG_EQ (q2.GetPosition ().second, uint32_t (65535 * 2.5 + 0.5), "Saturated beyond the 16 bit range");
+    NS_TEST_EXPECT_MSG_EQ (q2.GetHelloSeqNo (), 7, "Link quality extension follows compact fields");
+    uint8_t ratio = 0;
+    NS_TEST_EXPECT_MSG_EQ (q2.LookupLinkQuality (Ipv4Address ("4.3.2.1"), ratio), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (ratio, 128, "trivial");
   }
 };
 
@@ -293,6 +896,19 @@ struct RerrHeaderTest : public TestCase
     uint32_t bytes = p->RemoveHeader (h2);
     NS_TEST_EXPECT_MSG_EQ (bytes, h.GetSerializedSize (), "(De)Serialized size match");
     NS_TEST_EXPECT_MSG_EQ (h, h2, "Round trip serialization works");
+    NS_TEST_EXPECT_MSG_EQ (h2.GetUnDestination (1).first, dst2, "Insertion order kept");
+
+    h.Clear ();
+    for (uint32_t i = 0; i < RerrHeader::MaxUnDestinations; ++i)
+      {
+        h.AddUnDestination (Ipv4Address (0x0a000000 + i), i);
+      }
+    NS_TEST_EXPECT_MSG_EQ (h.GetDestCount (), 255, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (h.AddUnDestination (Ipv4Address ("10.1.0.0"), 1), false, "RERR is full");
+    std::pair<Ipv4Address, uint32_t> un;
+    NS_TEST_EXPECT_MSG_EQ (h.RemoveUnDestination (un), true, "trivial");
+    NS_TEST_EXPECT_MSG_EQ (un.first, Ipv4Address (0x0a0000fe), "Last added is removed first");
+    NS_TEST_EXPECT_MSG_EQ (un.second, 254, "trivial");
   }
 };
 
@@ -300,55 +916,264 @@ struct RerrHeaderTest : public TestCase
  * \ingroup aodvDbscan-test
  * \ingroup tests
  *
- * \brief Unit test for aodvDbscan routing table entry
+ * \brief Benchmark of building and parsing RERRs during a link break storm
  */
-struct QueueEntryTest : public TestCase
+struct RerrHeaderBenchmark : public TestCase
 {
-  QueueEntryTest () : TestCase ("QueueEntry")
+  RerrHeaderBenchmark () : TestCase ("aodvDbscan RERR benchmark")
   {
   }
-  /**
-   * Unicast test function
-   * \param route the IPv4 route
-   * \param packet the packet
-   * \param header the IPv4 header
-   */
-  void Unicast (Ptr<Ipv4Route> route, Ptr<const Packet> packet, const Ipv4Header & header)
+  virtual void DoRun ()
   {
+    const uint32_t messages = 2000;
+    const uint32_t destinations = 300;
+    uint32_t sent = 0;
+    uint32_t parsed = 0;
+    SystemWallClockMs clock;
+    clock.Start ();
+    RerrHeader rerrHeader;
+    for (uint32_t m = 0; m < messages; ++m)
+      {
+        // Same pattern as SendRerrWhenBreaksLinkToNextHop: flush whenever the RERR fills up
+        for (uint32_t d = 0; d < destinations; )
+          {
+            if (!rerrHeader.AddUnDestination (Ipv4Address (0x0a000000 + m * destinations + d), d))
+              {
+                Ptr<Packet> packet = Create<Packet> ();
+                packet->AddHeader (rerrHeader);
+                RerrHeader received;
+                packet->RemoveHeader (received);
+                parsed += received.GetDestCount ();
+                ++sent;
+                rerrHeader.Clear ();
+              }
+            else
+              {
+                ++d;
+              }
+          }
+        Ptr<Packet> packet = Create<Packet> ();
+        packet->AddHeader (rerrHeader);
+        RerrHeader received;
+        packet->RemoveHeader (received);
+        parsed += received.GetDestCount ();
+        ++sent;
+        rerrHeader.Clear ();
+      }
+    int64_t ms = clock.End ();
+    NS_TEST_EXPECT_MSG_EQ (sent, 2 * messages, "Every break needs two RERRs");
+    NS_TEST_EXPECT_MSG_EQ (parsed, messages * destinations, "All destinations parsed");
+    NS_LOG_INFO ("RerrHeader: " << sent << " RERRs with " << parsed << " destinations built and parsed in "
+                 << ms << " ms");
   }
-  /**
-   * Error test function
-   * \param p The packet
-   * \param h The header
-   * \param e the socket error
-   */
-  void Error (Ptr<const Packet> p, const Ipv4Header & h, Socket::SocketErrno e)
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Benchmark of forwarding RREQs and RREPs from the received bytes against
+ * serializing the headers again, as RecvRequest and RecvReply did before
+ */
+struct ForwardingBenchmark : public TestCase
+{
+  ForwardingBenchmark () : TestCase ("aodvDbscan forwarding benchmark")
   {
   }
-  /**
-   * Unicast 2 testfunction
-   * \param route The IPv4 route
-   * \param packet The packet
-   * \param header The header
-   */
-  void Unicast2 (Ptr<Ipv4Route> route, Ptr<const Packet> packet, const Ipv4Header & header)
+  virtual void DoRun ()
   {
+    const uint32_t messages = 200000;
+    RreqHeader rreqHeader (/*flags*/ 0, /*reserved*/ 0, /*hopCount*/ 3, /*requestID*/ 1, /*dst*/ Ipv4Address ("10.0.0.9"),
+                           /*dstSeqNo*/ 40, /*origin*/ Ipv4Address ("10.0.0.1"), /*originSeqNo*/ 10);
+    rreqHeader.AddForwarder (Ipv4Address ("10.0.0.2"));
+    rreqHeader.AddForwarder (Ipv4Address ("10.0.0.3"));
+    RrepHeader rrepHeader (/*prefixSize*/ 0, /*hopCount*/ 2, /*dst*/ Ipv4Address ("10.0.0.9"), /*dstSeqNo*/ 5,
+                           /*origin*/ Ipv4Address ("10.0.0.1"), /*lifetime*/ Seconds (3),
+                           /*txErrorCount*/ 1, /*freeSpace*/ 64, /*positionX*/ 1500, /*positionY*/ 2600);
+    rrepHeader.SetMotion (1.5, -2, Seconds (1));
+    Ptr<Packet> rreq = Create<Packet> ();
+    rreq->AddHeader (rreqHeader);
+    Ptr<Packet> rrep = Create<Packet> ();
+    rrep->AddHeader (rrepHeader);
+
+    uint32_t mismatches = 0;
+    SystemWallClockMs clock;
+    clock.Start ();
+    for (uint32_t m = 0; m < messages; ++m)
+      {
+        Ptr<Packet> packet = rreq->Copy ();
+        RreqHeader received;
+        packet->PeekHeader (received);
+        packet->RemoveAtStart (received.GetSerializedSize ());
+        received.ClearForwarders ();
+        received.SetHopCount (received.GetHopCount () + 1);
+        packet->AddHeader (received);
+        mismatches += (packet->GetSize () != 23);
+
+        packet = rrep->Copy ();
+        RrepHeader reply;
+        packet->RemoveHeader (reply);
+        reply.SetHopCount (reply.GetHopCount () + 1);
+        Ptr<Packet> forwarded = Create<Packet> ();
+        forwarded->AddHeader (reply);
+        mismatches += (forwarded->GetSize () != rrep->GetSize ());
+        // RecvaodvDbscan read the RREP a second time to find the next aggregated one
+        rrep->PeekHeader (reply);
+      }
+    int64_t serializedMs = clock.End ();
+    clock.Start ();
+    for (uint32_t m = 0; m < messages; ++m)
+      {
+        RreqHeader received;
+        rreq->PeekHeader (received);
+        received.ClearForwarders ();
+        received.SetHopCount (received.GetHopCount () + 1);
+        mismatches += (received.CreateForwarded (rreq)->GetSize () != 23);
+
+        RrepHeader reply;
+        rrep->PeekHeader (reply);
+        reply.SetHopCount (reply.GetHopCount () + 1);
+        mismatches += (reply.CreateForwarded (rrep)->GetSize () != rrep->GetSize ());
+      }
+    int64_t patchedMs = clock.End ();
+    NS_TEST_EXPECT_MSG_EQ (mismatches, 0, "Forwarded messages have the expected size");
+    NS_LOG_INFO ("Forwarding: " << messages << " RREQs and RREPs, serialized again in " << serializedMs
+                 << " ms, patched in " << patchedMs << " ms");
   }
-  /**
-   * Error2 test function
-   * \param p The packet
-   * \param h The header
-   * \param e the socket error
-   */
-  void Error2 (Ptr<const Packet> p, const Ipv4Header & h, Socket::SocketErrno e)
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the Bloom filter mode of duplicate packet detection
+ */
+class DpdBloomFilterTest : public TestCase
+{
+public:
+  DpdBloomFilterTest () : TestCase ("Duplicate packet detection Bloom filter"),
+                          dpd (Seconds (2))
   {
   }
-  virtual void DoRun ()
-  {
-    Ptr<const Packet> packet = Create<Packet> ();
-    Ipv4Header h;
-    h.SetDestination (Ipv4Address ("1.2.3.4"));
-    h.SetSource (Ipv4Address ("4.3.2.1"));
+  virtual void DoRun ();
+
+private:
+  /**
+   * Count the packets reported as duplicates
+   * \returns the number of duplicates
+   */
+  uint32_t CountDuplicates ();
+  /// Check packets are remembered for a lifetime
+  void CheckRemembered ();
+  /// Check packets are forgotten after one and a half lifetimes
+  void CheckForgotten ();
+
+  /// Duplicate packet detection
+  DuplicatePacketDetection dpd;
+  /// Packets seen
+  std::vector<Ptr<Packet> > packets;
+  /// IP header of all packets
+  Ipv4Header header;
+};
+
+uint32_t
+DpdBloomFilterTest::CountDuplicates ()
+{
+  uint32_t duplicates = 0;
+  for (std::vector<Ptr<Packet> >::const_iterator i = packets.begin (); i != packets.end (); ++i)
+    {
+      duplicates += dpd.IsDuplicate (*i, header);
+    }
+  return duplicates;
+}
+
+void
+DpdBloomFilterTest::DoRun ()
+{
+  header.SetSource (Ipv4Address ("10.1.1.1"));
+  NS_TEST_EXPECT_MSG_EQ (dpd.IsBloomFilterEnabled (), false, "Exact cache by default");
+  dpd.EnableBloomFilter (1000, 0.01);
+  NS_TEST_EXPECT_MSG_EQ (dpd.IsBloomFilterEnabled (), true, "trivial");
+  uint32_t size = dpd.GetBloomFilterSize ();
+  for (uint32_t i = 0; i < 500; ++i)
+    {
+      packets.push_back (Create<Packet> ());
+    }
+  NS_TEST_EXPECT_MSG_LT (CountDuplicates (), 10, "Few false positives among new packets");
+  NS_TEST_EXPECT_MSG_EQ (CountDuplicates (), 500, "All copies are duplicates");
+  NS_TEST_EXPECT_MSG_EQ (dpd.GetBloomFilterSize (), size, "Memory does not grow");
+
+  Simulator::Schedule (Seconds (1.9), &DpdBloomFilterTest::CheckRemembered, this);
+  Simulator::Schedule (Seconds (3.5), &DpdBloomFilterTest::CheckForgotten, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+DpdBloomFilterTest::CheckRemembered ()
+{
+  NS_TEST_EXPECT_MSG_EQ (CountDuplicates (), 500, "Packets remembered within lifetime");
+}
+
+void
+DpdBloomFilterTest::CheckForgotten ()
+{
+  NS_TEST_EXPECT_MSG_LT (CountDuplicates (), 10, "Packets forgotten after the filters rotated");
+}
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for aodvDbscan routing table entry
+ */
+struct QueueEntryTest : public TestCase
+{
+  QueueEntryTest () : TestCase ("QueueEntry")
+  {
+  }
+  /**
+   * Unicast test function
+   * \param route the IPv4 route
+   * \param packet the packet
+   * \param header the IPv4 header
+   */
+  void Unicast (Ptr<Ipv4Route> route, Ptr<const Packet> packet, const Ipv4Header & header)
+  {
+  }
+  /**
+   * Error test function
+   * \param p The packet
+   * \param h The header
+   * \param e the socket error
+   */
+  void Error (Ptr<const Packet> p, const Ipv4Header & h, Socket::SocketErrno e)
+  {
+  }
+  /**
+   * Unicast 2 testfunction
+   * \param route The IPv4 route
+   * \param packet The packet
+   * \param header The header
+   */
+  void Unicast2 (Ptr<Ipv4Route> route, Ptr<const Packet> packet, const Ipv4Header & header)
+  {
+  }
+  /**
+   * Error2 test function
+   * \param p The packet
+   * \param h The header
+   * \param e the socket error
+   */
+  void Error2 (Ptr<const Packet> p, const Ipv4Header & h, Socket::SocketErrno e)
+  {
+  }
+  virtual void DoRun ()
+  {
+    Ptr<const Packet> packet = Create<Packet> ();
+    Ipv4Header h;
+    h.SetDestination (Ipv4Address ("1.2.3.4"));
+    h.SetSource (Ipv4Address ("4.3.2.1"));
     Ipv4RoutingProtocol::UnicastForwardCallback ucb = MakeCallback (&QueueEntryTest::Unicast, this);
     Ipv4RoutingProtocol::ErrorCallback ecb = MakeCallback (&QueueEntryTest::Error, this);
     QueueEntry entry (packet, h, ucb, ecb, Seconds (1));
@@ -641,6 +1466,1167 @@ struct aodvDbscanRtableTest : public TestCase
   }
 };
 
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the neighbor selection of greedy forwarding
+ */
+struct aodvDbscanGreedyTest : public TestCase
+{
+  aodvDbscanGreedyTest () : TestCase ("Greedy forwarding")
+  {
+  }
+  virtual void DoRun ()
+  {
+    Ptr<NetDevice> dev;
+    Ipv4InterfaceAddress iface;
+    // Toward (100, 0) from a node 100 m away, neighbors at x = 90, 50, 120 and 10
+    RoutingTable neighbors (Seconds (2));
+    const uint32_t positionX[] = { 90, 50, 120, 10 };
+    for (uint32_t i = 0; i < 4; ++i)
+      {
+        RoutingTableEntry nb (/*output device*/ dev, /*dst*/ Ipv4Address (0x0a000001 + i), /*validSeqNo*/ true, /*seqNo*/ 0,
+                                                /*interface*/ iface, /*hop*/ 1, /*next hop*/ Ipv4Address (0x0a000001 + i), /*lifetime*/ Seconds (10));
+        nb.SetPosition (positionX[i], 0);
+        neighbors.AddRoute (nb);
+      }
+    // A neighbor two hops away is no candidate, however close
+    RoutingTableEntry far (/*output device*/ dev, /*dst*/ Ipv4Address ("10.0.0.9"), /*validSeqNo*/ true, /*seqNo*/ 0,
+                                             /*interface*/ iface, /*hop*/ 2, /*next hop*/ Ipv4Address ("10.0.0.1"), /*lifetime*/ Seconds (10));
+    far.SetPosition (100, 0);
+    neighbors.AddRoute (far);
+
+    std::vector<Ipv4Address> greedy = neighbors.GreedyNeighbors (100, 0, 100, 2);
+    NS_TEST_ASSERT_MSG_EQ (greedy.size (), 2, "Limited to the requested count");
+    NS_TEST_EXPECT_MSG_EQ (greedy[0], Ipv4Address ("10.0.0.1"), "Closest to the destination first");
+    NS_TEST_EXPECT_MSG_EQ (greedy[1], Ipv4Address ("10.0.0.3"), "Second closest next");
+    NS_TEST_EXPECT_MSG_EQ (neighbors.GreedyNeighbors (100, 0, 60, 10).size (), 3, "Only neighbors closer than this node");
+    NS_TEST_EXPECT_MSG_EQ (neighbors.GreedyNeighbors (100, 0, 5, 2).empty (), true, "No neighbor closer than this node");
+    neighbors.SetEntryState (Ipv4Address ("10.0.0.1"), INVALID);
+    greedy = neighbors.GreedyNeighbors (100, 0, 100, 2);
+    NS_TEST_ASSERT_MSG_EQ (greedy.size (), 2, "Still two candidates");
+    NS_TEST_EXPECT_MSG_EQ (greedy[0], Ipv4Address ("10.0.0.3"), "Invalid route skipped");
+    Simulator::Destroy ();
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the distance one hop covers, used for the TTL of the first RREQ
+ */
+struct aodvDbscanNeighborRangeTest : public TestCase
+{
+  aodvDbscanNeighborRangeTest () : TestCase ("Neighbor range")
+  {
+  }
+  virtual void DoRun ()
+  {
+    Ptr<NetDevice> dev;
+    Ipv4InterfaceAddress iface;
+    NS_TEST_EXPECT_MSG_EQ_TOL (RoutingTable (Seconds (2)).NeighborRange (0, 0), 0, 1e-9, "No neighbor");
+    // One hop neighbors at x = 90, 50, 120 and 10
+    RoutingTable neighbors (Seconds (2));
+    const uint32_t positionX[] = { 90, 50, 120, 10 };
+    for (uint32_t i = 0; i < 4; ++i)
+      {
+        RoutingTableEntry nb (/*output device*/ dev, /*dst*/ Ipv4Address (0x0a000001 + i), /*validSeqNo*/ true, /*seqNo*/ 0,
+                                                /*interface*/ iface, /*hop*/ 1, /*next hop*/ Ipv4Address (0x0a000001 + i), /*lifetime*/ Seconds (10));
+        nb.SetPosition (positionX[i], 0);
+        neighbors.AddRoute (nb);
+      }
+    NS_TEST_EXPECT_MSG_EQ_TOL (neighbors.NeighborRange (0, 0), 120, 1e-9, "Farthest neighbor");
+    NS_TEST_EXPECT_MSG_EQ_TOL (neighbors.NeighborRange (100, 0), 90, 1e-9, "Measured from the given position");
+    // Farther, but two hops away
+    RoutingTableEntry far (/*output device*/ dev, /*dst*/ Ipv4Address ("10.0.0.9"), /*validSeqNo*/ true, /*seqNo*/ 0,
+                                             /*interface*/ iface, /*hop*/ 2, /*next hop*/ Ipv4Address ("10.0.0.1"), /*lifetime*/ Seconds (10));
+    far.SetPosition (300, 0);
+    neighbors.AddRoute (far);
+    NS_TEST_EXPECT_MSG_EQ_TOL (neighbors.NeighborRange (0, 0), 120, 1e-9, "Only one hop neighbors");
+    neighbors.SetEntryState (Ipv4Address ("10.0.0.3"), INVALID);
+    NS_TEST_EXPECT_MSG_EQ_TOL (neighbors.NeighborRange (0, 0), 90, 1e-9, "Invalid neighbor skipped");
+    Simulator::Destroy ();
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the residual energy of the neighbors in the clustering
+ */
+struct aodvDbscanEnergyClusterTest : public TestCase
+{
+  aodvDbscanEnergyClusterTest () : TestCase ("Energy aware clustering")
+  {
+  }
+  virtual void DoRun ()
+  {
+    Ptr<NetDevice> dev;
+    Ipv4InterfaceAddress iface;
+    // Six alike neighbors, the first three almost depleted
+    RoutingTable energy (Seconds (2));
+    for (uint32_t i = 0; i < 6; ++i)
+      {
+        RoutingTableEntry nb (/*output device*/ dev, /*dst*/ Ipv4Address (0x0a000201 + i), /*validSeqNo*/ true, /*seqNo*/ 0,
+                                                /*interface*/ iface, /*hop*/ 1, /*next hop*/ Ipv4Address (0x0a000201 + i), /*lifetime*/ Seconds (10));
+        nb.SetPosition (50, 0);
+        nb.SetResidualEnergy (i < 3 ? 0.1 : 0.9);
+        energy.AddRoute (nb);
+      }
+    NS_TEST_EXPECT_MSG_EQ (energy.DBSCAN (Ipv4Address ("10.0.3.1"), 100, 0, 0.3, 2).size (), 6, "Energy ignored by default");
+    energy.SetEnergyWeight (1);
+    std::vector<Ipv4Address> cluster = energy.DBSCAN (Ipv4Address ("10.0.3.1"), 100, 0, 0.3, 2);
+    NS_TEST_ASSERT_MSG_EQ (cluster.size (), 3, "Depleted neighbors form their own cluster");
+    NS_TEST_EXPECT_MSG_EQ (cluster[0], Ipv4Address ("10.0.2.4"), "Cluster with more energy chosen");
+    Simulator::Destroy ();
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the alternate next hops of multipath routes
+ */
+struct aodvDbscanMultipathTest : public TestCase
+{
+  aodvDbscanMultipathTest () : TestCase ("Multipath")
+  {
+  }
+  virtual void DoRun ()
+  {
+    Ptr<NetDevice> dev;
+    Ipv4InterfaceAddress iface;
+    // 10.0.0.1 - 10.0.0.5 are neighbors
+    RoutingTable rtable (Seconds (2));
+    for (uint32_t i = 0; i < 5; ++i)
+      {
+        RoutingTableEntry nb (/*output device*/ dev, /*dst*/ Ipv4Address (0x0a000001 + i), /*validSeqNo*/ true, /*seqNo*/ 0,
+                                                /*interface*/ iface, /*hop*/ 1, /*next hop*/ Ipv4Address (0x0a000001 + i), /*lifetime*/ Seconds (10));
+        rtable.AddRoute (nb);
+      }
+
+    RoutingTableEntry multi (/*output device*/ dev, /*dst*/ Ipv4Address ("10.0.1.1"), /*validSeqNo*/ true, /*seqNo*/ 7,
+                                               /*interface*/ iface, /*hop*/ 5, /*next hop*/ Ipv4Address ("10.0.0.1"), /*lifetime*/ Seconds (10));
+    multi.InsertPrecursor (Ipv4Address ("10.0.0.5"));
+    NS_TEST_EXPECT_MSG_EQ (multi.GetAdvertisedHop (), 5, "Advertised with the hop count of the route");
+    NS_TEST_EXPECT_MSG_EQ (multi.AddAlternate (Ipv4Address ("10.0.0.1"), 5, Seconds (10)), false, "Current next hop is no alternate");
+    NS_TEST_EXPECT_MSG_EQ (multi.AddAlternate (Ipv4Address ("10.0.0.2"), 6, Seconds (10)), false, "Longer than advertised");
+    NS_TEST_EXPECT_MSG_EQ (multi.AddAlternate (Ipv4Address ("10.0.0.5"), 4, Seconds (10)), false, "Precursors may loop");
+    NS_TEST_EXPECT_MSG_EQ (multi.AddAlternate (Ipv4Address ("10.0.0.2"), 5, Seconds (10)), true, "As long as advertised");
+    NS_TEST_EXPECT_MSG_EQ (multi.AddAlternate (Ipv4Address ("10.0.0.3"), 4, Seconds (10)), true, "Shorter than advertised");
+    NS_TEST_EXPECT_MSG_EQ (multi.AddAlternate (Ipv4Address ("5.5.5.5"), 4, Seconds (10)), true, "Not a neighbor yet");
+    NS_TEST_EXPECT_MSG_EQ (multi.AddAlternate (Ipv4Address ("10.0.0.4"), 5, Seconds (10)), false, "Full, not shorter");
+    NS_TEST_EXPECT_MSG_EQ (multi.AddAlternate (Ipv4Address ("10.0.0.4"), 4, Seconds (10)), true, "Replaces the longest path");
+    NS_TEST_EXPECT_MSG_EQ (multi.GetAlternateCount (), 3, "Limited to MaxAlternates");
+    // 10.0.0.3 forwards toward the destination through this node since the alternate was recorded
+    multi.InsertPrecursor (Ipv4Address ("10.0.0.3"));
+    rtable.AddRoute (multi);
+    NS_TEST_EXPECT_MSG_EQ (rtable.SwitchToAlternates (Ipv4Address ("10.0.0.1")), 1, "Route switched");
+    NS_TEST_EXPECT_MSG_EQ (rtable.LookupValidRoute (Ipv4Address ("10.0.1.1"), multi), true, "Route still valid");
+    NS_TEST_EXPECT_MSG_EQ (multi.GetNextHop (), Ipv4Address ("10.0.0.4"), "Shortest alternate through a neighbor, not a precursor");
+    NS_TEST_EXPECT_MSG_EQ (multi.GetHop (), 4, "Hop count of the alternate");
+    NS_TEST_EXPECT_MSG_EQ (multi.GetAlternateCount (), 0, "Used, unreachable and looping alternates removed");
+    NS_TEST_EXPECT_MSG_EQ (rtable.SwitchToAlternates (Ipv4Address ("10.0.0.4")), 0, "No alternate left");
+
+    // A shorter route replacing one already advertised keeps the longer advertised hop count
+    RoutingTableEntry longer (/*output device*/ dev, /*dst*/ Ipv4Address ("10.0.2.1"), /*validSeqNo*/ true, /*seqNo*/ 3,
+                                                /*interface*/ iface, /*hop*/ 6, /*next hop*/ Ipv4Address ("10.0.0.2"), /*lifetime*/ Seconds (10));
+    RoutingTableEntry shorter (/*output device*/ dev, /*dst*/ Ipv4Address ("10.0.2.1"), /*validSeqNo*/ true, /*seqNo*/ 3,
+                                                 /*interface*/ iface, /*hop*/ 3, /*next hop*/ Ipv4Address ("10.0.0.1"), /*lifetime*/ Seconds (10));
+    shorter.AdoptAlternates (longer);
+    NS_TEST_EXPECT_MSG_EQ (shorter.GetAdvertisedHop (), 6, "Advertised hop count kept");
+    NS_TEST_EXPECT_MSG_EQ (shorter.GetAlternateCount (), 1, "Replaced next hop kept as alternate");
+    NS_TEST_EXPECT_MSG_EQ (shorter.AddAlternate (Ipv4Address ("10.0.0.3"), 7, Seconds (10)), false, "Longer than advertised");
+    Simulator::Destroy ();
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Neighbors which never advertised a position are left out of the geographic decisions
+ */
+struct aodvDbscanPositionKnownTest : public TestCase
+{
+  aodvDbscanPositionKnownTest () : TestCase ("Unknown neighbor positions")
+  {
+  }
+  virtual void DoRun ()
+  {
+    Ptr<NetDevice> dev;
+    Ipv4InterfaceAddress iface;
+    RoutingTable neighbors (Seconds (2));
+    // 10.0.0.1 - 10.0.0.3 at x = 10, 20, 30; 10.0.0.4 learned from a message without position
+    for (uint32_t i = 0; i < 4; ++i)
+      {
+        RoutingTableEntry nb (/*output device*/ dev, /*dst*/ Ipv4Address (0x0a000001 + i), /*validSeqNo*/ true, /*seqNo*/ 0,
+                                                /*interface*/ iface, /*hop*/ 1, /*next hop*/ Ipv4Address (0x0a000001 + i), /*lifetime*/ Seconds (10));
+        NS_TEST_EXPECT_MSG_EQ (nb.HasPosition (), false, "No position until advertised");
+        if (i < 3)
+          {
+            nb.SetPosition (10 * (i + 1), 0);
+            NS_TEST_EXPECT_MSG_EQ (nb.HasPosition (), true, "Position advertised");
+          }
+        neighbors.AddRoute (nb);
+      }
+    // The unknown neighbor would be the closest to (0, 0) and the farthest from (100, 0)
+    std::vector<Ipv4Address> greedy = neighbors.GreedyNeighbors (0, 0, 100, 4);
+    NS_TEST_ASSERT_MSG_EQ (greedy.size (), 3, "Unknown position makes no progress");
+    NS_TEST_EXPECT_MSG_EQ (greedy[0], Ipv4Address ("10.0.0.1"), "Closest known neighbor first");
+    NS_TEST_EXPECT_MSG_EQ_TOL (neighbors.NeighborRange (100, 0), 90, 1e-9, "Unknown position ignored");
+    std::vector<Ipv4Address> cluster = neighbors.DBSCAN (Ipv4Address ("10.0.1.1"), 100, 0, 1, 1);
+    NS_TEST_EXPECT_MSG_EQ (std::find (cluster.begin (), cluster.end (), Ipv4Address ("10.0.0.4")) == cluster.end (), true,
+                           "Unknown position never clustered");
+
+    // A route rebuilt from a message leaving fields out keeps what was advertised before
+    RoutingTableEntry old;
+    neighbors.LookupRoute (Ipv4Address ("10.0.0.2"), old);
+    old.SetTxErrorCount (3);
+    old.SetFreeSpace (40);
+    RoutingTableEntry rebuilt (/*output device*/ dev, /*dst*/ Ipv4Address ("10.0.0.2"), /*validSeqNo*/ false, /*seqNo*/ 0,
+                                                 /*interface*/ iface, /*hop*/ 1, /*next hop*/ Ipv4Address ("10.0.0.2"), /*lifetime*/ Seconds (10));
+    rebuilt.CopyAdvertisedState (old);
+    NS_TEST_EXPECT_MSG_EQ (rebuilt.HasPosition (), true, "Position still known");
+    NS_TEST_EXPECT_MSG_EQ (rebuilt.GetPositionX (), 20, "Position kept");
+    NS_TEST_EXPECT_MSG_EQ (rebuilt.GetTxErrorCount (), 3, "Error count kept");
+    NS_TEST_EXPECT_MSG_EQ (rebuilt.GetFreeSpace (), 40, "Free space kept");
+    Simulator::Destroy ();
+  }
+};
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Base of the tests that drive the internals of one node directly
+ *
+ * The node runs aodvDbscan without hellos on simple net devices, the first one on
+ * 10.1.1.0/24, the next ones on 10.1.2.0/24 and so on. The fixture is the one friend
+ * of RoutingProtocol and hands the tests what they drive.
+ */
+class RoutingProtocolFixture : public TestCase
+{
+public:
+  /**
+   * Constructor
+   * \param name the name of the test
+   */
+  RoutingProtocolFixture (std::string name) : TestCase (name)
+  {
+  }
+
+protected:
+  /**
+   * Create the node
+   * \param routing the routing helper, with the attributes under test set
+   * \param devices the number of devices
+   */
+  void CreateNode (aodvDbscanHelper routing, uint32_t devices = 1);
+  /**
+   * Run the simulation, then destroy the node
+   * \param stop when the simulation stops
+   */
+  void Simulate (Time stop);
+  /**
+   * \param dst the destination
+   * \param hop the hop count
+   * \param nextHop the next hop
+   * \param seqNo the destination sequence number
+   * \returns a valid route on the first device, for 10 s
+   */
+  RoutingTableEntry MakeRoute (Ipv4Address dst, uint16_t hop, Ipv4Address nextHop, uint32_t seqNo) const;
+
+  /// \returns the routing table of the node
+  RoutingTable & GetRoutingTable ()
+  {
+    return m_routing->m_routingTable;
+  }
+  /// \returns the location cache of the node
+  LocationCache & GetLocationCache ()
+  {
+    return m_routing->m_locationCache;
+  }
+  /// \returns the sockets of the node and their interface addresses
+  std::map<Ptr<Socket>, Ipv4InterfaceAddress> const & GetSocketAddresses () const
+  {
+    return m_routing->m_socketAddresses;
+  }
+  /// \returns the ID of the last RREQ the node originated
+  uint32_t GetRequestId () const
+  {
+    return m_routing->m_requestId;
+  }
+  /**
+   * \param dst the destination
+   * \returns the cluster the last RREQ to the destination went to
+   */
+  std::vector<Ipv4Address> & GetLastKnownCluster (Ipv4Address dst)
+  {
+    return m_routing->m_lastKnonwCluster[dst];
+  }
+
+  ///\name Local repair
+  //\{
+  /**
+   * \param dst the destination
+   * \param brokenHop the lost next hop
+   * \returns true if the repair started
+   */
+  bool StartLocalRepair (Ipv4Address dst, Ipv4Address brokenHop)
+  {
+    return m_routing->StartLocalRepair (dst, brokenHop);
+  }
+  /// \param dst the repaired destination
+  void FinishLocalRepair (Ipv4Address dst)
+  {
+    m_routing->FinishLocalRepair (dst);
+  }
+  /// \returns true if a local repair is under way
+  bool IsRepairing () const
+  {
+    return !m_routing->m_localRepairs.empty ();
+  }
+  /**
+   * Forward a packet in transit
+   * \param p the packet
+   * \param header the IP header
+   * \param ucb the forwarding callback
+   * \param ecb the error callback
+   * \returns true if the node took the packet
+   */
+  bool Forwarding (Ptr<const Packet> p, const Ipv4Header & header,
+                   Ipv4RoutingProtocol::UnicastForwardCallback ucb, Ipv4RoutingProtocol::ErrorCallback ecb)
+  {
+    return m_routing->Forwarding (p, header, ucb, ecb);
+  }
+  //\}
+
+  ///\name Predictive rediscovery
+  //\{
+  /**
+   * \param dst the destination
+   * \param nextHop the next hop of the route
+   */
+  void CheckLinkLifetime (Ipv4Address dst, Ipv4Address nextHop)
+  {
+    m_routing->CheckLinkLifetime (dst, nextHop);
+  }
+  /// \returns the destinations of the background RREQs and when they were sent
+  std::map<Ipv4Address, Time> const & GetPreemptiveRequests () const
+  {
+    return m_routing->m_preemptiveRequests;
+  }
+  //\}
+
+  ///\name RREQ rate control
+  //\{
+  /**
+   * \param dst the destination
+   * \returns true if a RREQ may be sent
+   */
+  bool TakeRequestToken (Ipv4Address dst)
+  {
+    return m_routing->TakeRequestToken (dst);
+  }
+  /// \param dst the destination
+  void SendRequest (Ipv4Address dst)
+  {
+    m_routing->SendRequest (dst);
+  }
+  /// \param dst the destination
+  void RequestDiscovery (Ipv4Address dst)
+  {
+    m_routing->RequestDiscovery (dst);
+  }
+  /// \returns the RREQs sent in the current second
+  uint16_t GetRequestCount () const
+  {
+    return m_routing->m_rreqCount;
+  }
+  /// \param count the RREQs sent in the current second
+  void SetRequestCount (uint16_t count)
+  {
+    m_routing->m_rreqCount = count;
+  }
+  /// \returns the RREQs allowed per second
+  uint16_t GetRequestRateLimit () const
+  {
+    return m_routing->m_rreqRateLimit;
+  }
+  /**
+   * \param dst the destination
+   * \returns the RREQ to the destination deferred by rate control or coalescing
+   */
+  EventId & GetPendingDiscovery (Ipv4Address dst)
+  {
+    return m_routing->m_discoveries[dst].m_pending;
+  }
+  /**
+   * \param dst the destination
+   * \returns true if the node keeps discovery state for the destination
+   */
+  bool HasDiscovery (Ipv4Address dst) const
+  {
+    return m_routing->m_discoveries.count (dst);
+  }
+  /// \returns the number of destinations the node keeps discovery state for
+  uint32_t CountDiscoveries () const
+  {
+    return m_routing->m_discoveries.size ();
+  }
+  /// \param dst the destination whose RREQ retries stop
+  void CancelRequestRetry (Ipv4Address dst)
+  {
+    m_routing->m_addressReqTimer[dst].Cancel ();
+  }
+  //\}
+
+  ///\name RREQ fan-out
+  //\{
+  /**
+   * \param p the RREP
+   * \param receiver the address it was received on
+   * \param sender the neighbor it came from
+   */
+  void RecvReply (Ptr<const Packet> p, Ipv4Address receiver, Ipv4Address sender)
+  {
+    m_routing->RecvReply (p, receiver, sender);
+  }
+  /**
+   * \param dst the destination
+   * \returns the number of RREQs to the destination whose cluster fan-out is tracked
+   */
+  uint32_t CountFanOuts (Ipv4Address dst) const
+  {
+    uint32_t count = 0;
+    RoutingProtocol::FanOutMap const & fanOuts = m_routing->m_rreqFanOuts;
+    for (RoutingProtocol::FanOutMap::const_iterator i = fanOuts.begin (); i != fanOuts.end (); ++i)
+      {
+        count += (i->first.first == dst);
+      }
+    return count;
+  }
+  /**
+   * \param dst the destination
+   * \returns the RREQ unicasts to the cluster of the destination not sent yet
+   */
+  uint32_t CountPendingUnicasts (Ipv4Address dst) const
+  {
+    uint32_t count = 0;
+    RoutingProtocol::FanOutMap const & fanOuts = m_routing->m_rreqFanOuts;
+    for (RoutingProtocol::FanOutMap::const_iterator i = fanOuts.begin (); i != fanOuts.end (); ++i)
+      {
+        for (std::vector<EventId>::const_iterator j = i->second.begin (); j != i->second.end (); ++j)
+          {
+            count += (i->first.first == dst && j->IsRunning ());
+          }
+      }
+    return count;
+  }
+  /**
+   * \param dst the destination
+   * \returns true if the node keeps a RREQ retry timer for the destination
+   */
+  bool HasRequestRetry (Ipv4Address dst) const
+  {
+    return m_routing->m_addressReqTimer.count (dst);
+  }
+  //\}
+
+  ///\name RREP aggregation
+  //\{
+  /**
+   * \param socket the socket to send on
+   * \param nextHop the next hop
+   * \param rrepHeader the RREP
+   * \param ttl the TTL the RREP needs
+   */
+  void AggregateReply (Ptr<Socket> socket, Ipv4Address nextHop, RrepHeader const & rrepHeader, uint8_t ttl)
+  {
+    m_routing->AggregateReply (socket, nextHop, rrepHeader, ttl);
+  }
+  /// \returns the number of next hops RREPs are held for
+  uint32_t CountHeldNextHops () const
+  {
+    return m_routing->m_aggregatedReplies.size ();
+  }
+  /**
+   * \param nextHop the next hop
+   * \returns the RREPs held for the next hop
+   */
+  std::vector<RrepHeader> const & GetHeldReplies (Ipv4Address nextHop)
+  {
+    return m_routing->m_aggregatedReplies[nextHop].m_replies;
+  }
+  /**
+   * \param nextHop the next hop
+   * \returns the TTL the RREPs held for the next hop need
+   */
+  uint8_t GetHeldTtl (Ipv4Address nextHop)
+  {
+    return m_routing->m_aggregatedReplies[nextHop].m_ttl;
+  }
+  /**
+   * \param nextHop the next hop
+   * \returns the socket the RREPs held for the next hop go out on
+   */
+  Ptr<Socket> GetHeldSocket (Ipv4Address nextHop)
+  {
+    return m_routing->m_aggregatedReplies[nextHop].m_socket;
+  }
+  /// \param rrepHeader a RREP to read with the compact encoding of the node
+  void SetCompactOrigin (RrepHeader & rrepHeader) const
+  {
+    rrepHeader.SetCompactOrigin (m_routing->m_compactOriginX, m_routing->m_compactOriginY, m_routing->m_compactResolution);
+  }
+  //\}
+
+  Ptr<RoutingProtocol> m_routing; ///< the node
+};
+
+void
+RoutingProtocolFixture::CreateNode (aodvDbscanHelper routing, uint32_t devices)
+{
+  NodeContainer nodes;
+  nodes.Create (1);
+  MobilityHelper mobility;
+  mobility.Install (nodes);
+  routing.Set ("EnableHello", BooleanValue (false));
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (routing);
+  stack.Install (nodes);
+  SimpleNetDeviceHelper simple;
+  Ipv4AddressHelper address;
+  for (uint32_t i = 0; i < devices; ++i)
+    {
+      address.SetBase (Ipv4Address (0x0a010100 + (i << 8)), "255.255.255.0");
+      address.Assign (simple.Install (nodes));
+    }
+  m_routing = nodes.Get (0)->GetObject<RoutingProtocol> ();
+}
+
+void
+RoutingProtocolFixture::Simulate (Time stop)
+{
+  Simulator::Stop (stop);
+  Simulator::Run ();
+  m_routing = 0;
+  Simulator::Destroy ();
+}
+
+RoutingTableEntry
+RoutingProtocolFixture::MakeRoute (Ipv4Address dst, uint16_t hop, Ipv4Address nextHop, uint32_t seqNo) const
+{
+  return RoutingTableEntry (/*output device*/ m_routing->m_ipv4->GetNetDevice (1), dst, /*validSeqNo*/ true, seqNo,
+                            /*interface*/ m_routing->m_ipv4->GetAddress (1, 0), hop, nextHop, /*lifetime*/ Seconds (10));
+}
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the local repair of a route whose next hop was lost
+ */
+class LocalRepairTest : public RoutingProtocolFixture
+{
+public:
+  LocalRepairTest () : RoutingProtocolFixture ("Local repair"),
+                       m_dropped (0)
+  {
+  }
+  virtual void DoRun ();
+
+private:
+  /**
+   * Record a packet forwarded by the node
+   * \param route the route used
+   * \param p the packet
+   * \param header the IP header
+   */
+  void Forward (Ptr<Ipv4Route> route, Ptr<const Packet> p, const Ipv4Header & header);
+  /**
+   * Record a packet dropped by the node
+   * \param p the packet
+   * \param header the IP header
+   * \param err the reason
+   */
+  void Drop (Ptr<const Packet> p, const Ipv4Header & header, Socket::SocketErrno err);
+  /**
+   * Hold a packet in transit to a destination
+   * \param dst the destination
+   * \returns true if the packet was taken
+   */
+  bool SendThrough (Ipv4Address dst);
+  /// Break a route and repair it
+  void CheckRepair ();
+  /// Break a route no RREP will repair
+  void CheckStartTimeout ();
+  /// Check the route was reported after the repair time
+  void CheckTimeout ();
+
+  std::vector<Ipv4Header> m_forwarded;  ///< headers of the packets forwarded
+  std::vector<Ipv4Address> m_gateways;  ///< next hops of the packets forwarded
+  uint32_t m_dropped;                   ///< packets dropped
+};
+
+void
+LocalRepairTest::Forward (Ptr<Ipv4Route> route, Ptr<const Packet> p, const Ipv4Header & header)
+{
+  m_forwarded.push_back (header);
+  m_gateways.push_back (route->GetGateway ());
+}
+
+void
+LocalRepairTest::Drop (Ptr<const Packet> p, const Ipv4Header & header, Socket::SocketErrno err)
+{
+  ++m_dropped;
+}
+
+bool
+LocalRepairTest::SendThrough (Ipv4Address dst)
+{
+  Ipv4Header header;
+  header.SetSource (Ipv4Address ("10.1.1.5"));
+  header.SetDestination (dst);
+  header.SetTtl (10);
+  return Forwarding (Create<Packet> (100), header, MakeCallback (&LocalRepairTest::Forward, this),
+                     MakeCallback (&LocalRepairTest::Drop, this));
+}
+
+void
+LocalRepairTest::CheckRepair ()
+{
+  // Neighbors 10.1.1.2 and 10.1.1.3 on the way to 10.1.1.9, 10.1.1.4 forwards to it through us
+  const Ipv4Address dst ("10.1.1.9");
+  RoutingTableEntry nb = MakeRoute (Ipv4Address ("10.1.1.2"), 1, Ipv4Address ("10.1.1.2"), 0);
+  nb.SetPosition (50, 0);
+  GetRoutingTable ().AddRoute (nb);
+  nb = MakeRoute (Ipv4Address ("10.1.1.3"), 1, Ipv4Address ("10.1.1.3"), 0);
+  nb.SetPosition (60, 0);
+  GetRoutingTable ().AddRoute (nb);
+  RoutingTableEntry toDst = MakeRoute (dst, 2, Ipv4Address ("10.1.1.2"), 5);
+  toDst.InsertPrecursor (Ipv4Address ("10.1.1.4"));
+  GetRoutingTable ().AddRoute (toDst);
+
+  NS_TEST_EXPECT_MSG_EQ (StartLocalRepair (dst, Ipv4Address ("10.1.1.2")), false, "Destination never located");
+  GetLocationCache ().SetPosition (dst, LocationCache::Position (100, 0), Simulator::Now ());
+  NS_TEST_ASSERT_MSG_EQ (StartLocalRepair (dst, Ipv4Address ("10.1.1.2")), true, "Repair started");
+  NS_TEST_EXPECT_MSG_EQ (GetRoutingTable ().LookupRoute (dst, toDst), true, "Route kept");
+  NS_TEST_EXPECT_MSG_EQ (toDst.GetFlag (), IN_SEARCH, "Route under repair");
+
+  NS_TEST_EXPECT_MSG_EQ (SendThrough (dst), true, "Packet held during the repair");
+  NS_TEST_EXPECT_MSG_EQ (m_forwarded.size (), 0, "Nothing forwarded before the repair");
+
+  // The RREP answering the repair brings a longer route through the other neighbor
+  RoutingTableEntry repaired = MakeRoute (dst, 3, Ipv4Address ("10.1.1.3"), 6);
+  GetRoutingTable ().Update (repaired);
+  FinishLocalRepair (dst);
+  NS_TEST_ASSERT_MSG_EQ (m_forwarded.size (), 1, "Held packet forwarded once repaired");
+  NS_TEST_EXPECT_MSG_EQ (m_forwarded[0].GetSource (), Ipv4Address ("10.1.1.5"), "Source of the packet kept");
+  NS_TEST_EXPECT_MSG_EQ (m_forwarded[0].GetTtl (), 10, "TTL as received, the forwarding callback decrements it");
+  NS_TEST_EXPECT_MSG_EQ (m_gateways[0], Ipv4Address ("10.1.1.3"), "Forwarded on the repaired route");
+  NS_TEST_EXPECT_MSG_EQ (m_dropped, 0, "Nothing dropped");
+  NS_TEST_EXPECT_MSG_EQ (IsRepairing (), false, "Repair finished");
+  NS_TEST_EXPECT_MSG_EQ (GetRoutingTable ().LookupRoute (dst, toDst), true, "Route kept");
+  NS_TEST_EXPECT_MSG_EQ (toDst.LookupPrecursor (Ipv4Address ("10.1.1.4")), true, "Precursors restored");
+}
+
+void
+LocalRepairTest::CheckStartTimeout ()
+{
+  const Ipv4Address dst ("10.1.1.10");
+  RoutingTableEntry toDst = MakeRoute (dst, 2, Ipv4Address ("10.1.1.2"), 5);
+  toDst.InsertPrecursor (Ipv4Address ("10.1.1.4"));
+  GetRoutingTable ().AddRoute (toDst);
+  GetLocationCache ().SetPosition (dst, LocationCache::Position (100, 0), Simulator::Now ());
+  NS_TEST_ASSERT_MSG_EQ (StartLocalRepair (dst, Ipv4Address ("10.1.1.2")), true, "Repair started");
+  NS_TEST_EXPECT_MSG_EQ (SendThrough (dst), true, "Packet held during the repair");
+}
+
+void
+LocalRepairTest::CheckTimeout ()
+{
+  const Ipv4Address dst ("10.1.1.10");
+  NS_TEST_EXPECT_MSG_EQ (m_forwarded.size (), 1, "Nothing more forwarded");
+  NS_TEST_EXPECT_MSG_EQ (m_dropped, 1, "Held packet dropped when the repair failed");
+  NS_TEST_EXPECT_MSG_EQ (IsRepairing (), false, "Repair given up");
+  RoutingTableEntry toDst;
+  NS_TEST_EXPECT_MSG_EQ (GetRoutingTable ().LookupRoute (dst, toDst), true, "Route kept");
+  NS_TEST_EXPECT_MSG_EQ (toDst.GetFlag (), INVALID, "Route reported broken");
+}
+
+void
+LocalRepairTest::DoRun ()
+{
+  aodvDbscanHelper routing;
+  routing.Set ("EnableLocalRepair", BooleanValue (true));
+  CreateNode (routing);
+
+  Simulator::Schedule (Seconds (1), &LocalRepairTest::CheckRepair, this);
+  // The repair of a 2 hop route waits 2 * NodeTraversalTime * (2 + 2 + TimeoutBuffer), less than a second
+  Simulator::Schedule (Seconds (2), &LocalRepairTest::CheckStartTimeout, this);
+  Simulator::Schedule (Seconds (3), &LocalRepairTest::CheckTimeout, this);
+  Simulate (Seconds (4));
+}
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the background RREQ started before the link to a next hop breaks
+ */
+class PredictiveRediscoveryTest : public RoutingProtocolFixture
+{
+public:
+  PredictiveRediscoveryTest () : RoutingProtocolFixture ("Predictive rediscovery")
+  {
+  }
+  virtual void DoRun ();
+
+private:
+  /**
+   * Record a control packet sent by the node
+   * \param packet the packet
+   * \param destination where it was sent
+   */
+  void TxControl (Ptr<const Packet> packet, Ipv4Address destination);
+  /// Let the next hop of a route move away
+  void CheckTrigger ();
+  /// Check who the background RREQ went to
+  void CheckSent ();
+  /// Check the background RREQ was forgotten after PathDiscoveryTime
+  void CheckForgotten ();
+
+  std::vector<Ipv4Address> m_destinations; ///< destinations of the control packets sent
+};
+
+void
+PredictiveRediscoveryTest::TxControl (Ptr<const Packet> packet, Ipv4Address destination)
+{
+  m_destinations.push_back (destination);
+}
+
+void
+PredictiveRediscoveryTest::CheckTrigger ()
+{
+  // A route to 10.1.1.9 through 10.1.1.2, last RREQ to it went to the cluster of 10.1.1.2 and 10.1.1.3
+  const Ipv4Address dst ("10.1.1.9");
+  const Ipv4Address nextHop ("10.1.1.2");
+  for (uint32_t i = 0; i < 2; ++i)
+    {
+      GetRoutingTable ().AddRoute (MakeRoute (Ipv4Address (0x0a010102 + i), 1, Ipv4Address (0x0a010102 + i), 0));
+    }
+  GetRoutingTable ().AddRoute (MakeRoute (dst, 2, nextHop, 5));
+  GetLocationCache ().SetPosition (dst, LocationCache::Position (400, 0), Simulator::Now ());
+  GetLastKnownCluster (dst).push_back (nextHop);
+  GetLastKnownCluster (dst).push_back (Ipv4Address ("10.1.1.3"));
+
+  // 10 m inside the LinkRange of 250 m
+  GetLocationCache ().SetPosition (nextHop, LocationCache::Position (240, 0), Simulator::Now ());
+  CheckLinkLifetime (dst, nextHop);
+  NS_TEST_EXPECT_MSG_EQ (GetPreemptiveRequests ().empty (), true, "No prediction without velocity");
+  GetLocationCache ().SetVelocity (nextHop, 0, 0, Simulator::Now ());
+  CheckLinkLifetime (dst, nextHop);
+  NS_TEST_EXPECT_MSG_EQ (GetPreemptiveRequests ().empty (), true, "Link not breaking");
+  GetLocationCache ().SetVelocity (nextHop, 2, 0, Simulator::Now ());
+  CheckLinkLifetime (dst, nextHop);
+  NS_TEST_EXPECT_MSG_EQ (GetPreemptiveRequests ().empty (), true, "Breaking in 5 s, beyond PreemptiveMargin");
+
+  // Breaking in 1 s
+  GetLocationCache ().SetVelocity (nextHop, 10, 0, Simulator::Now ());
+  uint32_t requestId = GetRequestId ();
+  CheckLinkLifetime (dst, nextHop);
+  NS_TEST_EXPECT_MSG_EQ (GetPreemptiveRequests ().count (dst), 1u, "Background RREQ started");
+  NS_TEST_EXPECT_MSG_EQ (GetRequestId (), requestId + 1, "One RREQ");
+  NS_TEST_ASSERT_MSG_EQ (GetLastKnownCluster (dst).size (), 1u, "Next hop left out of the cluster");
+  NS_TEST_EXPECT_MSG_EQ (GetLastKnownCluster (dst).front (), Ipv4Address ("10.1.1.3"), "Other member kept");
+  CheckLinkLifetime (dst, nextHop);
+  NS_TEST_EXPECT_MSG_EQ (GetRequestId (), requestId + 1, "Not repeated within PathDiscoveryTime");
+}
+
+void
+PredictiveRediscoveryTest::CheckSent ()
+{
+  NS_TEST_EXPECT_MSG_EQ (std::count (m_destinations.begin (), m_destinations.end (), Ipv4Address ("10.1.1.3")), 1,
+                         "RREQ sent to the cluster");
+  NS_TEST_EXPECT_MSG_EQ (std::count (m_destinations.begin (), m_destinations.end (), Ipv4Address ("10.1.1.2")), 0,
+                         "Not to the next hop about to break");
+}
+
+void
+PredictiveRediscoveryTest::CheckForgotten ()
+{
+  NS_TEST_EXPECT_MSG_EQ (GetPreemptiveRequests ().empty (), true, "Forgotten after PathDiscoveryTime");
+}
+
+void
+PredictiveRediscoveryTest::DoRun ()
+{
+  aodvDbscanHelper routing;
+  routing.Set ("EnablePredictiveRediscovery", BooleanValue (true));
+  CreateNode (routing);
+  m_routing->TraceConnectWithoutContext ("TxControl", MakeCallback (&PredictiveRediscoveryTest::TxControl, this));
+
+  Simulator::Schedule (Seconds (1), &PredictiveRediscoveryTest::CheckTrigger, this);
+  Simulator::Schedule (Seconds (1.5), &PredictiveRediscoveryTest::CheckSent, this);
+  // PathDiscoveryTime is 5.6 s, old requests are forgotten every second
+  Simulator::Schedule (Seconds (8), &PredictiveRediscoveryTest::CheckForgotten, this);
+  Simulate (Seconds (9));
+}
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the per destination RREQ bucket and the coalescing of discoveries
+ */
+class RequestRateTest : public RoutingProtocolFixture
+{
+public:
+  RequestRateTest () : RoutingProtocolFixture ("RREQ rate control")
+  {
+  }
+  virtual void DoRun ();
+
+private:
+  /// Use up the bucket of one destination
+  void CheckBucket ();
+  /// Ask for a discovery of a destination three times in a row
+  void CheckCoalescing ();
+  /// Check the coalesced discoveries were sent as one
+  void CheckCoalesced ();
+  /// Check the destinations back to rest were forgotten
+  void CheckForgotten ();
+
+  uint32_t m_requestId; ///< RREQ id before the coalesced discoveries
+};
+
+void
+RequestRateTest::CheckBucket ()
+{
+  // The bucket holds 5 RREQs and refills 2 a second
+  const Ipv4Address dst ("10.1.1.9");
+  for (uint32_t i = 0; i < 5; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (TakeRequestToken (dst), true, "RREQ " << i << " within the burst");
+    }
+  NS_TEST_EXPECT_MSG_EQ (TakeRequestToken (dst), false, "Burst used up");
+  NS_TEST_EXPECT_MSG_EQ (TakeRequestToken (Ipv4Address ("10.1.1.8")), true, "Other destinations have their own bucket");
+  NS_TEST_EXPECT_MSG_EQ (GetRequestCount (), 6, "Node wide count");
+
+  uint32_t requestId = GetRequestId ();
+  SendRequest (dst);
+  NS_TEST_EXPECT_MSG_EQ (GetRequestId (), requestId, "RREQ deferred");
+  EventId & pending = GetPendingDiscovery (dst);
+  NS_TEST_EXPECT_MSG_EQ (pending.IsRunning (), true, "Deferred RREQ scheduled");
+  NS_TEST_EXPECT_MSG_EQ (Simulator::GetDelayLeft (pending), MilliSeconds (500), "Until the next token");
+  pending.Cancel ();
+
+  // The node wide limit holds whatever the bucket
+  uint16_t count = GetRequestCount ();
+  SetRequestCount (GetRequestRateLimit ());
+  NS_TEST_EXPECT_MSG_EQ (TakeRequestToken (Ipv4Address ("10.1.1.7")), false, "RREQ_RATELIMIT reached");
+  SetRequestCount (count);
+}
+
+void
+RequestRateTest::CheckCoalescing ()
+{
+  const Ipv4Address dst ("10.1.1.6");
+  m_requestId = GetRequestId ();
+  RequestDiscovery (dst);
+  NS_TEST_EXPECT_MSG_EQ (GetRequestId (), m_requestId + 1, "First discovery sent right away");
+  // No RREP will come, do not let the expanding ring search send more
+  CancelRequestRetry (dst);
+  RequestDiscovery (dst);
+  RequestDiscovery (dst);
+  NS_TEST_EXPECT_MSG_EQ (GetRequestId (), m_requestId + 1, "Others within the window coalesced");
+  EventId & pending = GetPendingDiscovery (dst);
+  NS_TEST_EXPECT_MSG_EQ (pending.IsRunning (), true, "One discovery follows the window");
+  NS_TEST_EXPECT_MSG_EQ (Simulator::GetDelayLeft (pending), MilliSeconds (500), "At the end of the window");
+}
+
+void
+RequestRateTest::CheckCoalesced ()
+{
+  const Ipv4Address dst ("10.1.1.6");
+  NS_TEST_EXPECT_MSG_EQ (GetRequestId (), m_requestId + 2, "Coalesced discoveries sent once");
+  CancelRequestRetry (dst);
+  NS_TEST_EXPECT_MSG_EQ (HasDiscovery (dst), true, "Discovery state kept while in use");
+}
+
+void
+RequestRateTest::CheckForgotten ()
+{
+  NS_TEST_EXPECT_MSG_EQ (CountDiscoveries (), 0u, "Full buckets with nothing pending forgotten");
+}
+
+void
+RequestRateTest::DoRun ()
+{
+  CreateNode (aodvDbscanHelper ());
+
+  // Away from the whole seconds at which RREQ_RATELIMIT and the idle destinations are reset
+  Simulator::Schedule (Seconds (1.25), &RequestRateTest::CheckBucket, this);
+  Simulator::Schedule (Seconds (3.25), &RequestRateTest::CheckCoalescing, this);
+  Simulator::Schedule (Seconds (3.85), &RequestRateTest::CheckCoalesced, this);
+  Simulator::Schedule (Seconds (9.5), &RequestRateTest::CheckForgotten, this);
+  Simulate (Seconds (10));
+}
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the RREPs an intermediate node holds to send them in one packet
+ */
+class ReplyAggregationTest : public RoutingProtocolFixture
+{
+public:
+  ReplyAggregationTest () : RoutingProtocolFixture ("RREP aggregation")
+  {
+  }
+  virtual void DoRun ();
+
+private:
+  /**
+   * Record a control packet sent by the node
+   * \param packet the packet
+   * \param destination where it was sent
+   */
+  void TxControl (Ptr<const Packet> packet, Ipv4Address destination);
+  /**
+   * \param packet a packet of RREPs
+   * \returns the RREPs in the packet
+   */
+  std::vector<RrepHeader> ReadReplies (Ptr<const Packet> packet);
+  /**
+   * \param dst the destination
+   * \param hopCount the hop count
+   * \returns a RREP for the destination to 10.1.1.20
+   */
+  RrepHeader MakeReply (Ipv4Address dst, uint8_t hopCount);
+  /// Hold RREPs for one next hop, some of them duplicates
+  void Hold ();
+  /// Check the RREPs held left in one packet
+  void CheckSent ();
+  /// Hold RREPs for one next hop on two interfaces
+  void SwitchInterface ();
+  /// Check the RREPs held on each interface left separately
+  void CheckSwitched ();
+
+  std::vector<Ptr<Packet> > m_packets;     ///< control packets sent
+  std::vector<Ipv4Address> m_destinations; ///< destinations of the control packets sent
+};
+
+void
+ReplyAggregationTest::TxControl (Ptr<const Packet> packet, Ipv4Address destination)
+{
+  m_packets.push_back (packet->Copy ());
+  m_destinations.push_back (destination);
+}
+
+std::vector<RrepHeader>
+ReplyAggregationTest::ReadReplies (Ptr<const Packet> packet)
+{
+  std::vector<RrepHeader> replies;
+  Ptr<Packet> p = packet->Copy ();
+  while (p->GetSize () > 0)
+    {
+      TypeHeader tHeader;
+      p->RemoveHeader (tHeader);
+      NS_TEST_EXPECT_MSG_EQ (tHeader.Get (), aodvDbscanTYPE_RREP, "Only RREPs");
+      RrepHeader rrepHeader;
+      SetCompactOrigin (rrepHeader);
+      p->RemoveHeader (rrepHeader);
+      replies.push_back (rrepHeader);
+    }
+  return replies;
+}
+
+RrepHeader
+ReplyAggregationTest::MakeReply (Ipv4Address dst, uint8_t hopCount)
+{
+  return RrepHeader (/*prefixSize*/ 0, hopCount, dst, /*dstSeqNo*/ 5, /*origin*/ Ipv4Address ("10.1.1.20"),
+                     /*lifetime*/ Seconds (3));
+}
+
+void
+ReplyAggregationTest::Hold ()
+{
+  const Ipv4Address nextHop ("10.1.1.2");
+  // Routed, not left to a discovery of its own
+  GetRoutingTable ().AddRoute (MakeRoute (nextHop, 1, nextHop, 0));
+  Ptr<Socket> socket = GetSocketAddresses ().begin ()->first;
+  AggregateReply (socket, nextHop, MakeReply (Ipv4Address ("10.1.1.9"), 3), 3);
+  AggregateReply (socket, nextHop, MakeReply (Ipv4Address ("10.1.1.9"), 2), 4);
+  AggregateReply (socket, nextHop, MakeReply (Ipv4Address ("10.1.1.9"), 4), 2);
+  AggregateReply (socket, nextHop, MakeReply (Ipv4Address ("10.1.1.10"), 1), 6);
+  AggregateReply (socket, nextHop, MakeReply (Ipv4Address ("10.1.1.10"), 1), 1);
+  NS_TEST_EXPECT_MSG_EQ (m_packets.empty (), true, "Held for the aggregation window");
+  NS_TEST_ASSERT_MSG_EQ (CountHeldNextHops (), 1u, "Held for the next hop");
+  std::vector<RrepHeader> const & held = GetHeldReplies (nextHop);
+  NS_TEST_ASSERT_MSG_EQ (held.size (), 2u, "Duplicates merged");
+  NS_TEST_EXPECT_MSG_EQ (held[0].GetHopCount (), 2, "Shorter duplicate replaces the held RREP");
+  NS_TEST_EXPECT_MSG_EQ ((uint32_t) GetHeldTtl (nextHop), 6, "Largest TTL kept, of duplicates too");
+}
+
+void
+ReplyAggregationTest::CheckSent ()
+{
+  NS_TEST_ASSERT_MSG_EQ (m_packets.size (), 1u, "One packet");
+  NS_TEST_EXPECT_MSG_EQ (m_destinations[0], Ipv4Address ("10.1.1.2"), "To the next hop");
+  SocketIpTtlTag tag;
+  NS_TEST_EXPECT_MSG_EQ (m_packets[0]->PeekPacketTag (tag), true, "TTL set");
+  NS_TEST_EXPECT_MSG_EQ ((uint32_t) tag.GetTtl (), 6, "Reaches the farthest origin");
+  std::vector<RrepHeader> replies = ReadReplies (m_packets[0]);
+  NS_TEST_ASSERT_MSG_EQ (replies.size (), 2u, "Both RREPs");
+  NS_TEST_EXPECT_MSG_EQ (replies[0].GetDst (), Ipv4Address ("10.1.1.9"), "In arrival order");
+  NS_TEST_EXPECT_MSG_EQ (replies[0].GetHopCount (), 2, "Shorter duplicate sent");
+  NS_TEST_EXPECT_MSG_EQ (replies[1].GetDst (), Ipv4Address ("10.1.1.10"), "In arrival order");
+  NS_TEST_EXPECT_MSG_EQ (CountHeldNextHops (), 0u, "Nothing held any more");
+  m_packets.clear ();
+  m_destinations.clear ();
+}
+
+void
+ReplyAggregationTest::SwitchInterface ()
+{
+  const Ipv4Address nextHop ("10.1.1.2");
+  NS_TEST_ASSERT_MSG_EQ (GetSocketAddresses ().size (), 2u, "Two interfaces");
+  Ptr<Socket> first = GetSocketAddresses ().begin ()->first;
+  Ptr<Socket> second = GetSocketAddresses ().rbegin ()->first;
+  AggregateReply (first, nextHop, MakeReply (Ipv4Address ("10.1.1.9"), 2), 3);
+  AggregateReply (second, nextHop, MakeReply (Ipv4Address ("10.1.1.10"), 2), 3);
+  NS_TEST_EXPECT_MSG_EQ (m_packets.size (), 1u, "RREPs of the old interface sent at once");
+  NS_TEST_ASSERT_MSG_EQ (CountHeldNextHops (), 1u, "New RREP held");
+  NS_TEST_EXPECT_MSG_EQ (GetHeldSocket (nextHop), second, "On the new interface");
+  NS_TEST_EXPECT_MSG_EQ (GetHeldReplies (nextHop).size (), 1u, "Only the new RREP");
+}
+
+void
+ReplyAggregationTest::CheckSwitched ()
+{
+  NS_TEST_ASSERT_MSG_EQ (m_packets.size (), 2u, "One packet per interface");
+  std::vector<RrepHeader> replies = ReadReplies (m_packets[0]);
+  NS_TEST_ASSERT_MSG_EQ (replies.size (), 1u, "One RREP");
+  NS_TEST_EXPECT_MSG_EQ (replies[0].GetDst (), Ipv4Address ("10.1.1.9"), "Held on the old interface");
+  replies = ReadReplies (m_packets[1]);
+  NS_TEST_ASSERT_MSG_EQ (replies.size (), 1u, "One RREP");
+  NS_TEST_EXPECT_MSG_EQ (replies[0].GetDst (), Ipv4Address ("10.1.1.10"), "Held on the new interface");
+}
+
+void
+ReplyAggregationTest::DoRun ()
+{
+  aodvDbscanHelper routing;
+  routing.Set ("ReplyAggregationWindow", TimeValue (MilliSeconds (5)));
+  CreateNode (routing, 2);
+  m_routing->TraceConnectWithoutContext ("TxControl", MakeCallback (&ReplyAggregationTest::TxControl, this));
+
+  Simulator::Schedule (Seconds (1), &ReplyAggregationTest::Hold, this);
+  Simulator::Schedule (Seconds (1.1), &ReplyAggregationTest::CheckSent, this);
+  Simulator::Schedule (Seconds (2), &ReplyAggregationTest::SwitchInterface, this);
+  Simulator::Schedule (Seconds (2.1), &ReplyAggregationTest::CheckSwitched, this);
+  Simulate (Seconds (3));
+}
+
+/**
+ * \ingroup aodvDbscan-test
+ * \ingroup tests
+ *
+ * \brief Unit test for the RREQ unicasts to a cluster left unsent once a route is found
+ */
+class RequestFanOutTest : public RoutingProtocolFixture
+{
+public:
+  RequestFanOutTest () : RoutingProtocolFixture ("RREQ fan-out cancelled by a RREP")
+  {
+  }
+  virtual void DoRun ();
+
+private:
+  /**
+   * Record a control packet sent by the node
+   * \param packet the packet
+   * \param destination where it was sent
+   */
+  void TxControl (Ptr<const Packet> packet, Ipv4Address destination);
+  /// Start a fan-out to a cluster of three and answer it before the first unicast
+  void Reply ();
+  /// Check no unicast of the fan-out was sent
+  void CheckUnsent ();
+
+  std::vector<Ipv4Address> m_destinations; ///< destinations of the control packets sent
+};
+
+void
+RequestFanOutTest::TxControl (Ptr<const Packet> packet, Ipv4Address destination)
+{
+  m_destinations.push_back (destination);
+}
+
+void
+RequestFanOutTest::Reply ()
+{
+  // The last RREQ to 10.1.1.9 went to the cluster of 10.1.1.2, 10.1.1.3 and 10.1.1.4
+  const Ipv4Address dst ("10.1.1.9");
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      GetRoutingTable ().AddRoute (MakeRoute (Ipv4Address (0x0a010102 + i), 1, Ipv4Address (0x0a010102 + i), 0));
+      GetLastKnownCluster (dst).push_back (Ipv4Address (0x0a010102 + i));
+    }
+  GetLocationCache ().SetPosition (dst, LocationCache::Position (400, 0), Simulator::Now ());
+
+  SendRequest (dst);
+  NS_TEST_ASSERT_MSG_EQ (CountFanOuts (dst), 1u, "Fan-out tracked");
+  NS_TEST_EXPECT_MSG_EQ (CountPendingUnicasts (dst), 3u, "One unicast per member, none sent yet");
+  NS_TEST_EXPECT_MSG_EQ (HasRequestRetry (dst), true, "Retry scheduled");
+
+  // Through 10.1.1.2, before its unicast left
+  RrepHeader rrepHeader (/*prefixSize*/ 0, /*hopCount*/ 1, dst, /*dstSeqNo*/ 5, /*origin*/ Ipv4Address ("10.1.1.1"),
+                         /*lifetime*/ Seconds (3));
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag tag;
+  tag.SetTtl (1);
+  packet->AddPacketTag (tag);
+  packet->AddHeader (rrepHeader);
+  RecvReply (packet, Ipv4Address ("10.1.1.1"), Ipv4Address ("10.1.1.2"));
+
+  RoutingTableEntry rt;
+  NS_TEST_EXPECT_MSG_EQ (GetRoutingTable ().LookupValidRoute (dst, rt), true, "Route found");
+  NS_TEST_EXPECT_MSG_EQ (CountPendingUnicasts (dst), 0u, "Unicasts cancelled");
+  NS_TEST_EXPECT_MSG_EQ (CountFanOuts (dst), 0u, "Fan-out forgotten");
+  NS_TEST_EXPECT_MSG_EQ (HasRequestRetry (dst), false, "Retry stopped");
+}
+
+void
+RequestFanOutTest::CheckUnsent ()
+{
+  for (uint32_t i = 0; i < 3; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (std::count (m_destinations.begin (), m_destinations.end (), Ipv4Address (0x0a010102 + i)), 0,
+                             "No RREQ to member " << i);
+    }
+}
+
+void
+RequestFanOutTest::DoRun ()
+{
+  CreateNode (aodvDbscanHelper ());
+  m_routing->TraceConnectWithoutContext ("TxControl", MakeCallback (&RequestFanOutTest::TxControl, this));
+
+  // The unicasts are at most 10 ms apart
+  Simulator::Schedule (Seconds (1.25), &RequestFanOutTest::Reply, this);
+  Simulator::Schedule (Seconds (1.5), &RequestFanOutTest::CheckUnsent, this);
+  Simulate (Seconds (2));
+}
+
 /**
  * \ingroup aodvDbscan-test
  * \ingroup tests
@@ -653,15 +2639,36 @@ public:
   aodvDbscanTestSuite () : TestSuite ("routing-aodvDbscan", UNIT)
   {
     AddTestCase (new NeighborTest, TestCase::QUICK);
+    AddTestCase (new NeighborLinkChangesTest, TestCase::QUICK);
+    AddTestCase (new HelloIntervalTest, TestCase::QUICK);
+    AddTestCase (new NeighborMacCacheTest, TestCase::QUICK);
+    AddTestCase (new NeighborEtxTest, TestCase::QUICK);
+    AddTestCase (new NeighborOutageTest, TestCase::QUICK);
     AddTestCase (new TypeHeaderTest, TestCase::QUICK);
     AddTestCase (new RreqHeaderTest, TestCase::QUICK);
     AddTestCase (new RrepHeaderTest, TestCase::QUICK);
+    AddTestCase (new RrepCompactHeaderTest, TestCase::QUICK);
+    AddTestCase (new AggregatedRrepTest, TestCase::QUICK);
     AddTestCase (new RrepAckHeaderTest, TestCase::QUICK);
     AddTestCase (new RerrHeaderTest, TestCase::QUICK);
+    AddTestCase (new RerrHeaderBenchmark, TestCase::EXTENSIVE);
+    AddTestCase (new ForwardingBenchmark, TestCase::EXTENSIVE);
+    AddTestCase (new DpdBloomFilterTest, TestCase::QUICK);
+    AddTestCase (new LocationCacheTest, TestCase::QUICK);
     AddTestCase (new QueueEntryTest, TestCase::QUICK);
     AddTestCase (new aodvDbscanRqueueTest, TestCase::QUICK);
     AddTestCase (new aodvDbscanRtableEntryTest, TestCase::QUICK);
     AddTestCase (new aodvDbscanRtableTest, TestCase::QUICK);
+    AddTestCase (new aodvDbscanGreedyTest, TestCase::QUICK);
+    AddTestCase (new aodvDbscanNeighborRangeTest, TestCase::QUICK);
+    AddTestCase (new aodvDbscanEnergyClusterTest, TestCase::QUICK);
+    AddTestCase (new aodvDbscanMultipathTest, TestCase::QUICK);
+    AddTestCase (new LocalRepairTest, TestCase::QUICK);
+    AddTestCase (new PredictiveRediscoveryTest, TestCase::QUICK);
+    AddTestCase (new RequestRateTest, TestCase::QUICK);
+    AddTestCase (new ReplyAggregationTest, TestCase::QUICK);
+    AddTestCase (new RequestFanOutTest, TestCase::QUICK);
+    AddTestCase (new aodvDbscanPositionKnownTest, TestCase::QUICK);
   }
 } g_aodvDbscanTestSuite; ///< the test suite
 
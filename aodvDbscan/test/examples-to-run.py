@@ -9,6 +9,11 @@
 # See test.py for more information.
 cpp_examples = [
     ("aodvDbscan", "True", "True"),
+    ("aodvDbscan-energy-lifetime --size=20 --flows=2 --time=20", "True", "False"),
+    ("aodvDbscan-scale --size=20 --flows=2 --time=20", "True", "False"),
+    ("aodvDbscan-scale --size=20 --flows=2 --time=20 --mobility=GaussMarkov --speed=0.5", "True", "False"),
+    ("aodvDbscan-compare --size=20 --flows=2 --time=20", "True", "False"),
+    ("aodvDbscan-sweep --size=20 --flows=2 --time=20 --jobs=1 --resume=0", "True", "False"),
 ]
 
 # A list of Python examples to run in order to ensure that they remain